@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_BATCH_MMAP_MEM_ARENA_H
+#define COOK_BATCH_MMAP_MEM_ARENA_H
+
+#ifndef WIN32
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "cookmemarena.h"
+
+namespace cookmem
+{
+
+/**
+ * An mmap based memory arena that maps several segments in one call.
+ *
+ * A batch of batchCount segments of minSize bytes is mapped at a time, and
+ * the segments are handed out individually.  A batch is only unmapped when
+ * all its segments are released.  The most recent batch that becomes empty
+ * is kept to avoid mapping and unmapping repeatedly when a single context
+ * is created and destroyed in a loop.
+ *
+ * Requests larger than minSize are mapped individually.
+ *
+ * This arena reduces the number of mmap / munmap calls and the number of
+ * memory mappings (VMAs) in the process when there are many small memory
+ * contexts sharing the arena.  Like CachedArena, it is not thread safe.
+ */
+class BatchMmapArena
+{
+private:
+    /**
+     * Internal batch descriptor.
+     */
+    struct Batch
+    {
+        /** the start of the mapping */
+        char*           base;
+        /** bit map of the free segments */
+        std::uint64_t   freeMap;
+        /** DLL of the batches with free segments */
+        Batch*          prevAvail;
+        Batch*          nextAvail;
+    };
+
+public:
+    /**
+     * The maximum number of segments per batch.
+     */
+    static const unsigned int MAX_BATCH_COUNT = 64;
+
+    /**
+     * Constructor.
+     *
+     * @param   minSize
+     *          the segment size.  It should be noted that this value
+     *          needs to be a multiple of the page size.
+     * @param   batchCount
+     *          the number of segments to map at a time.  It is capped at
+     *          MAX_BATCH_COUNT.
+     */
+    BatchMmapArena (std::size_t minSize = 65536, unsigned int batchCount = 16)
+    : m_minSize (minSize),
+      m_batchCount (batchCount == 0 ? 1 : (batchCount > MAX_BATCH_COUNT ? MAX_BATCH_COUNT : batchCount)),
+      m_fullMap (m_batchCount == 64 ? ~(std::uint64_t)0 : (((std::uint64_t)1 << m_batchCount) - 1)),
+      m_batches (nullptr),
+      m_numBatches (0),
+      m_maxBatches (0),
+      m_availList (nullptr),
+      m_spare (nullptr),
+      m_numMappings (0),
+      m_stats ()
+    {
+    }
+
+    /**
+     * Destructor.
+     *
+     * All the batches are unmapped.  Segments larger than minSize are not
+     * tracked, and are expected to be released by the memory pools.
+     */
+    ~BatchMmapArena ()
+    {
+        for (std::size_t i = 0; i < m_numBatches; ++i)
+        {
+            munmap (m_batches[i]->base, m_minSize * m_batchCount);
+            delete m_batches[i];
+        }
+        delete[] m_batches;
+    }
+
+    /**
+     * Allocate an arena segment.
+     *
+     * @param   size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr is allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        void* ptr;
+        if (size > m_minSize)
+        {
+            ptr = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED)
+            {
+                ptr = nullptr;
+            }
+            else
+            {
+                ++m_numMappings;
+            }
+            m_stats.addSegment (ptr, size);
+            return ptr;
+        }
+
+        Batch* batch = m_availList;
+        if (batch == nullptr)
+        {
+            batch = addBatch ();
+            if (batch == nullptr)
+            {
+                m_stats.addSegment (nullptr, size);
+                return nullptr;
+            }
+        }
+        if (batch == m_spare)
+        {
+            m_spare = nullptr;
+        }
+
+        unsigned int index = getLowestBit (batch->freeMap);
+        batch->freeMap &= ~((std::uint64_t)1 << index);
+        if (batch->freeMap == 0)
+        {
+            removeAvail (batch);
+        }
+
+        size = m_minSize;
+        ptr = batch->base + index * m_minSize;
+        m_stats.addSegment (ptr, size);
+        return ptr;
+    }
+
+    /**
+     * Free an arena segment.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        if (size > m_minSize)
+        {
+            if (munmap (ptr, size) != 0)
+            {
+                return true;
+            }
+            --m_numMappings;
+            m_stats.removeSegment (size);
+            return false;
+        }
+
+        std::size_t pos = findBatch ((char*)ptr);
+        if (pos == m_numBatches)
+        {
+            return true;
+        }
+        Batch* batch = m_batches[pos];
+        std::size_t offset = (char*)ptr - batch->base;
+        std::uint64_t bit = (std::uint64_t)1 << (offset / m_minSize);
+        if ((offset % m_minSize) != 0 || (batch->freeMap & bit))
+        {
+            return true;
+        }
+
+        if (batch->freeMap == 0)
+        {
+            addAvail (batch);
+        }
+        batch->freeMap |= bit;
+        m_stats.removeSegment (m_minSize);
+
+        if (batch->freeMap == m_fullMap)
+        {
+            if (m_spare == nullptr)
+            {
+                m_spare = batch;
+            }
+            else
+            {
+                removeBatch (pos);
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Get the segment statistics.
+     *
+     * @return  the segment statistics.
+     */
+    const ArenaStats&
+    getStats () const
+    {
+        return m_stats;
+    }
+
+    /**
+     * Get the number of memory mappings currently held by this arena.  It
+     * is the upper bound of the number of VMAs it contributes to the
+     * process, since the kernel may merge adjacent mappings.
+     *
+     * @return  the number of memory mappings.
+     */
+    std::size_t
+    getNumMappings () const
+    {
+        return m_numMappings;
+    }
+
+    /**
+     * Get the number of batches currently mapped.
+     *
+     * @return  the number of batches.
+     */
+    std::size_t
+    getNumBatches () const
+    {
+        return m_numBatches;
+    }
+
+private:
+    BatchMmapArena (const BatchMmapArena&) = delete;
+    BatchMmapArena& operator= (const BatchMmapArena&) = delete;
+
+    /**
+     * Map a new batch, and insert it to the sorted batch array.
+     */
+    Batch*
+    addBatch ()
+    {
+        if (m_numBatches == m_maxBatches)
+        {
+            std::size_t maxBatches = m_maxBatches ? m_maxBatches * 2 : 16;
+            Batch** batches = new (std::nothrow) Batch*[maxBatches];
+            if (batches == nullptr)
+            {
+                return nullptr;
+            }
+            if (m_batches)
+            {
+                memcpy (batches, m_batches, m_numBatches * sizeof(Batch*));
+                delete[] m_batches;
+            }
+            m_batches = batches;
+            m_maxBatches = maxBatches;
+        }
+
+        Batch* batch = new (std::nothrow) Batch ();
+        if (batch == nullptr)
+        {
+            return nullptr;
+        }
+        void* ptr = mmap (nullptr, m_minSize * m_batchCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            delete batch;
+            return nullptr;
+        }
+        ++m_numMappings;
+
+        batch->base = (char*)ptr;
+        batch->freeMap = m_fullMap;
+        batch->prevAvail = nullptr;
+        batch->nextAvail = nullptr;
+
+        std::size_t pos = lowerBound (batch->base);
+        memmove (m_batches + pos + 1, m_batches + pos, (m_numBatches - pos) * sizeof(Batch*));
+        m_batches[pos] = batch;
+        ++m_numBatches;
+
+        addAvail (batch);
+        return batch;
+    }
+
+    /**
+     * Unmap a batch, and remove it from the sorted batch array.
+     */
+    void
+    removeBatch (std::size_t pos)
+    {
+        Batch* batch = m_batches[pos];
+        removeAvail (batch);
+        munmap (batch->base, m_minSize * m_batchCount);
+        --m_numMappings;
+        delete batch;
+
+        --m_numBatches;
+        memmove (m_batches + pos, m_batches + pos + 1, (m_numBatches - pos) * sizeof(Batch*));
+    }
+
+    /**
+     * Find the position of the first batch whose base is not less than
+     * the pointer.
+     */
+    std::size_t
+    lowerBound (const char* ptr) const
+    {
+        std::size_t low = 0;
+        std::size_t high = m_numBatches;
+        while (low < high)
+        {
+            std::size_t mid = (low + high) / 2;
+            if (m_batches[mid]->base < ptr)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    /**
+     * Find the position of the batch containing the pointer.
+     *
+     * @return  the position of the batch.  m_numBatches if not found.
+     */
+    std::size_t
+    findBatch (const char* ptr) const
+    {
+        std::size_t pos = lowerBound (ptr);
+        if (pos < m_numBatches && m_batches[pos]->base == ptr)
+        {
+            return pos;
+        }
+        if (pos > 0 && ptr < m_batches[pos - 1]->base + m_minSize * m_batchCount)
+        {
+            return pos - 1;
+        }
+        return m_numBatches;
+    }
+
+    inline void
+    addAvail (Batch* batch)
+    {
+        batch->prevAvail = nullptr;
+        batch->nextAvail = m_availList;
+        if (m_availList)
+        {
+            m_availList->prevAvail = batch;
+        }
+        m_availList = batch;
+    }
+
+    inline void
+    removeAvail (Batch* batch)
+    {
+        if (batch->prevAvail)
+        {
+            batch->prevAvail->nextAvail = batch->nextAvail;
+        }
+        else if (m_availList == batch)
+        {
+            m_availList = batch->nextAvail;
+        }
+        if (batch->nextAvail)
+        {
+            batch->nextAvail->prevAvail = batch->prevAvail;
+        }
+        batch->prevAvail = nullptr;
+        batch->nextAvail = nullptr;
+    }
+
+    /**
+     * Get the index of the lowest bit set.  The value must not be 0.
+     */
+    static inline unsigned int
+    getLowestBit (std::uint64_t x)
+    {
+#if defined(__GNUC__)
+        return (unsigned int)__builtin_ctzll ((unsigned long long)x);
+#else
+        unsigned int index = 0;
+        while ((x & 1) == 0)
+        {
+            x >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+private:
+    std::size_t     m_minSize;
+    unsigned int    m_batchCount;
+    std::uint64_t   m_fullMap;
+    /** batches sorted by the address */
+    Batch**         m_batches;
+    std::size_t     m_numBatches;
+    std::size_t     m_maxBatches;
+    /** DLL of the batches with free segments */
+    Batch*          m_availList;
+    /** the empty batch kept */
+    Batch*          m_spare;
+    std::size_t     m_numMappings;
+    ArenaStats      m_stats;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_BATCH_MMAP_MEM_ARENA_H
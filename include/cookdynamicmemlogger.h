@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_DYNAMIC_MEM_LOGGER_H
+#define COOK_DYNAMIC_MEM_LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+#include "cookmemlogger.h"
+
+#if defined(__GNUC__)
+#define COOKMEM_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define COOKMEM_NOINLINE __declspec(noinline)
+#else
+#define COOKMEM_NOINLINE
+#endif
+
+namespace cookmem
+{
+
+/**
+ * Wraps a logger that is a template parameter style logger, such as
+ * StatsMemLogger or TraceMemLogger, into a MemLogger so that it can be
+ * installed in DynamicMemLogger.
+ */
+template<class Logger>
+class MemLoggerSink : public MemLogger
+{
+public:
+    MemLoggerSink (Logger& logger)
+    : m_logger (logger)
+    {
+    }
+
+    virtual void
+    logGetSegment (void* segment, std::size_t segmentSize)
+    {
+        m_logger.logGetSegment (segment, segmentSize);
+    }
+
+    virtual void
+    logFreeSegment (void* segment, std::size_t segmentSize)
+    {
+        m_logger.logFreeSegment (segment, segmentSize);
+    }
+
+    virtual void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        m_logger.logAllocation (userPtr, userSize);
+    }
+
+    virtual void
+    logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        m_logger.logReallocation (userPtr, oldUserSize, newUserSize);
+    }
+
+    virtual void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        m_logger.logDeallocation (userPtr, userSize);
+    }
+
+    virtual void
+    logError (void* userPtr, MemError_et error)
+    {
+        m_logger.logError (userPtr, error);
+    }
+
+    virtual void
+    logReleaseAll ()
+    {
+        logReleaseAll (std::integral_constant<bool, LoggerHasReleaseAll<Logger>::value> ());
+    }
+
+    virtual void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize)
+    {
+        logUsableSize (userPtr, oldUsableSize, newUsableSize, std::integral_constant<bool, LoggerHasUsableSize<Logger>::value> ());
+    }
+
+    /**
+     * Get the logger wrapped.
+     *
+     * @return  the logger wrapped.
+     */
+    Logger&
+    getLogger ()
+    {
+        return m_logger;
+    }
+
+private:
+    inline void
+    logReleaseAll (std::true_type)
+    {
+        m_logger.logReleaseAll ();
+    }
+
+    inline void
+    logReleaseAll (std::false_type)
+    {
+    }
+
+    inline void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize, std::true_type)
+    {
+        m_logger.logUsableSize (userPtr, oldUsableSize, newUsableSize);
+    }
+
+    inline void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize, std::false_type)
+    {
+    }
+
+private:
+    Logger&     m_logger;
+};
+
+/**
+ * A MemLogger that forwards the events to a chain of sinks installed at
+ * runtime, so that statistics, tracing or sampling can be turned on and
+ * off without recompiling.
+ *
+ * When no sink is installed, each call costs a single load and a well
+ * predicted branch, so it can be used in place of NoActionMemLogger.
+ *
+ * Sinks can be attached and detached while the memory context is in use,
+ * including from another thread.  A sink only sees the events that happen
+ * while it is attached.  For example, a StatsMemLogger attached to a live
+ * context sees the deallocations of the memory allocated before, so its
+ * live byte counts are only meaningful as differences.  A detached sink
+ * may still receive a call already in progress on the thread using the
+ * context, so it should be kept alive until that thread is known to have
+ * returned from the memory context.  While a sink is being detached, the
+ * other sinks may miss or see twice an event happening at the same time.
+ *
+ * Errors are passed to the sinks in order.  If none of them throws, an
+ * Exception is thrown the same way as NoActionMemLogger.
+ */
+class DynamicMemLogger
+{
+public:
+    /** the maximum number of sinks */
+    static const std::size_t MAX_SINKS = 8;
+
+public:
+    DynamicMemLogger ()
+    : m_numSinks (0)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            m_sinks[i].store (nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Install a sink at the end of the chain.
+     *
+     * @param   sink
+     *          the sink to be installed.
+     * @return  true if there is an error, such as the sink is nullptr,
+     *          already installed, or there are too many sinks.  false is
+     *          okay.
+     */
+    bool
+    attach (MemLogger* sink)
+    {
+        std::size_t numSinks = m_numSinks.load (std::memory_order_relaxed);
+        if (sink == nullptr || numSinks == MAX_SINKS || find (sink) < numSinks)
+        {
+            return true;
+        }
+        m_sinks[numSinks].store (sink, std::memory_order_release);
+        m_numSinks.store (numSinks + 1, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * Remove a sink from the chain.
+     *
+     * @param   sink
+     *          the sink to be removed.
+     * @return  true if the sink is not installed.  false is okay.
+     */
+    bool
+    detach (MemLogger* sink)
+    {
+        std::size_t numSinks = m_numSinks.load (std::memory_order_relaxed);
+        std::size_t index = find (sink);
+        if (index >= numSinks)
+        {
+            return true;
+        }
+        for (; index + 1 < numSinks; ++index)
+        {
+            m_sinks[index].store (m_sinks[index + 1].load (std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        m_numSinks.store (numSinks - 1, std::memory_order_release);
+        m_sinks[numSinks - 1].store (nullptr, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * Remove all the sinks.
+     */
+    void
+    detachAll ()
+    {
+        std::size_t numSinks = m_numSinks.load (std::memory_order_relaxed);
+        m_numSinks.store (0, std::memory_order_release);
+        for (std::size_t i = 0; i < numSinks; ++i)
+        {
+            m_sinks[i].store (nullptr, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Get the number of sinks installed.
+     *
+     * @return  the number of sinks installed.
+     */
+    std::size_t
+    getNumSinks () const
+    {
+        return m_numSinks.load (std::memory_order_relaxed);
+    }
+
+    inline void
+    logGetSegment (void* segment, std::size_t segmentSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardGetSegment (segment, segmentSize);
+        }
+    }
+
+    inline void
+    logFreeSegment (void* segment, std::size_t segmentSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardFreeSegment (segment, segmentSize);
+        }
+    }
+
+    inline void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardAllocation (userPtr, userSize);
+        }
+    }
+
+    inline void
+    logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardReallocation (userPtr, oldUserSize, newUserSize);
+        }
+    }
+
+    inline void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardDeallocation (userPtr, userSize);
+        }
+    }
+
+    inline void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize)
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) != 0)
+        {
+            forwardUsableSize (userPtr, oldUsableSize, newUsableSize);
+        }
+    }
+
+    inline void
+    logReleaseAll ()
+    {
+        if (m_numSinks.load (std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logReleaseAll ();
+        }
+    }
+
+    inline void
+    logError (void* userPtr, MemError_et error)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logError (userPtr, error);
+        }
+        throw Exception (error, "memory corruption detected.");
+    }
+
+private:
+    DynamicMemLogger (const DynamicMemLogger&) = delete;
+    DynamicMemLogger& operator= (const DynamicMemLogger&) = delete;
+
+    // The forwarding is kept out of the log functions, so that only the
+    // check for sinks gets inlined into the MemPool functions.
+
+    COOKMEM_NOINLINE void
+    forwardGetSegment (void* segment, std::size_t segmentSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logGetSegment (segment, segmentSize);
+        }
+    }
+
+    COOKMEM_NOINLINE void
+    forwardFreeSegment (void* segment, std::size_t segmentSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logFreeSegment (segment, segmentSize);
+        }
+    }
+
+    COOKMEM_NOINLINE void
+    forwardAllocation (void* userPtr, std::size_t userSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logAllocation (userPtr, userSize);
+        }
+    }
+
+    COOKMEM_NOINLINE void
+    forwardReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logReallocation (userPtr, oldUserSize, newUserSize);
+        }
+    }
+
+    COOKMEM_NOINLINE void
+    forwardDeallocation (void* userPtr, std::size_t userSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logDeallocation (userPtr, userSize);
+        }
+    }
+
+    COOKMEM_NOINLINE void
+    forwardUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize)
+    {
+        for (std::size_t i = 0; i < MAX_SINKS; ++i)
+        {
+            MemLogger* sink = getSink (i);
+            if (sink == nullptr)
+            {
+                break;
+            }
+            sink->logUsableSize (userPtr, oldUsableSize, newUsableSize);
+        }
+    }
+
+    inline MemLogger*
+    getSink (std::size_t index)
+    {
+        return m_sinks[index].load (std::memory_order_acquire);
+    }
+
+    std::size_t
+    find (MemLogger* sink) const
+    {
+        std::size_t numSinks = m_numSinks.load (std::memory_order_relaxed);
+        for (std::size_t i = 0; i < numSinks; ++i)
+        {
+            if (m_sinks[i].load (std::memory_order_relaxed) == sink)
+            {
+                return i;
+            }
+        }
+        return MAX_SINKS;
+    }
+
+private:
+    std::atomic<std::size_t>    m_numSinks;
+    std::atomic<MemLogger*>     m_sinks[MAX_SINKS];
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_DYNAMIC_MEM_LOGGER_H
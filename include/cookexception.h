@@ -25,6 +25,8 @@ typedef enum
     MEM_ERROR_ASSERT,       // assertion failure
     MEM_ERROR_DOUBLE_FREE,  // freeing an already free pointer
     MEM_ERROR_PADDING,      // padding byte error
+    MEM_ERROR_OWNER_DEAD,   // a process died while holding a shared pool lock
+    MEM_ERROR_ARENA_CALL,   // an arena call made after the pool was warmed up
 }  MemError_et;
 
 /**
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_FILE_MMAP_MEM_ARENA_H
+#define COOK_FILE_MMAP_MEM_ARENA_H
+
+#ifndef WIN32
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cookregionarena.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+// Older kernels treat the unknown flag as a hint, which is checked anyways.
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace cookmem
+{
+
+/**
+ * A memory arena backed by a memory mapped file at a fixed base address.
+ *
+ * Since the file is always mapped at the same address, the pointers stored
+ * in the memory remain valid when the file is mapped again by a restarted
+ * process.  MemPool::reattach () can then rebuild the pool from the
+ * segments found in the file.
+ */
+class FileMmapArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * If the file exists, it is mapped and its segments are attached.
+     * Otherwise, the file is created with the capacity requested.  An
+     * existing file that was not created by FileMmapArena at the same base
+     * address is left untouched, and the arena is not opened.
+     *
+     * @param   path
+     *          the file path.
+     * @param   base
+     *          the fixed base address to map the file.  It needs to be
+     *          page aligned.
+     * @param   capacity
+     *          the size of the file.  If the file already exists, the
+     *          existing file size is used instead.
+     */
+    FileMmapArena (const char* path, void* base, std::size_t capacity)
+    : m_fd (-1),
+      m_ptr (nullptr),
+      m_capacity (0),
+      m_attached (false),
+      m_region ()
+    {
+        map (open (path, O_RDWR | O_CREAT, 0600), base, capacity);
+    }
+
+    /**
+     * Constructor.
+     *
+     * The file descriptor is owned by the arena and is closed when the
+     * arena is destroyed.  If the file is not empty, it is mapped and its
+     * segments are attached.  Otherwise, the file is extended to the
+     * capacity requested.  A file that is not empty and was not created by
+     * FileMmapArena at the same base address is left untouched, and the
+     * arena is not opened.
+     *
+     * @param   fd
+     *          the file descriptor.
+     * @param   base
+     *          the fixed base address to map the file.  It needs to be
+     *          page aligned.  nullptr lets the system choose the address,
+     *          which is only useful if the mapping is inherited by child
+     *          processes.
+     * @param   capacity
+     *          the size of the file.  If the file is not empty, the
+     *          existing file size is used instead.
+     */
+    FileMmapArena (int fd, void* base, std::size_t capacity)
+    : m_fd (-1),
+      m_ptr (nullptr),
+      m_capacity (0),
+      m_attached (false),
+      m_region ()
+    {
+        map (fd, base, capacity);
+    }
+
+    /**
+     * Destructor.
+     *
+     * The file is unmapped.  Segments not released remain in the file.
+     */
+    ~FileMmapArena ()
+    {
+        close ();
+    }
+
+    /**
+     * Check if the file was successfully mapped.
+     *
+     * @return  true if the file is mapped.  false otherwise.
+     */
+    bool
+    isOpen () const
+    {
+        return m_ptr != nullptr;
+    }
+
+    /**
+     * Check if an existing heap was found in the file.
+     *
+     * @return  true if the segments in the file were attached.
+     */
+    bool
+    isAttached () const
+    {
+        return m_attached;
+    }
+
+    /**
+     * Allocate an arena segment from the file.
+     *
+     * @param   size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr is allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        return m_region.getSegment (size);
+    }
+
+    /**
+     * Free an arena segment.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        return m_region.freeSegment (ptr, size);
+    }
+
+    /**
+     * Iterate through the segments in the file.
+     *
+     * @param   ptr
+     *          the previous segment obtained from this function.  nullptr
+     *          to get the first segment.
+     * @param [out] size
+     *          the size of the segment returned.
+     * @return  the next segment.  nullptr if there are no more.
+     */
+    void*
+    nextSegment (void* ptr, std::size_t& size)
+    {
+        return m_region.nextSegment (ptr, size);
+    }
+
+    /**
+     * Get the user data root pointer saved in the file.
+     *
+     * @return  the root pointer.
+     */
+    void*
+    getRoot () const
+    {
+        return m_region.getRoot ();
+    }
+
+    /**
+     * Save a user data root pointer in the file.
+     *
+     * @param   root
+     *          the root pointer.
+     */
+    void
+    setRoot (void* root)
+    {
+        m_region.setRoot (root);
+    }
+
+    /**
+     * Flush the memory to the file.
+     *
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    sync ()
+    {
+        return m_ptr == nullptr || msync (m_ptr, m_capacity, MS_SYNC) != 0;
+    }
+
+    /**
+     * Get the region the segments are carved from.
+     *
+     * @return  the region arena.
+     */
+    RegionArena&
+    getRegion ()
+    {
+        return m_region;
+    }
+
+protected:
+    /**
+     * Constructor for the derived classes that open the file themselves
+     * and then call map ().
+     */
+    FileMmapArena ()
+    : m_fd (-1),
+      m_ptr (nullptr),
+      m_capacity (0),
+      m_attached (false),
+      m_region ()
+    {
+    }
+
+    /**
+     * Map a file.  The file descriptor is closed if the file cannot be
+     * mapped.
+     *
+     * @param   fd
+     *          the file descriptor.
+     * @param   base
+     *          the fixed base address to map the file.
+     * @param   capacity
+     *          the size of the file if it is empty.
+     */
+    void
+    map (int fd, void* base, std::size_t capacity)
+    {
+        m_fd = fd;
+        if (m_fd < 0)
+        {
+            return;
+        }
+
+        struct stat st;
+        if (fstat (m_fd, &st) != 0)
+        {
+            close ();
+            return;
+        }
+        bool existing = st.st_size > 0;
+        if (existing)
+        {
+            capacity = (std::size_t)st.st_size;
+        }
+        else if (ftruncate (m_fd, (off_t)capacity) != 0)
+        {
+            close ();
+            return;
+        }
+
+        int flag = base ? (MAP_SHARED | MAP_FIXED_NOREPLACE) : MAP_SHARED;
+        void* ptr = mmap (base, capacity, PROT_READ | PROT_WRITE, flag, m_fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            close ();
+            return;
+        }
+        if (base && ptr != base)
+        {
+            munmap (ptr, capacity);
+            close ();
+            return;
+        }
+        m_ptr = ptr;
+        m_capacity = capacity;
+        if (existing && !RegionArena::isRegion (ptr, capacity))
+        {
+            // not our heap, the mapping is shared so do not touch it.
+            close ();
+            return;
+        }
+        m_attached = m_region.init (ptr, capacity, existing);
+    }
+
+    /**
+     * Unmap and close the file.
+     */
+    void
+    close ()
+    {
+        if (m_ptr)
+        {
+            munmap (m_ptr, m_capacity);
+            m_ptr = nullptr;
+        }
+        if (m_fd >= 0)
+        {
+            ::close (m_fd);
+            m_fd = -1;
+        }
+        m_region = RegionArena ();
+    }
+
+private:
+    FileMmapArena (const FileMmapArena&) = delete;
+    FileMmapArena& operator= (const FileMmapArena&) = delete;
+
+private:
+    int             m_fd;
+    void*           m_ptr;
+    std::size_t     m_capacity;
+    bool            m_attached;
+    RegionArena     m_region;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_FILE_MMAP_MEM_ARENA_H
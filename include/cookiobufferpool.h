@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_IO_BUFFER_POOL_H
+#define COOK_IO_BUFFER_POOL_H
+
+#include <cstddef>
+#include <new>
+
+#include "cookmmaparena.h"
+
+namespace cookmem
+{
+
+/**
+ * An IoBufferHook is notified when an IoBufferPool obtains or releases a
+ * segment of buffers.  It can be used to register the buffers with the
+ * kernel or a device, such as io_uring fixed buffers or RDMA memory
+ * regions, such that the buffers are pinned once rather than per I/O.
+ *
+ * This class does nothing.
+ */
+class NoActionIoBufferHook
+{
+public:
+    NoActionIoBufferHook ()
+    {
+    }
+
+    /**
+     * Called after a segment of buffers is obtained from the arena.
+     *
+     * @param   ptr
+     *          the first buffer of the segment.
+     * @param   size
+     *          the total size of the buffers in the segment.
+     * @return  true if there is an error, in which case the segment is
+     *          returned to the arena.  false is okay.
+     */
+    inline bool registerSegment (void* ptr, std::size_t size) { return false; }
+
+    /**
+     * Called before a segment of buffers is returned to the arena.
+     *
+     * @param   ptr
+     *          the first buffer of the segment.
+     * @param   size
+     *          the total size of the buffers in the segment.
+     */
+    inline void unregisterSegment (void* ptr, std::size_t size) { }
+};
+
+/**
+ * A pool of fixed size buffers suitable for direct I/O.
+ *
+ * Every buffer is aligned to IO_ALIGNMENT and its size is a multiple of
+ * IO_ALIGNMENT.  Buffers are carved from segments obtained from the arena,
+ * and the released buffers are kept in a free list.  Segments are only
+ * returned to the arena by releaseAll () or the destructor.
+ *
+ * The arena should return page aligned segments, such as MmapArena and
+ * CachedArena<MmapArena>.  Otherwise, the part of the segment before the
+ * first aligned address is wasted.
+ */
+template<class Arena = MmapArena, class Hook = NoActionIoBufferHook>
+class IoBufferPool
+{
+public:
+    /**
+     * The alignment of the buffers, as well as the granularity of the
+     * buffer size.
+     */
+    static const std::size_t IO_ALIGNMENT = 4096;
+
+private:
+    /**
+     * Internal free buffer list node stored in the buffer itself.
+     */
+    struct FreeBuffer
+    {
+        FreeBuffer* next;
+    };
+
+    /**
+     * Internal segment record.
+     */
+    struct Segment
+    {
+        Segment*    next;
+        void*       ptr;
+        std::size_t size;
+        char*       buffers;
+        std::size_t numBuffers;
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   arena
+     *          the memory arena.
+     * @param   bufferSize
+     *          the size of each buffer.  It is rounded up to a multiple of
+     *          IO_ALIGNMENT.
+     * @param   buffersPerSegment
+     *          the number of buffers to request from the arena at a time.
+     */
+    IoBufferPool (Arena&        arena,
+                  std::size_t   bufferSize = 65536,
+                  std::size_t   buffersPerSegment = 16)
+    : m_arena (arena),
+      m_hook (),
+      m_bufferSize ((bufferSize + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1)),
+      m_buffersPerSegment (buffersPerSegment ? buffersPerSegment : 1),
+      m_segList (nullptr),
+      m_freeList (nullptr),
+      m_numBuffers (0),
+      m_numFreeBuffers (0)
+    {
+        if (m_bufferSize == 0)
+        {
+            m_bufferSize = IO_ALIGNMENT;
+        }
+    }
+
+    /**
+     * Destructor.
+     *
+     * It releases all the segments.
+     */
+    ~IoBufferPool ()
+    {
+        releaseAll ();
+    }
+
+    /**
+     * Allocate a buffer.
+     *
+     * @return  a buffer of getBufferSize () bytes.  nullptr if the request
+     *          cannot be satisfied.
+     */
+    void*
+    allocate ()
+    {
+        if (m_freeList == nullptr && addSegment ())
+        {
+            return nullptr;
+        }
+        FreeBuffer* buffer = m_freeList;
+        m_freeList = buffer->next;
+        --m_numFreeBuffers;
+        return buffer;
+    }
+
+    /**
+     * Release a buffer previously allocated by this pool.
+     *
+     * @param   ptr
+     *          the buffer to be released.
+     */
+    void
+    deallocate (void* ptr)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+        FreeBuffer* buffer = (FreeBuffer*)ptr;
+        buffer->next = m_freeList;
+        m_freeList = buffer;
+        ++m_numFreeBuffers;
+    }
+
+    /**
+     * Check if a pointer is a buffer of this pool.
+     *
+     * @param   ptr
+     *          memory pointer
+     * @return  true if the pointer is the start of a buffer of this pool.
+     */
+    bool
+    contains (const void* ptr) const
+    {
+        const char* p = (const char*)ptr;
+        for (Segment* seg = m_segList; seg; seg = seg->next)
+        {
+            if (p >= seg->buffers && p < seg->buffers + seg->numBuffers * m_bufferSize)
+            {
+                return ((std::size_t)(p - seg->buffers) % m_bufferSize) == 0;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Release all the segments back to the arena.  All the buffers
+     * allocated from this pool become invalid.
+     */
+    void
+    releaseAll ()
+    {
+        Segment* seg = m_segList;
+        while (seg)
+        {
+            Segment* next = seg->next;
+            m_hook.unregisterSegment (seg->buffers, seg->numBuffers * m_bufferSize);
+            m_arena.freeSegment (seg->ptr, seg->size);
+            delete seg;
+            seg = next;
+        }
+        m_segList = nullptr;
+        m_freeList = nullptr;
+        m_numBuffers = 0;
+        m_numFreeBuffers = 0;
+    }
+
+    /**
+     * Get the size of each buffer.
+     *
+     * @return  the buffer size.
+     */
+    std::size_t
+    getBufferSize () const
+    {
+        return m_bufferSize;
+    }
+
+    /**
+     * Get the total number of buffers obtained from the arena.
+     *
+     * @return  the number of buffers.
+     */
+    std::size_t
+    getNumBuffers () const
+    {
+        return m_numBuffers;
+    }
+
+    /**
+     * Get the number of buffers in the free list.
+     *
+     * @return  the number of free buffers.
+     */
+    std::size_t
+    getNumFreeBuffers () const
+    {
+        return m_numFreeBuffers;
+    }
+
+    /**
+     * Get the registration hook.
+     *
+     * @return  the registration hook.
+     */
+    Hook&
+    getHook ()
+    {
+        return m_hook;
+    }
+
+private:
+    IoBufferPool (const IoBufferPool&) = delete;
+    IoBufferPool& operator= (const IoBufferPool&) = delete;
+
+    /**
+     * Obtain a new segment from the arena and add its buffers to the free
+     * list.
+     *
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    addSegment ()
+    {
+        Segment* seg = new (std::nothrow) Segment ();
+        if (seg == nullptr)
+        {
+            return true;
+        }
+
+        std::size_t size = m_bufferSize * m_buffersPerSegment;
+        void* ptr = m_arena.getSegment (size);
+        if (ptr == nullptr)
+        {
+            delete seg;
+            return true;
+        }
+
+        // skip the unaligned part in the front
+        char* buffers = (char*)(((std::size_t)ptr + IO_ALIGNMENT - 1) & ~(IO_ALIGNMENT - 1));
+        std::size_t skip = buffers - (char*)ptr;
+        std::size_t numBuffers = size > skip ? (size - skip) / m_bufferSize : 0;
+        if (numBuffers == 0 ||
+            m_hook.registerSegment (buffers, numBuffers * m_bufferSize))
+        {
+            m_arena.freeSegment (ptr, size);
+            delete seg;
+            return true;
+        }
+
+        seg->next = m_segList;
+        seg->ptr = ptr;
+        seg->size = size;
+        seg->buffers = buffers;
+        seg->numBuffers = numBuffers;
+        m_segList = seg;
+
+        // add the buffers in the reverse order, so they are handed out in
+        // the address order.
+        for (std::size_t i = numBuffers; i > 0; --i)
+        {
+            FreeBuffer* buffer = (FreeBuffer*)(buffers + (i - 1) * m_bufferSize);
+            buffer->next = m_freeList;
+            m_freeList = buffer;
+        }
+        m_numBuffers += numBuffers;
+        m_numFreeBuffers += numBuffers;
+        return false;
+    }
+
+private:
+    Arena&          m_arena;
+    Hook            m_hook;
+    std::size_t     m_bufferSize;
+    std::size_t     m_buffersPerSegment;
+    /** SLL of segments obtained from the arena */
+    Segment*        m_segList;
+    /** SLL of free buffers */
+    FreeBuffer*     m_freeList;
+    std::size_t     m_numBuffers;
+    std::size_t     m_numFreeBuffers;
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_IO_BUFFER_POOL_H
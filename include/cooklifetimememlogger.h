@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_LIFETIME_MEM_LOGGER_H
+#define COOK_LIFETIME_MEM_LOGGER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+#include "cookmemlogger.h"
+#include "cookstatsmemlogger.h"
+
+namespace cookmem
+{
+
+/**
+ * The lifetime statistics of the sampled allocations of a size class or a
+ * caller tag.
+ */
+struct LifetimeStats
+{
+    /**
+     * The number of age buckets.  Bucket i counts the ages in
+     * [2^i, 2^(i+1)) nanoseconds, and the last bucket also counts anything
+     * older.
+     */
+    static const int NUM_AGE_BUCKETS = 48;
+
+    /** the number of allocations sampled */
+    std::size_t     numSampled;
+    /** the number of sampled allocations freed */
+    std::size_t     numFreed;
+    /** the number of sampled allocations still live at releaseAll () */
+    std::size_t     numSurvived;
+    /** the bytes of the sampled allocations */
+    std::size_t     sampledBytes;
+    /** the bytes of the sampled allocations still live at releaseAll () */
+    std::size_t     survivedBytes;
+    /** the total age of the freed allocations in nanoseconds */
+    std::uint64_t   totalAge;
+    /** the age histogram of the freed allocations */
+    std::size_t     ages[NUM_AGE_BUCKETS];
+
+    /**
+     * Get the age bucket of an age.
+     *
+     * @param   age
+     *          the age in nanoseconds.
+     * @return  the age bucket.
+     */
+    static int
+    getAgeBucket (std::uint64_t age)
+    {
+        int bucket = 0;
+        while (age > 1 && bucket < NUM_AGE_BUCKETS - 1)
+        {
+            age >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    /**
+     * Get the upper limit of an age bucket.
+     *
+     * @param   bucket
+     *          the age bucket.
+     * @return  the upper limit of the age bucket in nanoseconds.
+     */
+    static std::uint64_t
+    getAgeBucketLimit (int bucket)
+    {
+        return (std::uint64_t)1 << (bucket + 1);
+    }
+
+    /**
+     * Get an approximate percentile of the ages of the freed allocations.
+     *
+     * @param   percentile
+     *          the percentile between 0 and 1, such as 0.5 for the median.
+     * @return  the upper limit of the age bucket containing the
+     *          percentile.  0 if nothing has been freed.
+     */
+    std::uint64_t
+    getAgePercentile (double percentile) const
+    {
+        if (numFreed == 0)
+        {
+            return 0;
+        }
+        std::size_t target = (std::size_t)(percentile * numFreed);
+        std::size_t count = 0;
+        for (int i = 0; i < NUM_AGE_BUCKETS; ++i)
+        {
+            count += ages[i];
+            if (count > target)
+            {
+                return getAgeBucketLimit (i);
+            }
+        }
+        return getAgeBucketLimit (NUM_AGE_BUCKETS - 1);
+    }
+};
+
+/**
+ * A logger that measures how long the allocations live, from allocation
+ * to deallocation, grouped by size class and by caller tag.
+ *
+ * One in every so many allocations is sampled and timestamped.  When a
+ * sampled allocation is freed, its age is added to the histograms of its
+ * size class and of the tag that was current when it was allocated.  The
+ * sampled allocations still live when releaseAll () is called, or the
+ * memory pool is destroyed, are counted as survivors.
+ *
+ * Allocations that mostly survive until releaseAll () belong in a
+ * monotonic or per-tuple context that is reset as a whole.  Allocations
+ * with short ages can go to a short-lived child context, and the rest
+ * need the general pool.
+ *
+ * The tags should be string literals or otherwise outlive the logger,
+ * since they are compared and stored as pointers.  The internal tables use
+ * the global heap.  Memory corruptions are reported the same way as
+ * NoActionMemLogger.
+ */
+class LifetimeMemLogger
+{
+private:
+    /**
+     * A sampled allocation.
+     */
+    struct Record
+    {
+        std::uint64_t   time;
+        std::size_t     size;
+        const char*     tag;
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   sampleInterval
+     *          one in every this many allocations is sampled.  It is
+     *          rounded down to a power of 2.
+     */
+    LifetimeMemLogger (std::size_t sampleInterval = 16)
+    : m_counter (0),
+      m_sampleMask (0),
+      m_shortLivedAge (1000000),
+      m_tag (nullptr)
+    {
+        setSampleInterval (sampleInterval);
+        reset ();
+    }
+
+    /**
+     * Set how often the allocations are sampled.
+     *
+     * @param   sampleInterval
+     *          one in every this many allocations is sampled.  It is
+     *          rounded down to a power of 2.  0 or 1 samples every
+     *          allocation.
+     */
+    void
+    setSampleInterval (std::size_t sampleInterval)
+    {
+        std::size_t pow2 = 1;
+        while (pow2 <= sampleInterval / 2)
+        {
+            pow2 <<= 1;
+        }
+        m_sampleMask = pow2 - 1;
+    }
+
+    /**
+     * Set the age under which the allocations are considered short lived
+     * by printReport ().
+     *
+     * @param   age
+     *          the age in nanoseconds.  The default is 1 millisecond.
+     */
+    void
+    setShortLivedAge (std::uint64_t age)
+    {
+        m_shortLivedAge = age;
+    }
+
+    /**
+     * Set the caller tag of the following allocations.
+     *
+     * @param   tag
+     *          the tag, such as "hash join".  nullptr for untagged.
+     */
+    void
+    setTag (const char* tag)
+    {
+        m_tag = tag;
+    }
+
+    /**
+     * Get the current caller tag.
+     *
+     * @return  the current caller tag.
+     */
+    const char*
+    getTag () const
+    {
+        return m_tag;
+    }
+
+    /**
+     * Get the statistics of a size class.
+     *
+     * @param   sizeClass
+     *          the size class as defined by MemStats::getSizeClass ().
+     * @return  the statistics of the size class.
+     */
+    const LifetimeStats&
+    getSizeClassStats (int sizeClass) const
+    {
+        return m_sizeClasses[sizeClass];
+    }
+
+    /**
+     * Get the statistics of a caller tag.
+     *
+     * @param   tag
+     *          the caller tag.
+     * @return  the statistics of the tag.  nullptr if nothing was sampled
+     *          with the tag.
+     */
+    const LifetimeStats*
+    getTagStats (const char* tag) const
+    {
+        std::map<const char*, LifetimeStats>::const_iterator it = m_tags.find (tag);
+        return it == m_tags.end () ? nullptr : &it->second;
+    }
+
+    /**
+     * Get the number of sampled allocations that are still live.
+     *
+     * @return  the number of live samples.
+     */
+    std::size_t
+    getNumLive () const
+    {
+        return m_live.size ();
+    }
+
+    /**
+     * Clear all the statistics and the live samples.
+     */
+    void
+    reset ()
+    {
+        memset (m_sizeClasses, 0, sizeof(m_sizeClasses));
+        m_tags.clear ();
+        m_live.clear ();
+    }
+
+    /**
+     * Print the lifetime statistics of each size class and each tag.
+     *
+     * For each group, the report shows the number of samples, the
+     * percentage that survived until releaseAll (), the median and the 90th
+     * percentile ages of the freed allocations, and a suggestion of where
+     * the allocations should go.
+     *
+     * A group is suggested a monotonic context if at least 90% of it
+     * survived.  A group is suggested a short-lived child context if at
+     * most 10% of it survived, and both the median and the 90th percentile
+     * ages are within the short lived age, such that the child context can
+     * be reset soon after it is created.  The other groups are suggested
+     * the general pool.
+     *
+     * @param   file
+     *          the output file.
+     */
+    void
+    printReport (FILE* file) const
+    {
+        fprintf (file, "%-24s %10s %9s %12s %12s  %s\n", "group", "sampled", "survived", "p50_age_ns", "p90_age_ns", "suggestion");
+        char name[32];
+        for (int c = 0; c < MemStats::NUM_SIZE_CLASSES; ++c)
+        {
+            if (m_sizeClasses[c].numSampled)
+            {
+                snprintf (name, sizeof(name), "size <= %zu", MemStats::getSizeClassLimit (c));
+                printStats (file, name, m_sizeClasses[c]);
+            }
+        }
+        for (std::map<const char*, LifetimeStats>::const_iterator it = m_tags.begin (); it != m_tags.end (); ++it)
+        {
+            printStats (file, it->first ? it->first : "(untagged)", it->second);
+        }
+    }
+
+    inline void logGetSegment (void* segment, std::size_t segmentSize) { }
+
+    inline void logFreeSegment (void* segment, std::size_t segmentSize) { }
+
+    inline void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        if (userPtr == nullptr || (++m_counter & m_sampleMask) != 0)
+        {
+            return;
+        }
+        Record& record = m_live[userPtr];
+        record.time = now ();
+        record.size = userSize;
+        record.tag = m_tag;
+
+        LifetimeStats& sc = m_sizeClasses[MemStats::getSizeClass (userSize)];
+        LifetimeStats& tag = m_tags[m_tag];
+        ++sc.numSampled;
+        ++tag.numSampled;
+        sc.sampledBytes += userSize;
+        tag.sampledBytes += userSize;
+    }
+
+    inline void logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize) { }
+
+    inline void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        if (m_live.empty () || userPtr == nullptr)
+        {
+            return;
+        }
+        std::unordered_map<void*, Record>::iterator it = m_live.find (userPtr);
+        if (it == m_live.end ())
+        {
+            return;
+        }
+        const Record& record = it->second;
+        std::uint64_t age = now () - record.time;
+        int bucket = LifetimeStats::getAgeBucket (age);
+
+        LifetimeStats& sc = m_sizeClasses[MemStats::getSizeClass (record.size)];
+        LifetimeStats& tag = m_tags[record.tag];
+        ++sc.numFreed;
+        ++tag.numFreed;
+        sc.totalAge += age;
+        tag.totalAge += age;
+        ++sc.ages[bucket];
+        ++tag.ages[bucket];
+        m_live.erase (it);
+    }
+
+    /**
+     * Count the live samples as survivors, since the memory is about to
+     * be released all at once.
+     */
+    void
+    logReleaseAll ()
+    {
+        for (std::unordered_map<void*, Record>::const_iterator it = m_live.begin (); it != m_live.end (); ++it)
+        {
+            const Record& record = it->second;
+            LifetimeStats& sc = m_sizeClasses[MemStats::getSizeClass (record.size)];
+            LifetimeStats& tag = m_tags[record.tag];
+            ++sc.numSurvived;
+            ++tag.numSurvived;
+            sc.survivedBytes += record.size;
+            tag.survivedBytes += record.size;
+        }
+        m_live.clear ();
+    }
+
+    inline void
+    logError (void* userPtr, MemError_et error)
+    {
+        throw Exception (error, "memory corruption detected.");
+    }
+
+private:
+    LifetimeMemLogger (const LifetimeMemLogger&) = delete;
+    LifetimeMemLogger& operator= (const LifetimeMemLogger&) = delete;
+
+    static inline std::uint64_t
+    now ()
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    }
+
+    void
+    printStats (FILE* file, const char* name, const LifetimeStats& stats) const
+    {
+        double survived = 100.0 * stats.numSurvived / stats.numSampled;
+        std::uint64_t p50 = stats.getAgePercentile (0.5);
+        std::uint64_t p90 = stats.getAgePercentile (0.9);
+        const char* suggestion;
+        if (survived >= 90)
+        {
+            suggestion = "monotonic context";
+        }
+        else if (stats.numFreed + stats.numSurvived < stats.numSampled)
+        {
+            // some allocations are neither freed nor released yet
+            suggestion = "-";
+        }
+        else if (survived <= 10 && p50 <= m_shortLivedAge && p90 <= m_shortLivedAge)
+        {
+            suggestion = "short-lived child context";
+        }
+        else
+        {
+            suggestion = "general pool";
+        }
+        fprintf (file, "%-24s %10zu %8.1f%% %12llu %12llu  %s\n",
+                 name,
+                 stats.numSampled,
+                 survived,
+                 (unsigned long long)p50,
+                 (unsigned long long)p90,
+                 suggestion);
+    }
+
+private:
+    std::size_t                             m_counter;
+    std::size_t                             m_sampleMask;
+    std::uint64_t                           m_shortLivedAge;
+    const char*                             m_tag;
+    LifetimeStats                           m_sizeClasses[MemStats::NUM_SIZE_CLASSES];
+    std::map<const char*, LifetimeStats>    m_tags;
+    std::unordered_map<void*, Record>       m_live;
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_LIFETIME_MEM_LOGGER_H
@@ -17,8 +17,12 @@
 #define COOK_MEM_ARENA_H
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
 
 #include "cookptravltree.h"
+#include "cookregionarena.h"
 
 namespace cookmem
 {
@@ -130,12 +134,165 @@ public:
         return false;
     }
 
+    /**
+     * Check if a pointer is within the buffer.
+     *
+     * @param   ptr
+     *          memory pointer
+     * @return  true if the pointer is in the buffer.  false otherwise.
+     */
+    bool
+    contains (const void* ptr) const
+    {
+        return (const char*)ptr >= (const char*)m_page &&
+               (const char*)ptr < (const char*)m_page + m_size;
+    }
+
 private:
     void*       m_page;
     std::size_t m_size;
     bool        m_used;
 };
 
+/**
+ * Similar to FixedArena, this memory arena wraps around a piece of memory.
+ * However, the memory is carved into multiple segments of variable sizes,
+ * so several memory contexts can share the same buffer, and a segment
+ * released can be reused.  Adjacent free segments are coalesced.
+ *
+ * No system calls are made by this arena.  Like CachedArena, this class is
+ * not thread safe.
+ */
+class MultiFixedArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   ptr
+     *          the memory buffer for memory allocation.
+     * @param   size
+     *          the size of the memory pointer.
+     */
+    MultiFixedArena (void* ptr, std::size_t size)
+    : m_region ()
+    {
+        std::size_t remain = (std::size_t)ptr & 0xfUL;
+        if (remain)
+        {
+            std::size_t inc = (0x10 - remain);
+            if (size <= inc)
+            {
+                return;
+            }
+            ptr = (void*)((char*)ptr + inc);
+            size -= inc;
+        }
+        m_region.init (ptr, size);
+    }
+
+    /**
+     * Allocate an arena segment.
+     *
+     * @param [in,out]  size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr if allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        return m_region.getSegment (size);
+    }
+
+    /**
+     * Free an arena segment.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        return m_region.freeSegment (ptr, size);
+    }
+
+    /**
+     * Check if a pointer is within the segments carved from the buffer.
+     *
+     * @param   ptr
+     *          memory pointer
+     * @return  true if the pointer is in the buffer.  false otherwise.
+     */
+    bool
+    contains (const void* ptr) const
+    {
+        return m_region.contains (ptr);
+    }
+
+    /**
+     * Get the number of bytes of the buffer used, including the free
+     * segments that are not at the end of the buffer.
+     *
+     * @return  the number of bytes used.
+     */
+    std::size_t
+    getUsedSize () const
+    {
+        return m_region.getUsedSize ();
+    }
+
+private:
+    RegionArena m_region;
+};
+
+/**
+ * Segment cache statistics of CachedArena and BucketCachedArena.
+ */
+struct CacheStats
+{
+    /** the number of getSegment calls satisfied by a cached segment */
+    std::size_t     numHits;
+    /** the number of getSegment calls passed to the underlying arena */
+    std::size_t     numMisses;
+    /** the number of segments currently cached */
+    std::size_t     numCached;
+    /** the number of bytes currently cached */
+    std::size_t     cachedBytes;
+
+    CacheStats ()
+    : numHits (0),
+      numMisses (0),
+      numCached (0),
+      cachedBytes (0)
+    {
+    }
+
+    /**
+     * Record a segment taken from the cache.
+     */
+    inline void
+    hit (std::size_t size)
+    {
+        ++numHits;
+        --numCached;
+        cachedBytes -= size;
+    }
+
+    /**
+     * Record a segment put into the cache.
+     */
+    inline void
+    put (std::size_t size)
+    {
+        ++numCached;
+        cachedBytes += size;
+    }
+};
+
 /**
  * CachedArena is used to cache the segments released and see if they can be
  * reused in the future segment request.
@@ -173,8 +330,10 @@ public:
         void* seg = m_tree.remove(size);
         if (seg)
         {
+            m_stats.hit (size);
             return seg;
         }
+        ++m_stats.numMisses;
         return m_arena.getSegment(size);
     }
 
@@ -194,14 +353,609 @@ public:
     freeSegment (void* ptr, std::size_t size)
     {
         m_tree.add (ptr, size);
+        m_stats.put (size);
         return false;
     }
 
+    /**
+     * Get the segment cache statistics.
+     *
+     * @return  the segment cache statistics.
+     */
+    const CacheStats&
+    getCacheStats () const
+    {
+        return m_stats;
+    }
+
 private:
     Arena&      m_arena;
     PtrAVLTree  m_tree;
+    CacheStats  m_stats;
 };
 
+/**
+ * BucketCachedArena caches the released segments in buckets keyed by the
+ * size class of the segment, which is the position of the highest bit of
+ * the segment size.
+ *
+ * A bitmap of the non-empty buckets is maintained such that both get and
+ * put are constant time operations.  The trade off compared to CachedArena
+ * is that a request may be satisfied by a segment up to twice the size
+ * requested, even if a closer match exists in a larger bucket.
+ */
+template<class Arena>
+class BucketCachedArena
+{
+private:
+    /**
+     * Internal cached segment header stored in the segment itself.
+     */
+    struct Node
+    {
+        /** next segment in the same bucket */
+        Node*           next;
+        /** size of the segment */
+        std::size_t     size;
+    };
+
+    /**
+     * The number of size classes.
+     */
+    static const unsigned int   NBUCKETS = sizeof(std::uint64_t) * 8;
+
+public:
+    /**
+     * Constructor
+     *
+     * @param   arena
+     *          the memory arena that does the actual memory allocation
+     */
+    BucketCachedArena (Arena& arena)
+    : m_arena (arena),
+      m_bucketMap (0),
+      m_buckets (),
+      m_stats ()
+    {
+    }
+
+    /**
+     * Destructor.
+     *
+     * The cached segments are returned to the underlying arena.
+     */
+    ~BucketCachedArena ()
+    {
+        for (unsigned int i = 0; i < NBUCKETS; ++i)
+        {
+            Node* node = m_buckets[i];
+            while (node)
+            {
+                Node* next = node->next;
+                m_arena.freeSegment (node, node->size);
+                node = next;
+            }
+        }
+    }
+
+    /**
+     * Allocate an arena segment.
+     *
+     * It first checks the head of the bucket of the same size class, then
+     * the head of the smallest non-empty larger bucket.  If neither can
+     * satisfy the request, it calls the actual memory arena to allocate
+     * the segment.
+     *
+     * @param [in,out]  size
+     *          the size of the page.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr is allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        if (m_bucketMap != 0)
+        {
+            unsigned int index = getBucketIndex (size);
+            Node* node = m_buckets[index];
+            if (node == nullptr || node->size < size)
+            {
+                // Any segment in a larger bucket is big enough.
+                std::uint64_t largerMap = (index + 1 < NBUCKETS) ? (m_bucketMap & ((~(std::uint64_t)0) << (index + 1))) : 0;
+                if (largerMap == 0)
+                {
+                    ++m_stats.numMisses;
+                    return m_arena.getSegment (size);
+                }
+                index = getLowestBit (largerMap);
+                node = m_buckets[index];
+            }
+
+            m_buckets[index] = node->next;
+            if (node->next == nullptr)
+            {
+                m_bucketMap &= ~((std::uint64_t)1 << index);
+            }
+            size = node->size;
+            m_stats.hit (size);
+            return node;
+        }
+        ++m_stats.numMisses;
+        return m_arena.getSegment (size);
+    }
+
+    /**
+     * Free an arena segment.
+     *
+     * The segment release is cached for the next get attempt that
+     * can be satisfied.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  false.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        Node* node = reinterpret_cast<Node*>(ptr);
+        node->size = size;
+        m_stats.put (size);
+
+        unsigned int index = getBucketIndex (size);
+        Node* head = m_buckets[index];
+        if (head == nullptr || head->size <= size)
+        {
+            // Keep the largest known segment of the bucket at the head
+            // so that the same size class check is more likely to succeed.
+            node->next = head;
+            m_buckets[index] = node;
+            m_bucketMap |= (std::uint64_t)1 << index;
+        }
+        else
+        {
+            node->next = head->next;
+            head->next = node;
+        }
+        return false;
+    }
+
+    /**
+     * Check if there are no cached segments.
+     *
+     * @return  true if no segments are cached.  false otherwise.
+     */
+    bool
+    isEmpty () const
+    {
+        return m_bucketMap == 0;
+    }
+
+    /**
+     * Get the segment cache statistics.
+     *
+     * @return  the segment cache statistics.
+     */
+    const CacheStats&
+    getCacheStats () const
+    {
+        return m_stats;
+    }
+
+private:
+    /**
+     * Get the size class of a size, which is the index of the highest bit.
+     * A size of 0 is in the same size class as 1.
+     */
+    static inline unsigned int
+    getBucketIndex (std::size_t size)
+    {
+#if defined(__GNUC__)
+        if (size == 0)
+        {
+            return 0;
+        }
+        return (unsigned int)(sizeof(unsigned long long) * 8 - 1 - __builtin_clzll ((unsigned long long)size));
+#else
+        unsigned int index = 0;
+        while (size >>= 1)
+        {
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    /**
+     * Get the index of the lowest bit set.  The value must not be 0.
+     */
+    static inline unsigned int
+    getLowestBit (std::uint64_t x)
+    {
+#if defined(__GNUC__)
+        return (unsigned int)__builtin_ctzll ((unsigned long long)x);
+#else
+        unsigned int index = 0;
+        while ((x & 1) == 0)
+        {
+            x >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+private:
+    Arena&          m_arena;
+    /** bitmap of the non-empty buckets */
+    std::uint64_t   m_bucketMap;
+    /** SLL of cached segments for each size class */
+    Node*           m_buckets[NBUCKETS];
+    CacheStats      m_stats;
+};
+
+/**
+ * FallbackArena obtains segments from the primary arena first, and falls
+ * back to the secondary arena if the primary arena cannot satisfy the
+ * request.
+ *
+ * The primary arena is typically a FixedArena or MultiFixedArena on a
+ * small buffer, such that the common case does not make system calls, and
+ * the secondary arena is MmapArena or CachedArena for the oversized cases.
+ * The primary arena needs to provide a contains function to tell which
+ * arena a segment belongs to.
+ */
+template<class Primary, class Secondary>
+class FallbackArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   primary
+     *          the arena to try first.
+     * @param   secondary
+     *          the arena to use when the primary arena cannot satisfy the
+     *          request.
+     */
+    FallbackArena (Primary& primary, Secondary& secondary)
+    : m_primary (primary),
+      m_secondary (secondary)
+    {
+    }
+
+    /**
+     * Allocate an arena segment.
+     *
+     * @param [in,out]  size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr if allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        std::size_t primarySize = size;
+        void* ptr = m_primary.getSegment (primarySize);
+        if (ptr)
+        {
+            size = primarySize;
+            return ptr;
+        }
+        return m_secondary.getSegment (size);
+    }
+
+    /**
+     * Free an arena segment to the arena that owns it.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        if (m_primary.contains (ptr))
+        {
+            return m_primary.freeSegment (ptr, size);
+        }
+        return m_secondary.freeSegment (ptr, size);
+    }
+
+    /**
+     * Get the primary arena.
+     *
+     * @return  the primary arena.
+     */
+    Primary&
+    getPrimary ()
+    {
+        return m_primary;
+    }
+
+    /**
+     * Get the secondary arena.
+     *
+     * @return  the secondary arena.
+     */
+    Secondary&
+    getSecondary ()
+    {
+        return m_secondary;
+    }
+
+private:
+    Primary&    m_primary;
+    Secondary&  m_secondary;
+};
+
+/**
+ * Segment statistics of an arena.
+ */
+struct ArenaStats
+{
+    /** the number of segments currently held */
+    std::size_t     numSegments;
+    /** the number of bytes currently held */
+    std::size_t     segmentSize;
+    /** the largest number of bytes held at some point of time */
+    std::size_t     maxSegmentSize;
+    /** the number of successful getSegment calls */
+    std::size_t     numGets;
+    /** the number of freeSegment calls */
+    std::size_t     numFrees;
+    /** the number of failed getSegment calls */
+    std::size_t     numFailures;
+
+    ArenaStats ()
+    : numSegments (0),
+      segmentSize (0),
+      maxSegmentSize (0),
+      numGets (0),
+      numFrees (0),
+      numFailures (0)
+    {
+    }
+
+    /**
+     * Record the result of a getSegment call.
+     */
+    inline void
+    addSegment (void* ptr, std::size_t size)
+    {
+        if (ptr == nullptr)
+        {
+            ++numFailures;
+            return;
+        }
+        ++numGets;
+        ++numSegments;
+        if ((segmentSize += size) > maxSegmentSize)
+        {
+            maxSegmentSize = segmentSize;
+        }
+    }
+
+    /**
+     * Record a freeSegment call.
+     */
+    inline void
+    removeSegment (std::size_t size)
+    {
+        ++numFrees;
+        --numSegments;
+        segmentSize -= size;
+    }
+};
+
+/**
+ * SegregatedArena routes the segment requests to one of the two arenas
+ * based on the requested size.  Requests smaller than the threshold go to
+ * the small arena, such as a CachedArena of normal pages.  The rest go to
+ * the large arena, such as a huge page or a direct mmap arena.
+ *
+ * The segments are handed out exactly as the underlying arenas return
+ * them, so their alignment and sizes are kept.  To route a released
+ * segment back to the arena that owns it, the addresses of the large
+ * segments are kept in a sorted array on the global heap.  A segment
+ * smaller than the threshold can only be small, so its release does not
+ * need a lookup.
+ *
+ * More tiers can be built by nesting SegregatedArena as the large arena.
+ */
+template<class Small, class Large>
+class SegregatedArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   small
+     *          the arena for requests smaller than the threshold.
+     * @param   large
+     *          the arena for the other requests.
+     * @param   threshold
+     *          the request size threshold.
+     */
+    SegregatedArena (Small& small, Large& large, std::size_t threshold = 1024 * 1024)
+    : m_small (small),
+      m_large (large),
+      m_threshold (threshold),
+      m_largeSegments (nullptr),
+      m_numLargeSegments (0),
+      m_maxLargeSegments (0),
+      m_smallStats (),
+      m_largeStats ()
+    {
+    }
+
+    ~SegregatedArena ()
+    {
+        delete[] m_largeSegments;
+    }
+
+    /**
+     * Allocate an arena segment from the arena for the size.
+     *
+     * @param [in,out]  size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr if allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        if (size < m_threshold)
+        {
+            void* ptr = m_small.getSegment (size);
+            m_smallStats.addSegment (ptr, size);
+            return ptr;
+        }
+
+        // make room for the record first, so that a segment obtained is
+        // always recorded.
+        if (m_numLargeSegments == m_maxLargeSegments && growLargeSegments ())
+        {
+            m_largeStats.addSegment (nullptr, size);
+            return nullptr;
+        }
+        void* ptr = m_large.getSegment (size);
+        m_largeStats.addSegment (ptr, size);
+        if (ptr)
+        {
+            std::size_t pos = lowerBound (ptr);
+            memmove (m_largeSegments + pos + 1, m_largeSegments + pos, (m_numLargeSegments - pos) * sizeof(void*));
+            m_largeSegments[pos] = ptr;
+            ++m_numLargeSegments;
+        }
+        return ptr;
+    }
+
+    /**
+     * Free an arena segment to the arena that owns it.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        if (size >= m_threshold)
+        {
+            std::size_t pos = lowerBound (ptr);
+            if (pos < m_numLargeSegments && m_largeSegments[pos] == ptr)
+            {
+                --m_numLargeSegments;
+                memmove (m_largeSegments + pos, m_largeSegments + pos + 1, (m_numLargeSegments - pos) * sizeof(void*));
+                m_largeStats.removeSegment (size);
+                return m_large.freeSegment (ptr, size);
+            }
+        }
+        m_smallStats.removeSegment (size);
+        return m_small.freeSegment (ptr, size);
+    }
+
+    /**
+     * Get the request size threshold.
+     *
+     * @return  the request size threshold.
+     */
+    std::size_t
+    getThreshold () const
+    {
+        return m_threshold;
+    }
+
+    /**
+     * Get the statistics of the small arena.
+     *
+     * @return  the statistics of the small arena.
+     */
+    const ArenaStats&
+    getSmallStats () const
+    {
+        return m_smallStats;
+    }
+
+    /**
+     * Get the statistics of the large arena.
+     *
+     * @return  the statistics of the large arena.
+     */
+    const ArenaStats&
+    getLargeStats () const
+    {
+        return m_largeStats;
+    }
+
+private:
+    SegregatedArena (const SegregatedArena&) = delete;
+    SegregatedArena& operator= (const SegregatedArena&) = delete;
+
+    /**
+     * Double the capacity of the large segment array.
+     *
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    growLargeSegments ()
+    {
+        std::size_t maxSegments = m_maxLargeSegments ? m_maxLargeSegments * 2 : 16;
+        void** segments = new (std::nothrow) void*[maxSegments];
+        if (segments == nullptr)
+        {
+            return true;
+        }
+        if (m_largeSegments)
+        {
+            memcpy (segments, m_largeSegments, m_numLargeSegments * sizeof(void*));
+            delete[] m_largeSegments;
+        }
+        m_largeSegments = segments;
+        m_maxLargeSegments = maxSegments;
+        return false;
+    }
+
+    /**
+     * Find the position of the first large segment whose address is not
+     * less than the pointer.
+     */
+    std::size_t
+    lowerBound (const void* ptr) const
+    {
+        std::size_t low = 0;
+        std::size_t high = m_numLargeSegments;
+        while (low < high)
+        {
+            std::size_t mid = (low + high) / 2;
+            if ((const char*)m_largeSegments[mid] < (const char*)ptr)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+private:
+    Small&      m_small;
+    Large&      m_large;
+    std::size_t m_threshold;
+    void**      m_largeSegments;
+    std::size_t m_numLargeSegments;
+    std::size_t m_maxLargeSegments;
+    ArenaStats  m_smallStats;
+    ArenaStats  m_largeStats;
+};
 
 }   // namespace cookmem
 
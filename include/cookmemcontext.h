@@ -159,6 +159,116 @@ public:
     inline void
     releaseAll () { m_pool.releaseAll (); }
 
+    /**
+     * Set where to print the live allocations found when releaseAll () is
+     * called or the memory context is destroyed.
+     *
+     * @param   file
+     *          the output file, such as stderr.  nullptr disables it.
+     */
+    inline void
+    setLeakReport (FILE* file) { m_pool.setLeakReport (file); }
+
+    /**
+     * Print a summary of the live allocations grouped by size.
+     *
+     * @param   file
+     *          the output file.
+     * @return  the number of live allocations.
+     */
+    inline size_type
+    printLeaks (FILE* file) { return m_pool.printLeaks (file); }
+
+    /**
+     * Print how the memory segments are used.
+     *
+     * @param   file
+     *          the output file.
+     */
+    inline void
+    printFragmentation (FILE* file) { m_pool.printFragmentation (file); }
+
+    /**
+     * Get the fragmentation and bin occupancy statistics.
+     *
+     * @param [out] stats
+     *          the statistics.
+     */
+    inline void
+    getStats (typename Pool::PoolStats& stats) const { m_pool.getStats (stats); }
+
+    /**
+     * Get the allocation path statistics.  They are only collected when
+     * COOKMEM_PATH_STATS is defined.
+     *
+     * @param [out] stats
+     *          the allocation path statistics.
+     */
+    inline void
+    getPathStats (AllocPathStats& stats) const { m_pool.getPathStats (stats); }
+
+    /**
+     * Clear the allocation path statistics.
+     */
+    inline void
+    resetPathStats () { m_pool.resetPathStats (); }
+
+    /**
+     * Set how often the allocations are timed for the allocation path
+     * statistics.
+     *
+     * @param   interval
+     *          one in every this many allocations is timed.  0 disables
+     *          the timing.
+     */
+    inline void
+    setPathSampleInterval (std::size_t interval) { m_pool.setPathSampleInterval (interval); }
+
+    /**
+     * Forget all the memory segments held by this MemPool without releasing
+     * them to the arena.
+     */
+    inline void
+    detach () { m_pool.detach (); }
+
+    /**
+     * Rebuild the MemPool from the segments the arena already holds.
+     */
+    inline void
+    reattach () { m_pool.reattach (); }
+
+    /**
+     * Reserve memory up front, such that later allocations that fit in the
+     * reserved space do not call the arena.
+     *
+     * @param   size
+     *          the number of bytes to reserve.
+     * @param   numThreads
+     *          the number of threads used to touch the pages.
+     * @return  true if there is an error.  false is okay.
+     */
+    inline bool
+    reserve (std::size_t size, unsigned int numThreads = 1) { return m_pool.reserve (size, numThreads); }
+
+    /**
+     * Check if the memory context has been marked as warmed up.
+     *
+     * @return  true if the arena calls are reported.
+     */
+    inline bool
+    isWarmedUp () const { return m_pool.isWarmedUp (); }
+
+    /**
+     * Mark the memory context as warmed up, such that any arena call made
+     * by an allocation afterward is reported to the logger as
+     * MEM_ERROR_ARENA_CALL.
+     *
+     * @param   b
+     *          the boolean choice
+     */
+    inline void
+    setWarmedUp (bool b) { m_pool.setWarmedUp (b); }
+
     /**
      * Get the memory footprint limit.
      *
@@ -182,7 +292,7 @@ public:
      * @return  the current memory footprint.
      */
     inline std::size_t
-    getFootprint () const { return m_pool.getFootPrint (); }
+    getFootprint () const { return m_pool.getFootprint (); }
 
     /**
      * Get the maximum memory footprint.
@@ -192,6 +302,42 @@ public:
     inline std::size_t
     getMaxFootprint () const { return m_pool.getMaxFootprint (); }
 
+    /**
+     * Get the mmap threshold.
+     *
+     * @return  the mmap threshold.  0 if it is disabled.
+     */
+    inline std::size_t
+    getMmapThreshold () const { return m_pool.getMmapThreshold (); }
+
+    /**
+     * Set the request size at or above which the memory gets its own
+     * segment from the arena.
+     *
+     * @param   threshold
+     *          the request size threshold.  0 disables it.
+     */
+    inline void
+    setMmapThreshold (std::size_t threshold) { m_pool.setMmapThreshold (threshold); }
+
+    /**
+     * Get the streaming threshold.
+     *
+     * @return  the streaming threshold.  0 if it is disabled.
+     */
+    inline std::size_t
+    getStreamThreshold () const { return m_pool.getStreamThreshold (); }
+
+    /**
+     * Set the size at or above which reallocate and callocate copy or
+     * clear the memory using non-temporal stores.
+     *
+     * @param   threshold
+     *          the size threshold.  0 disables it.
+     */
+    inline void
+    setStreamThreshold (std::size_t threshold) { m_pool.setStreamThreshold (threshold); }
+
     /**
      * Check whether or not we are storing the exact user size in the memory.
      *
@@ -382,6 +528,73 @@ public:
     }
 };
 
+/**
+ * Internal use.
+ */
+template<std::size_t Size, class Arena, class Logger>
+struct InlineMemContainer
+{
+    typedef FallbackArena<FixedArena, Arena>    InlineArena;
+
+    alignas(16) char    buffer[Size];
+    FixedArena          fixedArena;
+    Arena               arena;
+    InlineArena         inlineArena;
+    Logger              logger;
+
+    InlineMemContainer ()
+    : fixedArena (buffer, Size),
+      arena (),
+      inlineArena (fixedArena, arena),
+      logger ()
+    {
+    }
+
+    virtual ~InlineMemContainer ()
+    {
+    }
+};
+
+/**
+ * A memory context with a built-in buffer.
+ *
+ * The first segment comes from the built-in buffer, so a context that only
+ * needs a small amount of memory never calls the underlying arena.  Larger
+ * requests transparently spill to the underlying arena.
+ *
+ * When declared as a local variable, the built-in buffer is on the stack,
+ * so Size should be kept small.
+ */
+template<std::size_t Size = 4096, class Arena = MmapArena, class Logger = NoActionMemLogger, class T = void>
+class InlineMemContext : private InlineMemContainer<Size, Arena, Logger>, public MemContext<FallbackArena<FixedArena, Arena>, Logger, T>
+{
+public:
+    typedef InlineMemContainer<Size, Arena, Logger>             Container;
+    typedef MemContext<FallbackArena<FixedArena, Arena>, Logger, T> MemCtx;
+
+    /** size type */
+    typedef typename MemCtx::size_type          size_type;
+    /** pointer difference type */
+    typedef typename MemCtx::difference_type    difference_type;
+    /** value type */
+    typedef typename MemCtx::value_type         value_type;
+    /** pointer type */
+    typedef typename MemCtx::pointer            pointer;
+    /** const pointer type */
+    typedef typename MemCtx::const_pointer      const_pointer;
+
+public:
+    InlineMemContext (bool padding = false)
+    : Container (),
+      MemCtx (Container::inlineArena, Container::logger, padding)
+    {
+    }
+
+    virtual ~InlineMemContext ()
+    {
+    }
+};
+
 }   // namespace cookmem
 
 #endif  // COOK_MEM_CONTEXT_H
@@ -32,6 +32,7 @@ namespace cookmem
  */
 class MemLogger
 {
+public:
     virtual ~MemLogger () { }
 
     /**
@@ -78,7 +79,7 @@ class MemLogger
      * @param   newUserSize
      *          the new user size.
      */
-    inline void
+    virtual void
     logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize) { }
 
     /**
@@ -102,6 +103,66 @@ class MemLogger
      */
     virtual void
     logError (void* userPtr, MemError_et error) = 0;
+
+    /**
+     * Log that all the memory is about to be released by releaseAll () or
+     * the destruction of the memory pool.  The memory still allocated is
+     * freed without the individual deallocations being logged.
+     *
+     * This function is optional for loggers that are not derived from
+     * MemLogger.
+     */
+    virtual void
+    logReleaseAll () { }
+
+    /**
+     * Log the usable size of a chunk after it is allocated or reallocated.
+     * The usable size is the size reported by logDeallocation () when the
+     * memory is freed, which can be larger than the requested size when
+     * MemPool does not store the exact size.
+     *
+     * This function is optional for loggers that are not derived from
+     * MemLogger.
+     *
+     * @param   userPtr
+     *          the user pointer allocated.
+     * @param   oldUsableSize
+     *          the old usable size, or 0 for a new allocation.
+     * @param   newUsableSize
+     *          the new usable size.
+     */
+    virtual void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize) { }
+};
+
+/**
+ * Check if a logger has a logReleaseAll function.
+ */
+template<class Logger>
+class LoggerHasReleaseAll
+{
+private:
+    template<class U>
+    static char test (decltype(&U::logReleaseAll));
+    template<class U>
+    static long test (...);
+public:
+    static const bool value = sizeof(test<Logger> (nullptr)) == 1;
+};
+
+/**
+ * Check if a logger has a logUsableSize function.
+ */
+template<class Logger>
+class LoggerHasUsableSize
+{
+private:
+    template<class U>
+    static char test (decltype(&U::logUsableSize));
+    template<class U>
+    static long test (...);
+public:
+    static const bool value = sizeof(test<Logger> (nullptr)) == 1;
 };
 
 /**
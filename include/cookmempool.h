@@ -17,15 +17,32 @@
 #define COOK_MEM_POOL_H
 
 #include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #ifdef WIN32
 #include <windows.h>
 #endif /* WIN32 */
 
+#ifdef COOKMEM_PATH_STATS
+#include <chrono>
+#include <cstdint>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+#endif /* COOKMEM_PATH_STATS */
+
 #include "cookexception.h"
+#include "cookmemlogger.h"
+#include "cookprobes.h"
 #include "cookptravltree.h"
 #include "cookptrcircularlist.h"
+#include "cookstreammem.h"
 
 namespace cookmem
 {
@@ -42,6 +59,108 @@ T left_bits(T x)
     return ((x << 1) | -static_cast<int>(x << 1));
 }
 
+/**
+ * The paths MemPool::allocate () can take.
+ */
+typedef enum
+{
+    PATH_SMALL_EXACT,   // the exact or the next small bin
+    PATH_SMALL_SPLIT,   // split a chunk from a larger small bin
+    PATH_DIRECT,        // a direct segment above the mmap threshold
+    PATH_TREE,          // a chunk found in the tree bins
+    PATH_ARENA,         // a chunk carved from a new arena segment
+    PATH_TOO_BIG,       // the request is larger than MAX_REQUEST
+    PATH_FAILED,        // the arena could not provide a segment
+    NUM_ALLOC_PATHS
+} AllocPath_et;
+
+/**
+ * The allocation path statistics obtained from MemPool::getPathStats ().
+ *
+ * The counters are only updated when COOKMEM_PATH_STATS is defined before
+ * including cookmem headers.  Otherwise, they are always 0.
+ */
+struct AllocPathStats
+{
+    /** the number of allocations that took each path */
+    std::size_t     counts[NUM_ALLOC_PATHS];
+    /** the number of allocations timed for each path */
+    std::size_t     numSamples[NUM_ALLOC_PATHS];
+    /**
+     * The total ticks of the allocations timed for each path.  The ticks
+     * are TSC cycles on x86, and nanoseconds elsewhere.
+     */
+    std::uint64_t   sampleTicks[NUM_ALLOC_PATHS];
+
+    /**
+     * Get the name of an allocation path.
+     *
+     * @param   path
+     *          the allocation path.
+     * @return  the name of the path.
+     */
+    static const char*
+    getPathName (int path)
+    {
+        static const char* const names[NUM_ALLOC_PATHS] =
+        {
+            "small_exact",
+            "small_split",
+            "direct",
+            "tree",
+            "arena",
+            "too_big",
+            "failed"
+        };
+        return (path >= 0 && path < NUM_ALLOC_PATHS) ? names[path] : "unknown";
+    }
+
+    /**
+     * Get the average ticks of a path.
+     *
+     * @param   path
+     *          the allocation path.
+     * @return  the average ticks.  0 if there are no samples.
+     */
+    double
+    getAverageTicks (int path) const
+    {
+        return numSamples[path] ? (double)sampleTicks[path] / numSamples[path] : 0;
+    }
+};
+
+#ifdef COOKMEM_PATH_STATS
+/**
+ * Read a cheap timestamp for the allocation path sampling.
+ */
+inline std::uint64_t
+readPathTicks ()
+{
+#if (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))) || (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
+    return __rdtsc ();
+#else
+    return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+#endif
+}
+
+/* start timing an allocation if it is sampled */
+#define cookmem_pathBegin()\
+  std::uint64_t pathStart_ = ((++m_pathCounter & m_pathSampleMask) == 0) ? readPathTicks () : 0
+
+/* record the path an allocation took */
+#define cookmem_pathEnd(P)\
+{\
+  ++m_pathStats.counts[P];\
+  if (pathStart_ != 0) {\
+    ++m_pathStats.numSamples[P];\
+    m_pathStats.sampleTicks[P] += readPathTicks () - pathStart_;\
+  }\
+}
+#else
+#define cookmem_pathBegin()
+#define cookmem_pathEnd(P)
+#endif /* COOKMEM_PATH_STATS */
+
 /* assign tree index for size S to variable I. Use x86 asm if possible  */
 #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 #define cookmem_getLargeBinIndex(S, I)\
@@ -147,6 +266,44 @@ T left_bits(T x)
 }
 #endif /* GNUC */
 
+/**
+ * Internal use.  Check if an arena provides the optional function
+ *
+ * void* resizeSegment (void* ptr, std::size_t oldSize, std::size_t& newSize)
+ *
+ * which resizes a segment, possibly moving it, without copying the memory.
+ */
+template<class Arena>
+class ArenaHasResizeSegment
+{
+private:
+    template<class U>
+    static char test (decltype(&U::resizeSegment));
+    template<class U>
+    static long test (...);
+public:
+    static const bool value = sizeof(test<Arena> (nullptr)) == 1;
+};
+
+/**
+ * Internal use.  Check if an arena provides the optional function
+ *
+ * bool zeroesSegments () const
+ *
+ * which returns true if the new segments obtained are always zero filled.
+ */
+template<class Arena>
+class ArenaHasZeroesSegments
+{
+private:
+    template<class U>
+    static char test (decltype(&U::zeroesSegments));
+    template<class U>
+    static long test (...);
+public:
+    static const bool value = sizeof(test<Arena> (nullptr)) == 1;
+};
+
 /**
  * A memory allocator.
  *
@@ -168,6 +325,62 @@ public:
     typedef T*              pointer;
     /** const pointer type */
     typedef const T*        const_pointer;
+    /** arena type */
+    typedef Arena           arena_type;
+
+    /**
+     * The information of a memory chunk obtained from nextChunk ().
+     */
+    struct ChunkInfo
+    {
+        /** the segment containing the chunk */
+        void*       segment;
+        /** the chunk.  Set it to nullptr to start the iteration. */
+        void*       chunk;
+        /** the user pointer.  nullptr if the chunk is free. */
+        T*          userPtr;
+        /** the chunk size including the overhead */
+        size_type   chunkSize;
+        /** the user size.  0 if the chunk is free. */
+        size_type   userSize;
+        /** whether the chunk is being used */
+        bool        used;
+        /** whether the chunk has its own segment */
+        bool        direct;
+    };
+
+    /**
+     * The statistics obtained from getStats ().
+     */
+    struct PoolStats
+    {
+        /** the current memory footprint */
+        size_type   footprint;
+        /** the number of segments, including the direct segments */
+        size_type   numSegments;
+        /** the number of direct segments */
+        size_type   numDirectSegments;
+        /** the number of allocations live */
+        size_type   numAllocations;
+        /** the bytes in the chunks being used, excluding the chunk headers */
+        size_type   liveBytes;
+        /** the bytes in the free chunks */
+        size_type   freeBytes;
+        /** the segment headers and the chunk headers of the live chunks */
+        size_type   overheadBytes;
+        /** the largest free chunk */
+        size_type   largestFreeChunk;
+        /**
+         * 1 - largestFreeChunk / freeBytes.  0 means all the free memory
+         * is in one chunk.  It approaches 1 as the free memory is
+         * scattered into many small chunks.
+         */
+        double      fragmentation;
+        /** the free bytes in each small bin */
+        size_type   smallBinBytes[32];
+        /** the free bytes in each tree bin */
+        size_type   treeBinBytes[32];
+    };
 
 private:
     typedef unsigned int    BinIndexType;
@@ -192,6 +405,7 @@ private:
         static const size_type  BIT_MASK = ((size_t)-1) ^ 0x0f;
         static const size_type  BIT_USED = 1;
         static const size_type  BIT_NOTEXACTSIZE = 2;
+        static const size_type  BIT_MMAPPED = 4;
 
     private:
         size_type   m_prevFootSize;     /* Size of previous chunk (if free).  */
@@ -217,6 +431,25 @@ private:
             return m_size & BIT_USED;
         }
 
+        /**
+         * Check if the chunk has its own segment.
+         */
+        inline bool
+        isMmapped () const
+        {
+            return m_size & BIT_MMAPPED;
+        }
+
+        /**
+         * Initialize a chunk that has its own segment.
+         */
+        inline void
+        setMmappedChunkSize (size_type chunkSize)
+        {
+            m_prevFootSize = BIT_USED;
+            m_size = chunkSize | BIT_MMAPPED;
+        }
+
         inline size_type
         getUserSize () const
         {
@@ -297,7 +530,7 @@ private:
             // by the caller anyways.
 
             size_type  chunkSize = segSize - SEGMENT_OVERHEAD;
-            MemChunk* chunk = (MemChunk*)(((char*)this) + offsetof (MemSegment, m_pad));
+            MemChunk* chunk = getFirstChunk ();
             chunk->setFreeChunkSize (chunkSize);
             return chunk;
         }
@@ -308,12 +541,39 @@ private:
             return m_size;
         }
 
+        /**
+         * Get the first memory chunk inside the segment.
+         */
+        MemChunk*
+        getFirstChunk ()
+        {
+            return (MemChunk*)(((char*)this) + offsetof (MemSegment, m_pad));
+        }
+
+        /**
+         * Get the end of the memory chunks inside the segment.
+         */
+        char*
+        getChunkEnd ()
+        {
+            return ((char*)getFirstChunk ()) + m_size - SEGMENT_OVERHEAD;
+        }
+
         MemSegment*
         getNext () const
         {
             return m_next;
         }
 
+        /**
+         * Check if this is actually a DirectSegment.
+         */
+        bool
+        isDirect () const
+        {
+            return m_pad & MemChunk::BIT_MMAPPED;
+        }
+
         void
         setNext (MemSegment* seg)
         {
@@ -321,6 +581,93 @@ private:
         }
     };
 
+    /**
+     * A segment that holds a single memory chunk, which is allocated and
+     * freed directly using the arena.
+     *
+     * The flag is at the same position as the padding of MemSegment, so
+     * the two types of segments can be told apart.
+     */
+    class DirectSegment
+    {
+    private:
+        /**
+         * Allocated size.
+         */
+        size_type       m_size;
+        /**
+         * DLL of direct segments.
+         */
+        DirectSegment*  m_next;
+        /**
+         * Always has the used and mmapped bits set.
+         */
+        size_type       m_flag;
+        DirectSegment*  m_prev;
+
+    public:
+        /**
+         * Initialize a segment and return the memory chunk.
+         *
+         * @param   segSize
+         *          the size of the segment
+         * @param   chunkSize
+         *          the chunk size.
+         * @return  the memory chunk inside the segment.
+         */
+        MemChunk*
+        init (size_type segSize, size_type chunkSize)
+        {
+            m_size = segSize;
+            m_flag = MemChunk::BIT_USED | MemChunk::BIT_MMAPPED;
+            MemChunk* chunk = getChunk ();
+            chunk->setMmappedChunkSize (chunkSize);
+            return chunk;
+        }
+
+        size_type
+        getSize () const
+        {
+            return m_size;
+        }
+
+        MemChunk*
+        getChunk ()
+        {
+            return (MemChunk*)(((char*)this) + DIRECT_CHUNK_OFFSET);
+        }
+
+        static DirectSegment*
+        getSegment (MemChunk* chunk)
+        {
+            return (DirectSegment*)(((char*)chunk) - DIRECT_CHUNK_OFFSET);
+        }
+
+        DirectSegment*
+        getNext () const
+        {
+            return m_next;
+        }
+
+        void
+        setNext (DirectSegment* seg)
+        {
+            m_next = seg;
+        }
+
+        DirectSegment*
+        getPrev () const
+        {
+            return m_prev;
+        }
+
+        void
+        setPrev (DirectSegment* seg)
+        {
+            m_prev = seg;
+        }
+    };
+
 private:
     /**
      * Use 16 byte alignment.
@@ -381,6 +728,15 @@ private:
      * The number of extra bytes needed for a segment.
      */
     static const size_type  SEGMENT_OVERHEAD = ((sizeof(MemSegment) - sizeof(size_type) + ALIGN_MASK) & (~ALIGN_MASK)) + sizeof(size_type);
+    /**
+     * The offset of the memory chunk in a direct segment.
+     */
+    static const size_type  DIRECT_CHUNK_OFFSET = (sizeof(DirectSegment) + ALIGN_MASK) & ~ALIGN_MASK;
+    /**
+     * The number of extra bytes needed for a direct segment.  The space
+     * after the chunk holds the footer written when the chunk is used.
+     */
+    static const size_type  DIRECT_OVERHEAD = DIRECT_CHUNK_OFFSET + ALIGNMENT;
     /**
      * The number of frees before attempting to coalesce memory chunks.
      */
@@ -389,6 +745,16 @@ private:
      * Default padding bytes for strict bounding check.
      */
     static const char DEFAULT_PADDING_BYTE = (char)0xcd;
+    /**
+     * By default, one in every this many allocations is timed for the
+     * allocation path statistics.
+     */
+    static const size_type  DEFAULT_PATH_SAMPLE_INTERVAL = 64;
+    /**
+     * The stride to touch the pages of a reserved segment.  It is the
+     * smallest page size of the platforms supported.
+     */
+    static const size_type  PAGE_TOUCH_STRIDE = 4096;
 
 private:
     /**
@@ -409,6 +775,25 @@ private:
      * SLL of memory segments obtained from arena
      */
     MemSegment*     m_segList;
+    /**
+     * DLL of direct segments, each holds a single large chunk.
+     */
+    DirectSegment*  m_directList;
+    /**
+     * The request size at or above which a chunk gets its own segment.
+     * 0 disables it.
+     */
+    size_type       m_mmapThreshold;
+    /**
+     * The last chunk carved from a zero filled segment obtained from the
+     * arena.  It is used by callocate to skip clearing the memory.
+     */
+    MemChunk*       m_zeroChunk;
+    /**
+     * The size at or above which memory is copied or cleared using
+     * non-temporal stores.  0 disables it.
+     */
+    size_type       m_streamThreshold;
 
     size_type       m_release_checks;
 
@@ -423,6 +808,30 @@ private:
      * AVL trees for large chunks
      */
     PtrAVLTree      m_largeTrees[NTREEBINS];
+    /**
+     * The free bytes in each small bin.
+     */
+    size_type       m_smallBinBytes[NSMALLBINS];
+    /**
+     * The free bytes in each tree bin.
+     */
+    size_type       m_treeBinBytes[NTREEBINS];
+    /**
+     * The bytes of the segments not covered by the chunks.
+     */
+    size_type       m_segmentOverhead;
+    /**
+     * The number of segments, including the direct ones.
+     */
+    size_type       m_numSegments;
+    /**
+     * The number of direct segments.
+     */
+    size_type       m_numDirectSegments;
+    /**
+     * The number of chunks being used.
+     */
+    size_type       m_numUsedChunks;
 
     // memory foot print tracking
     /**
@@ -447,6 +856,30 @@ private:
      * The padding byte.
      */
     char            m_paddingByte;
+    /**
+     * If the memory pool has been warmed up, such that any arena call is
+     * reported to the logger.
+     */
+    bool            m_warmedUp;
+    /**
+     * Where to print the live allocations found by releaseAll or the
+     * destructor.  nullptr disables it.
+     */
+    FILE*           m_leakReport;
+#ifdef COOKMEM_PATH_STATS
+    /**
+     * The allocation path counters.
+     */
+    AllocPathStats  m_pathStats;
+    /**
+     * The number of allocations so far, used to pick the ones to time.
+     */
+    size_type       m_pathCounter;
+    /**
+     * One in every (m_pathSampleMask + 1) allocations is timed.
+     */
+    size_type       m_pathSampleMask;
+#endif /* COOKMEM_PATH_STATS */
 public:
     /**
      * Constructor
@@ -465,17 +898,34 @@ public:
       m_logger (logger),
       m_footprintLimit (0),
       m_segList (nullptr),
+      m_directList (nullptr),
+      m_mmapThreshold (0),
+      m_zeroChunk (nullptr),
+      m_streamThreshold (0),
       m_release_checks (0),
       m_smallMap (0),
       m_treeMap (0),
       m_smallLists (),
       m_largeTrees (),
+      m_smallBinBytes (),
+      m_treeBinBytes (),
+      m_segmentOverhead (0),
+      m_numSegments (0),
+      m_numDirectSegments (0),
+      m_numUsedChunks (0),
       m_footprint (0),
       m_maxFootprint (0),
       m_storingExactSize (padding),
       m_padding (padding),
-      m_paddingByte (DEFAULT_PADDING_BYTE)
+      m_paddingByte (DEFAULT_PADDING_BYTE),
+      m_warmedUp (false),
+      m_leakReport (nullptr)
     {
+#ifdef COOKMEM_PATH_STATS
+        memset (&m_pathStats, 0, sizeof(m_pathStats));
+        m_pathCounter = 0;
+        m_pathSampleMask = DEFAULT_PATH_SAMPLE_INTERVAL - 1;
+#endif /* COOKMEM_PATH_STATS */
     }
 
     /**
@@ -485,15 +935,12 @@ public:
      */
     ~MemPool()
     {
-        MemSegment* seg = m_segList;
-        while (seg)
+        loggerReleaseAll ();
+        if (m_leakReport)
         {
-            void* ptr = seg;
-            size_type size = seg->getSize ();
-            seg = seg->getNext ();
-            m_logger.logFreeSegment (ptr, size);
-            m_arena.freeSegment (ptr, size);
+            printLeaks (m_leakReport);
         }
+        freeSegments ();
     }
 
     /**
@@ -519,6 +966,121 @@ public:
         return m_footprintLimit;
     }
 
+    /**
+     * Set the mmap threshold.
+     *
+     * A large request at or above the threshold gets its own segment from
+     * the arena, which is released directly to the arena when the memory
+     * is deallocated.  If the arena provides resizeSegment, such as
+     * MmapArena on Linux, reallocating such memory resizes the segment
+     * without copying the memory.
+     *
+     * @param   threshold
+     *          the request size threshold.  0 disables it, which is the
+     *          default.
+     */
+    void
+    setMmapThreshold (size_type threshold)
+    {
+        m_mmapThreshold = threshold;
+    }
+
+    /**
+     * Get the mmap threshold.
+     *
+     * @return  the mmap threshold.  0 if it is disabled.
+     */
+    size_type
+    getMmapThreshold () const
+    {
+        return m_mmapThreshold;
+    }
+
+    /**
+     * Set the streaming threshold.
+     *
+     * When reallocate moves memory, or callocate clears memory, of at
+     * least this size, non-temporal stores are used such that the memory
+     * does not go through the cache and evict the working set.
+     *
+     * @param   threshold
+     *          the size threshold.  0 disables it, which is the default.
+     */
+    void
+    setStreamThreshold (size_type threshold)
+    {
+        m_streamThreshold = threshold;
+    }
+
+    /**
+     * Get the streaming threshold.
+     *
+     * @return  the streaming threshold.  0 if it is disabled.
+     */
+    size_type
+    getStreamThreshold () const
+    {
+        return m_streamThreshold;
+    }
+
+    /**
+     * Get the number of allocations that took each path in allocate (),
+     * along with the sampled latencies.
+     *
+     * The statistics are only collected when COOKMEM_PATH_STATS is defined
+     * before including cookmem headers.  Otherwise, they are all 0.
+     *
+     * @param [out] stats
+     *          the allocation path statistics.
+     */
+    void
+    getPathStats (AllocPathStats& stats) const
+    {
+#ifdef COOKMEM_PATH_STATS
+        stats = m_pathStats;
+#else
+        memset (&stats, 0, sizeof(stats));
+#endif /* COOKMEM_PATH_STATS */
+    }
+
+    /**
+     * Clear the allocation path statistics.
+     */
+    void
+    resetPathStats ()
+    {
+#ifdef COOKMEM_PATH_STATS
+        memset (&m_pathStats, 0, sizeof(m_pathStats));
+#endif /* COOKMEM_PATH_STATS */
+    }
+
+    /**
+     * Set how often allocate () is timed for the allocation path
+     * statistics.
+     *
+     * @param   interval
+     *          one in every this many allocations is timed.  It is rounded
+     *          down to a power of 2.  0 disables the timing.
+     */
+    void
+    setPathSampleInterval (size_type interval)
+    {
+#ifdef COOKMEM_PATH_STATS
+        if (interval == 0)
+        {
+            // the counter would have to wrap around to be timed
+            m_pathSampleMask = ~(size_type)0;
+            return;
+        }
+        size_type pow2 = 1;
+        while (pow2 <= interval / 2)
+        {
+            pow2 <<= 1;
+        }
+        m_pathSampleMask = pow2 - 1;
+#endif /* COOKMEM_PATH_STATS */
+    }
+
     /**
      * Allocate memory from the memory pool.
      *
@@ -532,6 +1094,9 @@ public:
     {
         size_type  chunkSize;
 
+        cookmem_pathBegin ();
+        COOKMEM_PROBE1 (alloc_entry, userSize);
+
         size_type allocSize = getMinAllocSize (userSize);
 
         if (allocSize < MIN_LARGE_REQUEST)
@@ -557,6 +1122,7 @@ public:
 
                 setUsed (chunk, userSize);
 
+                cookmem_pathEnd (PATH_SMALL_EXACT);
                 return getUserPointer (chunk, userSize);
             }
             else
@@ -577,6 +1143,7 @@ public:
 
                     setUsed (chunk, userSize);
 
+                    cookmem_pathEnd (PATH_SMALL_SPLIT);
                     return getUserPointer (chunk, userSize);
                 }
             }
@@ -584,13 +1151,30 @@ public:
         else if (allocSize >= MAX_REQUEST)
         {
             // The request size is too big.
+            cookmem_pathEnd (PATH_TOO_BIG);
+            COOKMEM_PROBE2 (alloc_return, (void*)nullptr, userSize);
             m_logger.logAllocation (nullptr, userSize);
             return nullptr;
         }
         else
         {
             chunkSize = calcChunkSize (allocSize);
-        }
+
+            if (m_mmapThreshold != 0 && allocSize >= m_mmapThreshold)
+            {
+                MemChunk* chunk = directAlloc (chunkSize);
+                if (chunk == nullptr)
+                {
+                    cookmem_pathEnd (PATH_FAILED);
+                    COOKMEM_PROBE2 (alloc_return, (void*)nullptr, userSize);
+                    m_logger.logAllocation (nullptr, userSize);
+                    return nullptr;
+                }
+                setUsed (chunk, userSize);
+                cookmem_pathEnd (PATH_DIRECT);
+                return getUserPointer (chunk, userSize);
+            }
+        }
 
         MemChunk* chunk;
 
@@ -615,9 +1199,16 @@ public:
 
             if (chunk == nullptr)
             {
+                cookmem_pathEnd (PATH_FAILED);
+                COOKMEM_PROBE2 (alloc_return, (void*)nullptr, userSize);
                 m_logger.logAllocation (nullptr, userSize);
                 return nullptr;
             }
+            cookmem_pathEnd (PATH_ARENA);
+        }
+        else
+        {
+            cookmem_pathEnd (PATH_TREE);
         }
 
         setUsed (chunk, userSize);
@@ -645,6 +1236,11 @@ public:
         }
 
         MemChunk* chunk = mem2Chunk (ptr);
+        COOKMEM_PROBE2 (realloc, (void*)ptr, newUserSize);
+        if (chunk->isMmapped ())
+        {
+            return directReallocate (ptr, newUserSize);
+        }
         size_type oldAllocSize = chunk->getUserSize ();
         size_type oldChunkSize = calcChunkSize(oldAllocSize);
 
@@ -657,7 +1253,7 @@ public:
             T* newPtr = allocate (newUserSize);
             if (newPtr)
             {
-                memcpy(newPtr, ptr, oldAllocSize);
+                copyMemory (newPtr, ptr, oldAllocSize);
                 deallocate (ptr);
             }
             return newPtr;
@@ -669,6 +1265,7 @@ public:
             // simply split the chunk
             splitChunk (chunk, newChunkSize);
             setUsed (chunk, newUserSize);
+            loggerUsableSize (ptr, oldAllocSize, chunk);
             return ptr;
         }
     }
@@ -686,11 +1283,20 @@ public:
     callocate (size_type num, size_type size)
     {
         size_type totalSize = size * num;
+        if (size != 0 && totalSize / size != num)
+        {
+            m_logger.logAllocation (nullptr, ~(size_type)0);
+            return nullptr;
+        }
+        m_zeroChunk = nullptr;
         T* ptr = allocate (totalSize);
-        if (ptr)
+        // memory just obtained from a zero filled segment is not cleared,
+        // which also avoids touching the pages.
+        if (ptr && mem2Chunk (ptr) != m_zeroChunk)
         {
-            memset (ptr, 0, totalSize);
+            fillMemory (ptr, 0, totalSize);
         }
+        m_zeroChunk = nullptr;
         return ptr;
     }
 
@@ -736,8 +1342,17 @@ public:
                     }
                 }
             }
+            COOKMEM_PROBE2 (free, (void*)ptr, chunkSize);
             m_logger.logDeallocation (ptr, chunk->getUserSize ());
 
+            if (chunk->isMmapped ())
+            {
+                directFree (DirectSegment::getSegment (chunk));
+                --m_numUsedChunks;
+                return;
+            }
+
+            --m_numUsedChunks;
             chunk->setFreeChunkSize (chunkSize);
             addChunk (chunk);
         }
@@ -778,6 +1393,18 @@ public:
             }
             seg = seg->getNext ();
         }
+        for (DirectSegment* direct = m_directList; direct; direct = direct->getNext ())
+        {
+            if (reinterpret_cast<char*>(ptr) >= reinterpret_cast<char*>(direct) &&
+                reinterpret_cast<char*>(ptr) <= (reinterpret_cast<char*>(direct) + direct->getSize ()))
+            {
+                if (checkUsed)
+                {
+                    return ptr == chunk2Mem (direct->getChunk ());
+                }
+                return true;
+            }
+        }
         return false;
     }
 
@@ -816,21 +1443,413 @@ public:
     void
     releaseAll ()
     {
-        MemSegment* seg = m_segList;
+        COOKMEM_PROBE2 (release_all, m_footprint, m_numUsedChunks);
+        loggerReleaseAll ();
+        if (m_leakReport)
+        {
+            printLeaks (m_leakReport);
+        }
+        freeSegments ();
+        resetBins ();
+    }
+
+    /**
+     * Reserve a memory segment up front, such that later allocations that
+     * fit in the reserved space are served without calling the arena.
+     *
+     * The pages of the segment are touched so the page faults are taken
+     * now rather than at the first use.  This is unnecessary for an arena
+     * that already prefaults its segments, such as MlockArena.
+     *
+     * @param   size
+     *          the number of bytes to reserve.
+     * @param   numThreads
+     *          the number of threads used to touch the pages.  Using
+     *          several threads only helps for very large reservations.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    reserve (size_type size, unsigned int numThreads = 1)
+    {
+        if (size >= MAX_REQUEST)
+        {
+            return true;
+        }
+        size_type chunkSize = (size < MIN_REQUEST) ? MIN_CHUNK_SIZE : calcChunkSize (size);
+        MemChunk* chunk = arenaChunk (chunkSize);
+        if (chunk == nullptr)
+        {
+            return true;
+        }
+        addChunk (chunk);
+
+        // arenaChunk puts the new segment at the head of the list.
+        touchPages ((char*)m_segList, m_segList->getSize (), numThreads);
+        return false;
+    }
+
+    /**
+     * Check if the memory pool has been marked as warmed up.
+     *
+     * @return  true if the arena calls are reported.
+     */
+    bool
+    isWarmedUp () const
+    {
+        return m_warmedUp;
+    }
+
+    /**
+     * Mark the memory pool as warmed up.
+     *
+     * Once warmed up, any allocation that needs a new segment from the
+     * arena is reported to the logger as MEM_ERROR_ARENA_CALL before the
+     * arena is called.  NoActionMemLogger throws an exception in this
+     * case.  It is a way to verify that the steady state of an application
+     * does not make system calls for memory.
+     *
+     * Releasing the memory with releaseAll () or the destructor is not
+     * reported.
+     *
+     * @param   b
+     *          the boolean choice
+     */
+    void
+    setWarmedUp (bool b)
+    {
+        m_warmedUp = b;
+    }
+
+    /**
+     * Iterate through the memory segments held by this MemPool.
+     *
+     * @param   ptr
+     *          the previous segment obtained from this function.  nullptr
+     *          to get the first segment.
+     * @param [out] size
+     *          the size of the segment returned.
+     * @return  the next segment.  nullptr if there are no more.
+     */
+    void*
+    nextSegment (void* ptr, size_type& size)
+    {
+        DirectSegment* direct;
+        if (ptr == nullptr || !((MemSegment*)ptr)->isDirect ())
+        {
+            MemSegment* seg = ptr ? ((MemSegment*)ptr)->getNext () : m_segList;
+            if (seg)
+            {
+                size = seg->getSize ();
+                return seg;
+            }
+            direct = m_directList;
+        }
+        else
+        {
+            direct = ((DirectSegment*)ptr)->getNext ();
+        }
+        if (direct)
+        {
+            size = direct->getSize ();
+        }
+        return direct;
+    }
+
+    /**
+     * Iterate through the memory chunks, both used and free, in all the
+     * segments held by this MemPool.
+     *
+     * @param [in,out]  info
+     *          the previous chunk obtained from this function.  Set
+     *          info.chunk to nullptr to get the first chunk.  Upon return,
+     *          it is the information of the next chunk.
+     * @return  true if a chunk is found.  false if there are no more.
+     */
+    bool
+    nextChunk (ChunkInfo& info)
+    {
+        MemSegment* seg;
+        char* ptr;
+        if (info.chunk == nullptr)
+        {
+            seg = m_segList;
+            ptr = seg ? (char*)seg->getFirstChunk () : nullptr;
+        }
+        else if (info.direct)
+        {
+            return setDirectChunkInfo (((DirectSegment*)info.segment)->getNext (), info);
+        }
+        else
+        {
+            seg = (MemSegment*)info.segment;
+            ptr = (char*)info.chunk + info.chunkSize;
+        }
+
         while (seg)
         {
-            void* ptr = seg;
-            size_type size = seg->getSize ();
+            // The gap at the end is always smaller than the smallest chunk.
+            char* end = seg->getChunkEnd ();
+            if ((size_type)(end - ptr) >= MIN_CHUNK_SIZE)
+            {
+                MemChunk* chunk = (MemChunk*)ptr;
+                info.segment = seg;
+                info.chunk = chunk;
+                info.chunkSize = chunk->getChunkSize ();
+                info.used = chunk->isUsed ();
+                info.direct = false;
+                info.userPtr = info.used ? chunk2Mem (chunk) : nullptr;
+                info.userSize = info.used ? chunk->getUserSize () : 0;
+                if (MIN_CHUNK_SIZE > info.chunkSize || info.chunkSize > (size_type)(end - ptr))
+                {
+                    throw Exception (MEM_ERROR_GENERAL, "invalid memory chunk.");
+                }
+                return true;
+            }
             seg = seg->getNext ();
-            m_logger.logFreeSegment (ptr, size);
-            m_arena.freeSegment (ptr, size);
+            ptr = seg ? (char*)seg->getFirstChunk () : nullptr;
+        }
+        return setDirectChunkInfo (m_directList, info);
+    }
+
+    /**
+     * Get the statistics of the memory held.  The statistics are kept up
+     * to date as the memory is allocated and freed, so this function does
+     * not need to walk the chunks.
+     *
+     * @param [out] stats
+     *          the statistics.
+     */
+    void
+    getStats (PoolStats& stats) const
+    {
+        memset (&stats, 0, sizeof(stats));
+        stats.footprint = m_footprint;
+        stats.numSegments = m_numSegments;
+        stats.numDirectSegments = m_numDirectSegments;
+        stats.numAllocations = m_numUsedChunks;
+        for (BinIndexType i = 0; i < NSMALLBINS; ++i)
+        {
+            stats.smallBinBytes[i] = m_smallBinBytes[i];
+            stats.freeBytes += m_smallBinBytes[i];
+            if (m_smallBinBytes[i])
+            {
+                stats.largestFreeChunk = getSmallBinSize (i);
+            }
+        }
+        for (BinIndexType i = 0; i < NTREEBINS; ++i)
+        {
+            stats.treeBinBytes[i] = m_treeBinBytes[i];
+            stats.freeBytes += m_treeBinBytes[i];
+        }
+        for (BinIndexType i = NTREEBINS; i-- > 0; )
+        {
+            if (m_treeBinBytes[i])
+            {
+                stats.largestFreeChunk = m_largeTrees[i].getMaxSize ();
+                break;
+            }
+        }
+        stats.overheadBytes = m_segmentOverhead + m_numUsedChunks * CHUNK_OVERHEAD;
+        stats.liveBytes = m_footprint - stats.freeBytes - stats.overheadBytes;
+        stats.fragmentation = stats.freeBytes ? 1.0 - (double)stats.largestFreeChunk / stats.freeBytes : 0;
+    }
+
+    /**
+     * Set where to print the live allocations found when releaseAll () is
+     * called or the MemPool is destroyed.
+     *
+     * @param   file
+     *          the output file, such as stderr.  nullptr disables it,
+     *          which is the default.
+     */
+    void
+    setLeakReport (FILE* file)
+    {
+        m_leakReport = file;
+    }
+
+    /**
+     * Print a summary of the live allocations grouped by size.
+     *
+     * @param   file
+     *          the output file.
+     * @return  the number of live allocations.
+     */
+    size_type
+    printLeaks (FILE* file)
+    {
+        const int NUM_CLASSES = sizeof(size_type) * 8;
+        size_type counts[NUM_CLASSES] = {};
+        size_type bytes[NUM_CLASSES] = {};
+        size_type totalCount = 0;
+        size_type totalBytes = 0;
+
+        ChunkInfo info;
+        info.chunk = nullptr;
+        while (nextChunk (info))
+        {
+            if (info.used)
+            {
+                int c = getSizeClass (info.userSize);
+                ++counts[c];
+                bytes[c] += info.userSize;
+                ++totalCount;
+                totalBytes += info.userSize;
+            }
+        }
+        if (totalCount == 0)
+        {
+            return 0;
+        }
+        fprintf (file, "cookmem: %zu live allocations, %zu bytes\n", totalCount, totalBytes);
+        for (int c = 0; c < NUM_CLASSES; ++c)
+        {
+            if (counts[c])
+            {
+                fprintf (file, "  size <= %zu: %zu allocations, %zu bytes\n", getSizeClassLimit (c), counts[c], bytes[c]);
+            }
+        }
+        return totalCount;
+    }
+
+    /**
+     * Print how the memory segments are used, to find out why the
+     * footprint is much larger than the live bytes.
+     *
+     * For each segment, it prints the bytes used and free, the number of
+     * free chunks and the largest one.  It is followed by the totals and a
+     * histogram of the free chunk sizes.
+     *
+     * @param   file
+     *          the output file.
+     */
+    void
+    printFragmentation (FILE* file)
+    {
+        const int NUM_CLASSES = sizeof(size_type) * 8;
+        size_type freeCounts[NUM_CLASSES] = {};
+        size_type freeBytes[NUM_CLASSES] = {};
+
+        size_type numSegments = 0;
+        size_type numDirect = 0;
+        size_type numUsed = 0;
+        size_type usedBytes = 0;
+        size_type userBytes = 0;
+        size_type numFree = 0;
+        size_type totalFree = 0;
+        size_type largestFree = 0;
+
+        void* seg = nullptr;
+        size_type segUsed = 0;
+        size_type segFree = 0;
+        size_type segNumFree = 0;
+        size_type segLargest = 0;
+
+        ChunkInfo info;
+        info.chunk = nullptr;
+        bool more;
+        do
+        {
+            more = nextChunk (info);
+            if (!more || info.segment != seg)
+            {
+                if (seg)
+                {
+                    fprintf (file, "  segment %p: size %zu, used %zu, free %zu in %zu chunks, largest free %zu\n",
+                             seg, *(size_type*)seg, segUsed, segFree, segNumFree, segLargest);
+                }
+                if (!more)
+                {
+                    break;
+                }
+                seg = info.segment;
+                segUsed = segFree = segNumFree = segLargest = 0;
+                ++numSegments;
+                numDirect += info.direct;
+            }
+            if (info.used)
+            {
+                ++numUsed;
+                usedBytes += info.chunkSize;
+                userBytes += info.userSize;
+                segUsed += info.chunkSize;
+            }
+            else
+            {
+                int c = getSizeClass (info.chunkSize);
+                ++freeCounts[c];
+                freeBytes[c] += info.chunkSize;
+                ++numFree;
+                totalFree += info.chunkSize;
+                ++segNumFree;
+                segFree += info.chunkSize;
+                if (info.chunkSize > largestFree)
+                {
+                    largestFree = info.chunkSize;
+                }
+                if (info.chunkSize > segLargest)
+                {
+                    segLargest = info.chunkSize;
+                }
+            }
+        } while (true);
+
+        fprintf (file, "cookmem: footprint %zu bytes in %zu segments (%zu direct)\n", m_footprint, numSegments, numDirect);
+        fprintf (file, "  used: %zu chunks, %zu bytes, %zu user bytes\n", numUsed, usedBytes, userBytes);
+        fprintf (file, "  free: %zu chunks, %zu bytes, largest %zu\n", numFree, totalFree, largestFree);
+        fprintf (file, "  overhead: %zu bytes\n", m_footprint - usedBytes - totalFree);
+        if (m_footprint)
+        {
+            fprintf (file, "  live / footprint: %.3f\n", (double)userBytes / m_footprint);
+        }
+        if (totalFree)
+        {
+            // 0 if all the free memory is in one chunk
+            fprintf (file, "  free fragmentation: %.3f\n", 1.0 - (double)largestFree / totalFree);
+        }
+        for (int c = 0; c < NUM_CLASSES; ++c)
+        {
+            if (freeCounts[c])
+            {
+                fprintf (file, "  free size <= %zu: %zu chunks, %zu bytes\n", getSizeClassLimit (c), freeCounts[c], freeBytes[c]);
+            }
+        }
+    }
+
+    /**
+     * Forget all the memory segments held by this MemPool without releasing
+     * them to the arena.
+     *
+     * This is useful for a persistent arena, such as FileMmapArena, where
+     * the segments should outlive the MemPool.
+     */
+    void
+    detach ()
+    {
+        resetBins ();
+    }
+
+    /**
+     * Rebuild this MemPool from the segments the arena already holds.
+     *
+     * The arena needs to provide a nextSegment function to iterate through
+     * its segments, such as FileMmapArena.  The segment list, the small
+     * chunk lists and the tree bins are rebuilt from the chunk headers.
+     * All the segments in the arena are assumed to belong to this MemPool.
+     *
+     * Any segments currently held by this MemPool are detached first.
+     */
+    void
+    reattach ()
+    {
+        detach ();
+
+        size_type segSize;
+        void* ptr = nullptr;
+        while ((ptr = m_arena.nextSegment (ptr, segSize)) != nullptr)
+        {
+            attachSegment ((MemSegment*)ptr, segSize);
         }
-        m_segList = nullptr;
-        m_smallMap = 0;
-        m_treeMap = 0;
-        m_footprint = 0;
-        memset (m_largeTrees, 0, sizeof(m_largeTrees));
-        memset (m_smallLists, 0, sizeof(m_smallLists));
     }
 
     /**
@@ -1004,7 +2023,10 @@ private:
             {
                 chunk = reinterpret_cast<MemChunk*>(tree.remove(actualSize));
                 if (chunk != nullptr)
+                {
+                    m_treeBinBytes[binIndex] -= chunk->getChunkSize ();
                     break;
+                }
             }
         }
 
@@ -1055,48 +2077,144 @@ private:
     MemChunk*
     arenaAlloc (size_type chunkSize)
     {
-        size_type estSize;             /* allocation size */
-
-        estSize = chunkSize + SEGMENT_OVERHEAD;
-        if (estSize <= chunkSize)
+        MemChunk* chunk = arenaChunk (chunkSize);
+        COOKMEM_PROBE2 (arena_alloc, chunkSize, (void*)chunk);
+        if (chunk == nullptr)
         {
-            // Technically can never reach here due to the MAX_REQUEST value
-            //
-            // However it is always good to have a check.
             return nullptr;
         }
-
-        /*
-         * Check user specified foot print limit
-         */
-        if (m_footprintLimit != 0)
+        chunk = splitChunk (chunk, chunkSize);
+        if (arenaZeroesSegments ())
         {
-            size_type fp = m_footprint + estSize;
-            if (fp <= m_footprint || fp > m_footprintLimit)
-            {
-                return nullptr;
-            }
+            m_zeroChunk = chunk;
         }
+        return chunk;
+    }
 
-        /*
-         * Request memory segments from arena.
-         */
-        size_type segSize = estSize;
-        MemSegment* seg = (MemSegment*)m_arena.getSegment (segSize);
-        m_logger.logGetSegment (seg, segSize);
-
-        /*
-         * Initialize the segment obtained.
-         */
-        if (seg)
+    inline void
+    copyMemory (void* dst, const void* src, size_type size)
+    {
+        if (m_streamThreshold != 0 && size >= m_streamThreshold)
+        {
+            streamCopy (dst, src, size);
+        }
+        else
         {
+            memcpy (dst, src, size);
+        }
+    }
 
-            if ((m_footprint += segSize) > m_maxFootprint)
-            {
-                m_maxFootprint = m_footprint;
-            }
+    inline void
+    fillMemory (void* dst, int c, size_type size)
+    {
+        if (m_streamThreshold != 0 && size >= m_streamThreshold)
+        {
+            streamFill (dst, c, size);
+        }
+        else
+        {
+            memset (dst, c, size);
+        }
+    }
 
-            MemChunk* chunk = seg->init (segSize);
+    /**
+     * Check if the new segments from the arena are zero filled.
+     */
+    inline bool
+    arenaZeroesSegments ()
+    {
+        return arenaZeroesSegments (std::integral_constant<bool, ArenaHasZeroesSegments<Arena>::value> ());
+    }
+
+    inline bool
+    arenaZeroesSegments (std::true_type)
+    {
+        return m_arena.zeroesSegments ();
+    }
+
+    inline bool
+    arenaZeroesSegments (std::false_type)
+    {
+        return false;
+    }
+
+    /**
+     * Tell the logger that all the memory is about to be released, if it
+     * has a logReleaseAll function.
+     */
+    inline void
+    loggerReleaseAll ()
+    {
+        loggerReleaseAll (std::integral_constant<bool, LoggerHasReleaseAll<Logger>::value> ());
+    }
+
+    inline void
+    loggerReleaseAll (std::true_type)
+    {
+        m_logger.logReleaseAll ();
+    }
+
+    inline void
+    loggerReleaseAll (std::false_type)
+    {
+    }
+
+    /**
+     * Tell the logger the usable size of a chunk, if it has a
+     * logUsableSize function.
+     */
+    inline void
+    loggerUsableSize (T* userPtr, size_type oldUsableSize, MemChunk* chunk)
+    {
+        loggerUsableSize (userPtr, oldUsableSize, chunk, std::integral_constant<bool, LoggerHasUsableSize<Logger>::value> ());
+    }
+
+    inline void
+    loggerUsableSize (T* userPtr, size_type oldUsableSize, MemChunk* chunk, std::true_type)
+    {
+        m_logger.logUsableSize (userPtr, oldUsableSize, chunk->getUserSize ());
+    }
+
+    inline void
+    loggerUsableSize (T* userPtr, size_type oldUsableSize, MemChunk* chunk, std::false_type)
+    {
+    }
+
+    /**
+     * Obtain a new memory segment from memory arena.
+     *
+     * @param   chunkSize
+     *          the desired memory chunk size.
+     * @return  the chunk that covers the entire segment.
+     */
+    MemChunk*
+    arenaChunk (size_type chunkSize)
+    {
+        size_type estSize;             /* allocation size */
+
+        estSize = chunkSize + SEGMENT_OVERHEAD;
+        if (estSize <= chunkSize)
+        {
+            // Technically can never reach here due to the MAX_REQUEST value
+            //
+            // However it is always good to have a check.
+            return nullptr;
+        }
+
+        /*
+         * Request memory segments from arena.
+         */
+        size_type segSize = estSize;
+        MemSegment* seg = (MemSegment*)getArenaSegment (segSize);
+
+        /*
+         * Initialize the segment obtained.
+         */
+        if (seg)
+        {
+            MemChunk* chunk = seg->init (segSize);
+            m_segmentOverhead += segSize - chunk->getChunkSize ();
+            ++m_numSegments;
 
             if (m_segList == nullptr)
             {
@@ -1111,11 +2229,504 @@ private:
                 m_segList = seg;
             }
 
-            return splitChunk (chunk, chunkSize);
+            return chunk;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Forget all the segments and the free chunks when the segments are
+     * released or detached.
+     */
+    void
+    resetBins ()
+    {
+        m_segList = nullptr;
+        m_directList = nullptr;
+        m_smallMap = 0;
+        m_treeMap = 0;
+        m_footprint = 0;
+        for (size_type i = 0; i < NTREEBINS; ++i)
+        {
+            m_largeTrees[i] = PtrAVLTree ();
+        }
+        for (size_type i = 0; i < NSMALLBINS; ++i)
+        {
+            m_smallLists[i] = CircularList<SmallMemChunk> ();
+        }
+        resetStats ();
+    }
+
+    /**
+     * Reset the statistics when the segments are released or detached.
+     */
+    void
+    resetStats ()
+    {
+        memset (m_smallBinBytes, 0, sizeof(m_smallBinBytes));
+        memset (m_treeBinBytes, 0, sizeof(m_treeBinBytes));
+        m_segmentOverhead = 0;
+        m_numSegments = 0;
+        m_numDirectSegments = 0;
+        m_numUsedChunks = 0;
+    }
+
+    /**
+     * Set the chunk information of a direct segment.
+     *
+     * @return  true if the segment is not nullptr.
+     */
+    bool
+    setDirectChunkInfo (DirectSegment* seg, ChunkInfo& info)
+    {
+        if (seg == nullptr)
+        {
+            return false;
+        }
+        MemChunk* chunk = seg->getChunk ();
+        info.segment = seg;
+        info.chunk = chunk;
+        info.chunkSize = chunk->getChunkSize ();
+        info.used = true;
+        info.direct = true;
+        info.userPtr = chunk2Mem (chunk);
+        info.userSize = chunk->getUserSize ();
+        return true;
+    }
+
+    /**
+     * Get the power of two size class used by the reports.
+     */
+    static int
+    getSizeClass (size_type size)
+    {
+        int c = 0;
+        while (c < (int)(sizeof(size_type) * 8 - 1) && getSizeClassLimit (c) < size)
+        {
+            ++c;
+        }
+        return c;
+    }
+
+    static size_type
+    getSizeClassLimit (int c)
+    {
+        return ((size_type)16) << c;
+    }
+
+    /**
+     * Request a memory segment from arena, subject to the footprint limit.
+     *
+     * @param [in,out]  segSize
+     *          the segment size.
+     * @return  the segment obtained.  nullptr if failed.
+     */
+    void*
+    getArenaSegment (size_type& segSize)
+    {
+        /*
+         * Check user specified foot print limit
+         */
+        if (m_footprintLimit != 0)
+        {
+            size_type fp = m_footprint + segSize;
+            if (fp <= m_footprint || fp > m_footprintLimit)
+            {
+                return nullptr;
+            }
+        }
+
+        if (m_warmedUp)
+        {
+            m_logger.logError (nullptr, MEM_ERROR_ARENA_CALL);
+        }
+
+        void* seg = m_arena.getSegment (segSize);
+        COOKMEM_PROBE2 (segment_get, seg, segSize);
+        m_logger.logGetSegment (seg, segSize);
+        if (seg && (m_footprint += segSize) > m_maxFootprint)
+        {
+            m_maxFootprint = m_footprint;
+        }
+        return seg;
+    }
+
+    /**
+     * Release all the segments to the arena.
+     */
+    void
+    freeSegments ()
+    {
+        MemSegment* seg = m_segList;
+        while (seg)
+        {
+            void* ptr = seg;
+            size_type size = seg->getSize ();
+            seg = seg->getNext ();
+            COOKMEM_PROBE2 (segment_free, ptr, size);
+            m_logger.logFreeSegment (ptr, size);
+            m_arena.freeSegment (ptr, size);
+        }
+        DirectSegment* direct = m_directList;
+        while (direct)
+        {
+            void* ptr = direct;
+            size_type size = direct->getSize ();
+            direct = direct->getNext ();
+            COOKMEM_PROBE2 (segment_free, ptr, size);
+            m_logger.logFreeSegment (ptr, size);
+            m_arena.freeSegment (ptr, size);
+        }
+    }
+
+    /**
+     * Allocate a chunk in its own segment.
+     *
+     * @param   chunkSize
+     *          the chunk size.
+     * @return  the chunk.  nullptr if failed.
+     */
+    MemChunk*
+    directAlloc (size_type chunkSize)
+    {
+        size_type segSize = chunkSize + DIRECT_OVERHEAD;
+        if (segSize <= chunkSize)
+        {
+            return nullptr;
+        }
+        DirectSegment* seg = (DirectSegment*)getArenaSegment (segSize);
+        if (seg == nullptr)
+        {
+            return nullptr;
+        }
+        MemChunk* chunk = seg->init (segSize, chunkSize);
+        m_segmentOverhead += segSize - chunkSize;
+        ++m_numSegments;
+        ++m_numDirectSegments;
+        linkDirect (seg);
+        if (arenaZeroesSegments ())
+        {
+            m_zeroChunk = chunk;
+        }
+        return chunk;
+    }
+
+    /**
+     * Release a direct segment.
+     */
+    void
+    directFree (DirectSegment* seg)
+    {
+        // report before any state change in case the logger throws
+        if (m_warmedUp)
+        {
+            m_logger.logError (nullptr, MEM_ERROR_ARENA_CALL);
+        }
+        unlinkDirect (seg);
+        size_type size = seg->getSize ();
+        m_footprint -= size;
+        m_segmentOverhead -= size - seg->getChunk ()->getChunkSize ();
+        --m_numSegments;
+        --m_numDirectSegments;
+        COOKMEM_PROBE2 (segment_free, (void*)seg, size);
+        m_logger.logFreeSegment (seg, size);
+        m_arena.freeSegment (seg, size);
+    }
+
+    /**
+     * Reallocate a chunk that has its own segment.
+     */
+    T*
+    directReallocate (T* ptr, size_type newUserSize)
+    {
+        MemChunk* chunk = mem2Chunk (ptr);
+        DirectSegment* seg = DirectSegment::getSegment (chunk);
+        size_type oldUserSize = chunk->getUserSize ();
+        size_type oldSegSize = seg->getSize ();
+        size_type oldOverhead = oldSegSize - chunk->getChunkSize ();
+
+        size_type allocSize = getMinAllocSize (newUserSize);
+        if (allocSize >= MAX_REQUEST)
+        {
+            m_logger.logAllocation (nullptr, newUserSize);
+            return nullptr;
+        }
+        size_type newChunkSize = (allocSize < MIN_REQUEST) ? MIN_CHUNK_SIZE : calcChunkSize (allocSize);
+        size_type newSegSize = newChunkSize + DIRECT_OVERHEAD;
+
+        // Keep the segment if the new size fits, unless the segment can
+        // be shrunk to less than half.
+        if (newSegSize <= oldSegSize &&
+            (!ArenaHasResizeSegment<Arena>::value || newSegSize > oldSegSize / 2))
+        {
+            seg->init (oldSegSize, newChunkSize);
+            m_segmentOverhead = m_segmentOverhead - oldOverhead + (oldSegSize - newChunkSize);
+            setUsed (chunk, newUserSize);
+            logDirectReallocation (ptr, ptr, oldUserSize, newUserSize, chunk);
+            return ptr;
+        }
+
+        DirectSegment* newSeg = resizeDirect (seg, newSegSize, std::integral_constant<bool, ArenaHasResizeSegment<Arena>::value> ());
+        if (newSeg)
+        {
+            chunk = newSeg->init (newSegSize, newChunkSize);
+            m_segmentOverhead = m_segmentOverhead - oldOverhead + (newSegSize - newChunkSize);
+            setUsed (chunk, newUserSize);
+            T* newPtr = chunk2Mem (chunk);
+            logDirectReallocation (ptr, newPtr, oldUserSize, newUserSize, chunk);
+            return newPtr;
         }
+
+        // Fall back to allocate and copy.
+        T* newPtr = allocate (newUserSize);
+        if (newPtr)
+        {
+            copyMemory (newPtr, ptr, oldUserSize < newUserSize ? oldUserSize : newUserSize);
+            deallocate (ptr);
+        }
+        return newPtr;
+    }
+
+    /**
+     * Log a reallocation of a direct chunk the same way as the other
+     * reallocations.
+     */
+    inline void
+    logDirectReallocation (T* oldPtr, T* newPtr, size_type oldUserSize, size_type newUserSize, MemChunk* newChunk)
+    {
+        if (newUserSize <= oldUserSize && oldPtr == newPtr)
+        {
+            m_logger.logReallocation (oldPtr, oldUserSize, newUserSize);
+            loggerUsableSize (newPtr, oldUserSize, newChunk);
+        }
+        else
+        {
+            m_logger.logAllocation (newPtr, newUserSize);
+            m_logger.logDeallocation (oldPtr, oldUserSize);
+            loggerUsableSize (newPtr, 0, newChunk);
+        }
+    }
+
+    /**
+     * The arena does not support resizing segments.
+     */
+    DirectSegment*
+    resizeDirect (DirectSegment* seg, size_type& newSegSize, std::false_type)
+    {
         return nullptr;
     }
 
+    /**
+     * Resize a direct segment using the arena.
+     *
+     * @return  the resized segment.  nullptr if failed, in which case the
+     *          original segment is not changed.
+     */
+    DirectSegment*
+    resizeDirect (DirectSegment* seg, size_type& newSegSize, std::true_type)
+    {
+        size_type oldSegSize = seg->getSize ();
+        if (m_footprintLimit != 0 && newSegSize > oldSegSize)
+        {
+            size_type fp = m_footprint + (newSegSize - oldSegSize);
+            if (fp <= m_footprint || fp > m_footprintLimit)
+            {
+                return nullptr;
+            }
+        }
+        if (m_warmedUp)
+        {
+            m_logger.logError (nullptr, MEM_ERROR_ARENA_CALL);
+        }
+
+        DirectSegment* prev = seg->getPrev ();
+        DirectSegment* next = seg->getNext ();
+        DirectSegment* newSeg = (DirectSegment*)m_arena.resizeSegment (seg, oldSegSize, newSegSize);
+        if (newSeg == nullptr)
+        {
+            return nullptr;
+        }
+        COOKMEM_PROBE2 (segment_free, (void*)seg, oldSegSize);
+        COOKMEM_PROBE2 (segment_get, (void*)newSeg, newSegSize);
+        m_logger.logFreeSegment (seg, oldSegSize);
+        m_logger.logGetSegment (newSeg, newSegSize);
+
+        // the segment may have moved
+        if (prev)
+        {
+            prev->setNext (newSeg);
+        }
+        else
+        {
+            m_directList = newSeg;
+        }
+        if (next)
+        {
+            next->setPrev (newSeg);
+        }
+
+        m_footprint = m_footprint - oldSegSize + newSegSize;
+        if (m_footprint > m_maxFootprint)
+        {
+            m_maxFootprint = m_footprint;
+        }
+        return newSeg;
+    }
+
+    inline void
+    linkDirect (DirectSegment* seg)
+    {
+        seg->setPrev (nullptr);
+        seg->setNext (m_directList);
+        if (m_directList)
+        {
+            m_directList->setPrev (seg);
+        }
+        m_directList = seg;
+    }
+
+    inline void
+    unlinkDirect (DirectSegment* seg)
+    {
+        DirectSegment* prev = seg->getPrev ();
+        DirectSegment* next = seg->getNext ();
+        if (prev)
+        {
+            prev->setNext (next);
+        }
+        else
+        {
+            m_directList = next;
+        }
+        if (next)
+        {
+            next->setPrev (prev);
+        }
+    }
+
+    /**
+     * Touch the pages of a memory region to take the page faults.
+     */
+    static void
+    touchPages (char* ptr, size_type size, unsigned int numThreads)
+    {
+        size_type numPages = (size + PAGE_TOUCH_STRIDE - 1) / PAGE_TOUCH_STRIDE;
+        if (numThreads > numPages)
+        {
+            numThreads = (unsigned int)numPages;
+        }
+        if (numThreads <= 1)
+        {
+            touchRange (ptr, size);
+            return;
+        }
+
+        size_type step = ((numPages + numThreads - 1) / numThreads) * PAGE_TOUCH_STRIDE;
+        std::vector<std::thread> threads;
+        try
+        {
+            threads.reserve (numThreads - 1);
+            while (threads.size () < numThreads - 1 && step < size)
+            {
+                threads.push_back (std::thread (touchRange, ptr, step));
+                ptr += step;
+                size -= step;
+            }
+        }
+        catch (...)
+        {
+            // no more threads can be started, so the remaining pages are
+            // touched by this thread.
+        }
+        touchRange (ptr, size);
+        for (std::size_t i = 0; i < threads.size (); ++i)
+        {
+            threads[i].join ();
+        }
+    }
+
+    static void
+    touchRange (char* ptr, size_type size)
+    {
+        for (size_type i = 0; i < size; i += PAGE_TOUCH_STRIDE)
+        {
+            // write the same value back to force a writable page
+            volatile char* p = ptr + i;
+            *p = *p;
+        }
+    }
+
+    /**
+     * Add an existing segment to this MemPool, and add its free memory
+     * chunks to the bins.
+     *
+     * @param   seg
+     *          the segment previously initialized by a MemPool.
+     * @param   segSize
+     *          the segment size.
+     */
+    void
+    attachSegment (MemSegment* seg, size_type segSize)
+    {
+        if (seg->getSize () != segSize)
+        {
+            throw Exception (MEM_ERROR_GENERAL, "invalid memory segment.");
+        }
+
+        if ((m_footprint += segSize) > m_maxFootprint)
+        {
+            m_maxFootprint = m_footprint;
+        }
+
+        if (seg->isDirect ())
+        {
+            DirectSegment* direct = (DirectSegment*)seg;
+            if (direct->getChunk ()->getChunkSize () + DIRECT_OVERHEAD > segSize)
+            {
+                throw Exception (MEM_ERROR_GENERAL, "invalid memory chunk.");
+            }
+            m_segmentOverhead += segSize - direct->getChunk ()->getChunkSize ();
+            ++m_numSegments;
+            ++m_numDirectSegments;
+            ++m_numUsedChunks;
+            linkDirect (direct);
+            return;
+        }
+
+        if (m_segList == nullptr)
+        {
+            m_release_checks = MAX_RELEASE_CHECK_RATE;
+        }
+        seg->setNext (m_segList);
+        m_segList = seg;
+        ++m_numSegments;
+        m_segmentOverhead += segSize;
+
+        // The last chunk may not reach the end of the segment when the
+        // segment size is not aligned, but the gap is always smaller than
+        // the smallest chunk.
+        char* end = seg->getChunkEnd ();
+        for (char* ptr = (char*)seg->getFirstChunk (); (size_type)(end - ptr) >= MIN_CHUNK_SIZE; )
+        {
+            MemChunk* chunk = (MemChunk*)ptr;
+            size_type chunkSize = chunk->getChunkSize ();
+            if (chunkSize < MIN_CHUNK_SIZE || chunkSize > (size_type)(end - ptr))
+            {
+                throw Exception (MEM_ERROR_GENERAL, "invalid memory chunk.");
+            }
+            if (!chunk->isUsed ())
+            {
+                addChunk (chunk);
+            }
+            else
+            {
+                ++m_numUsedChunks;
+            }
+            m_segmentOverhead -= chunkSize;
+            ptr += chunkSize;
+        }
+    }
+
     inline CircularList<SmallMemChunk>&
     getSmallChunkList (BinIndexType binIndex)
     {
@@ -1129,6 +2740,7 @@ private:
 
         CircularList<SmallMemChunk>& freeList = getSmallChunkList(I);
         freeList.add ((SmallMemChunk*)chunk);
+        m_smallBinBytes[I] += chunk->getChunkSize ();
         if (!isSmallMapMarked(I))
             markSmallMap(I);
     }
@@ -1138,6 +2750,7 @@ private:
     {
         CircularList<SmallMemChunk>& freeList = getSmallChunkList (binIndex);
         SmallMemChunk* chunk = freeList.remove();
+        m_smallBinBytes[binIndex] -= chunk->getChunkSize ();
         if (freeList.isEmpty ())
         {
             clearSmallMap (binIndex);
@@ -1151,6 +2764,7 @@ private:
         BinIndexType binIndex = getSmallBinIndex (chunk->getChunkSize ());
 
         CircularList<SmallMemChunk>& freeList = getSmallChunkList (binIndex);
+        m_smallBinBytes[binIndex] -= chunk->getChunkSize ();
         if (freeList.remove ((SmallMemChunk*)chunk))
         {
             clearSmallMap (binIndex);
@@ -1204,6 +2818,7 @@ private:
             markTreeMap(treeBinIndex);
         }
         tree.add(chunk, chunk->getChunkSize());
+        m_treeBinBytes[treeBinIndex] += chunk->getChunkSize ();
     }
 
     inline void
@@ -1214,6 +2829,7 @@ private:
         PtrAVLTree& tree = treeAt(treeBinIndex);
 
         tree.remove(chunk);
+        m_treeBinBytes[treeBinIndex] -= chunk->getChunkSize ();
         if (tree.isEmpty())
         {
             clearTreeMap(treeBinIndex);
@@ -1250,7 +2866,8 @@ private:
     inline size_t
     getMinAllocSize (size_type userSize)
     {
-        return m_padding ? userSize + 1 : userSize;
+        // saturate such that a huge request does not wrap to a tiny one
+        return (m_padding && userSize != ~(size_type)0) ? userSize + 1 : userSize;
     }
 
     inline void
@@ -1280,7 +2897,10 @@ private:
     getUserPointer (MemChunk* chunk, size_type userSize)
     {
         T* userPtr = chunk2Mem (chunk);
+        COOKMEM_PROBE2 (alloc_return, (void*)userPtr, userSize);
+        ++m_numUsedChunks;
         m_logger.logAllocation (userPtr, userSize);
+        loggerUsableSize (userPtr, 0, chunk);
         return userPtr;
     }
 };
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_MLOCK_MEM_ARENA_H
+#define COOK_MLOCK_MEM_ARENA_H
+
+#ifndef WIN32
+
+#include <cstddef>
+
+#include <sys/mman.h>
+
+#ifndef MAP_POPULATE
+// Without MAP_POPULATE, mlock still faults in all the pages.
+#define MAP_POPULATE 0
+#endif
+
+namespace cookmem
+{
+
+/**
+ * An mmap based memory arena whose segments are prefaulted and locked in
+ * the physical memory.
+ *
+ * Accessing the memory of the segments never causes a page fault, which is
+ * useful for latency sensitive code paths.  It is typically used with
+ * MemContext::reserve () to obtain all the memory during the warm up.
+ *
+ * The amount of memory that can be locked is limited by RLIMIT_MEMLOCK.
+ */
+class MlockArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   minSize
+     *          minimum segment size.  It should be noted that this value
+     *          needs to be a multiple of 16.
+     * @param   strict
+     *          if true, a segment that cannot be locked is released and
+     *          the allocation fails.  Otherwise, the segment is used
+     *          without being locked.
+     */
+    MlockArena (std::size_t minSize = 65536, bool strict = false)
+      : m_minSize (minSize),
+        m_strict (strict)
+    {
+    }
+
+    /**
+     * Allocate an arena segment using mmap(), and lock it using mlock().
+     *
+     * @param   size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr is allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        if (size < m_minSize)
+        {
+            size = m_minSize;
+        }
+        void* ptr = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        if (mlock (ptr, size) != 0 && m_strict)
+        {
+            munmap (ptr, size);
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    /**
+     * Free an arena segment using munamp(), which also unlocks the pages.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        return munmap (ptr, size) != 0;
+    }
+
+    /**
+     * Check if the new segments are zero filled.
+     *
+     * @return  always true since the segments are anonymous mappings.
+     */
+    bool
+    zeroesSegments () const
+    {
+        return true;
+    }
+
+private:
+    std::size_t m_minSize;
+    bool        m_strict;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_MLOCK_MEM_ARENA_H
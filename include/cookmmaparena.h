@@ -85,6 +85,17 @@ public:
         return VirtualFree (ptr, 0, MEM_RELEASE) == 0;
     }
 
+    /**
+     * Check if the new segments are zero filled.
+     *
+     * @return  true if the segments are committed, which are zero filled.
+     */
+    bool
+    zeroesSegments () const
+    {
+        return (m_type & MEM_COMMIT) != 0;
+    }
+
 private:
     std::size_t m_minSize;
     DWORD       m_prot;
@@ -153,6 +164,49 @@ public:
         return munmap (ptr, size) != 0;
     }
 
+    /**
+     * Check if the new segments are zero filled.
+     *
+     * @return  true for anonymous mappings, which are zero filled.
+     */
+    bool
+    zeroesSegments () const
+    {
+        return (m_flag & MAP_ANONYMOUS) != 0;
+    }
+
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+    /**
+     * Resize an arena segment using mremap().  The kernel moves the page
+     * table entries if the segment cannot grow in place, so the memory
+     * is never copied.
+     *
+     * @param   ptr
+     *          the segment to be resized.
+     * @param   oldSize
+     *          the current size of the segment.
+     * @param [in,out]  newSize
+     *          the new size of the segment.  This value is updated upon
+     *          successful request to indicate the actual size obtained.
+     * @return  the resized segment, which may have moved.  nullptr if
+     *          failed, in which case the original segment is unchanged.
+     */
+    void*
+    resizeSegment (void* ptr, std::size_t oldSize, std::size_t& newSize)
+    {
+        if (newSize < m_minSize)
+        {
+            newSize = m_minSize;
+        }
+        void* newPtr = mremap (ptr, oldSize, newSize, MREMAP_MAYMOVE);
+        if (newPtr == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        return newPtr;
+    }
+#endif  // __linux__ && MREMAP_MAYMOVE
+
 private:
     std::size_t m_minSize;
     int         m_prot;
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_NUMA_MEM_ARENA_H
+#define COOK_NUMA_MEM_ARENA_H
+
+#if defined(__linux__)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cookmemarena.h"
+#include "cookmemcontext.h"
+
+namespace cookmem
+{
+
+/**
+ * The maximum number of NUMA nodes supported, which is the number of bits
+ * in the node mask passed to mbind.
+ */
+static const int NUMA_MAX_NODES = sizeof(unsigned long) * 8;
+
+/**
+ * Get the NUMA node of the CPU the calling thread is running on.
+ *
+ * @return  the current NUMA node.  0 if it cannot be determined.
+ */
+inline int
+getCurrentNumaNode ()
+{
+    unsigned int cpu;
+    unsigned int node;
+    if (syscall (SYS_getcpu, &cpu, &node, nullptr) != 0 ||
+        node >= (unsigned int)NUMA_MAX_NODES)
+    {
+        return 0;
+    }
+    return (int)node;
+}
+
+/**
+ * An mmap based memory arena that binds the segments to a NUMA node.
+ *
+ * The binding is done with the mbind system call directly, so libnuma is
+ * not required.  Pages are only bound to the node, they are still
+ * allocated on the first touch.
+ */
+class NumaMmapArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   node
+     *          the NUMA node to bind the segments to.  -1 does not bind
+     *          the segments.
+     * @param   minSize
+     *          minimum segment size.  It should be noted that this value
+     *          needs to be a multiple of 16.
+     * @param   strict
+     *          if true, a segment that cannot be bound to the node is
+     *          released and the allocation fails.  Otherwise, the segment
+     *          is used with the default memory policy.
+     */
+    NumaMmapArena (int node = -1, std::size_t minSize = 65536, bool strict = false)
+      : m_minSize (minSize),
+        m_node (node),
+        m_strict (strict)
+    {
+    }
+
+    /**
+     * Allocate an arena segment using mmap() and bind it to the node.
+     *
+     * @param   size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr is allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        if (size < m_minSize)
+        {
+            size = m_minSize;
+        }
+        void* ptr = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        if (m_node >= 0 && !bind (ptr, size, m_node) && m_strict)
+        {
+            munmap (ptr, size);
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    /**
+     * Free an arena segment using munamp().
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        return munmap (ptr, size) != 0;
+    }
+
+    /**
+     * Check if the new segments are zero filled.
+     *
+     * @return  always true since the segments are anonymous mappings.
+     */
+    bool
+    zeroesSegments () const
+    {
+        return true;
+    }
+
+    /**
+     * Get the NUMA node the segments are bound to.
+     *
+     * @return  the NUMA node.  -1 if the segments are not bound.
+     */
+    int
+    getNode () const
+    {
+        return m_node;
+    }
+
+    /**
+     * Set the NUMA node for the segments obtained afterward.
+     *
+     * @param   node
+     *          the NUMA node.  -1 does not bind the segments.
+     */
+    void
+    setNode (int node)
+    {
+        m_node = node;
+    }
+
+private:
+    /**
+     * Bind a memory region to a node.
+     *
+     * @return  true if successful.  false otherwise.
+     */
+    static bool
+    bind (void* ptr, std::size_t size, int node)
+    {
+        if (node >= NUMA_MAX_NODES)
+        {
+            return false;
+        }
+        const int MPOL_BIND_MODE = 2;
+        unsigned long mask = 1UL << node;
+        // The kernel expects the number of bits plus one.
+        return syscall (SYS_mbind, ptr, size, MPOL_BIND_MODE, &mask, NUMA_MAX_NODES + 1, 0) == 0;
+    }
+
+private:
+    std::size_t m_minSize;
+    int         m_node;
+    bool        m_strict;
+};
+
+/**
+ * A set of CachedArena, one per NUMA node, such that the segments cached
+ * are never handed out to a context on another node.
+ *
+ * Like CachedArena, this class is not thread safe.  It is typically owned
+ * by a worker thread, and the thread obtains the arena of the node it is
+ * currently running on when a new context is created.
+ */
+class NumaCachedArenas
+{
+public:
+    typedef CachedArena<NumaMmapArena>  Arena;
+
+private:
+    /**
+     * Internal per node arena.
+     */
+    struct NodeArena
+    {
+        NumaMmapArena   arena;
+        Arena           cachedArena;
+
+        NodeArena ()
+        : arena (),
+          cachedArena (arena)
+        {
+        }
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   minSize
+     *          minimum segment size.
+     * @param   strict
+     *          whether segments that cannot be bound are rejected.
+     */
+    NumaCachedArenas (std::size_t minSize = 65536, bool strict = false)
+    {
+        for (int i = 0; i < NUMA_MAX_NODES; ++i)
+        {
+            m_nodes[i].arena = NumaMmapArena (i, minSize, strict);
+        }
+    }
+
+    /**
+     * Get the cached arena for a node.
+     *
+     * @param   node
+     *          the NUMA node.
+     * @return  the cached arena for the node.
+     */
+    Arena&
+    getArena (int node)
+    {
+        if (node < 0 || node >= NUMA_MAX_NODES)
+        {
+            node = 0;
+        }
+        return m_nodes[node].cachedArena;
+    }
+
+    /**
+     * Get the cached arena for the node the calling thread is running on.
+     *
+     * @return  the cached arena for the current node.
+     */
+    Arena&
+    getLocalArena ()
+    {
+        return getArena (getCurrentNumaNode ());
+    }
+
+private:
+    NodeArena   m_nodes[NUMA_MAX_NODES];
+};
+
+/**
+ * Internal use.
+ */
+template<class Logger>
+struct NumaMemContainer
+{
+    NumaMmapArena   arena;
+    Logger          logger;
+
+    NumaMemContainer (int node)
+    : arena (node),
+      logger ()
+    {
+    }
+
+    virtual ~NumaMemContainer ()
+    {
+    }
+};
+
+/**
+ * A memory context whose segments are bound to the NUMA node of the
+ * thread that created the context.
+ *
+ * On a single node machine, this context behaves the same as a
+ * SimpleMemContext using MmapArena.
+ */
+template<class Logger = NoActionMemLogger, class T = void>
+class NumaMemContext : private NumaMemContainer<Logger>, public MemContext<NumaMmapArena, Logger, T>
+{
+public:
+    typedef NumaMemContainer<Logger>            Container;
+    typedef MemContext<NumaMmapArena, Logger, T>    MemCtx;
+
+    /** size type */
+    typedef typename MemCtx::size_type          size_type;
+    /** pointer difference type */
+    typedef typename MemCtx::difference_type    difference_type;
+    /** value type */
+    typedef typename MemCtx::value_type         value_type;
+    /** pointer type */
+    typedef typename MemCtx::pointer            pointer;
+    /** const pointer type */
+    typedef typename MemCtx::const_pointer      const_pointer;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   padding
+     *          whether to pad bytes after the allocated memory.
+     * @param   node
+     *          the NUMA node.  By default, it is the node of the calling
+     *          thread.
+     */
+    NumaMemContext (bool padding = false, int node = getCurrentNumaNode ())
+    : Container (node),
+      MemCtx (Container::arena, Container::logger, padding)
+    {
+    }
+
+    virtual ~NumaMemContext ()
+    {
+    }
+};
+
+}   // namespace cookmem
+
+#endif  // __linux__
+
+#endif  // COOK_NUMA_MEM_ARENA_H
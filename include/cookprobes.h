@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_PROBES_H
+#define COOK_PROBES_H
+
+/*
+ * Static tracepoints for bpftrace, perf, SystemTap and similar tools.
+ *
+ * When <sys/sdt.h> is available, each probe compiles to a single NOP plus
+ * an ELF note describing where the arguments are.  The tools patch the
+ * NOP only while they trace, so the probes cost next to nothing otherwise.
+ * Without the header, or with COOKMEM_NO_PROBES defined, the probes are
+ * removed entirely.
+ *
+ * The provider is "cookmem".  For example,
+ *
+ *     bpftrace -e 'usdt:./app:cookmem:segment_get { @[arg1] = count (); }'
+ *
+ * counts the segment sizes obtained from the arena.
+ *
+ * The probe macros can also be defined before including cookmem headers to
+ * hook the probe points in other ways.
+ */
+
+#if !defined(COOKMEM_PROBE1)
+
+#if !defined(COOKMEM_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define COOKMEM_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef COOKMEM_HAVE_SDT
+#define COOKMEM_PROBE1(name, a1)            DTRACE_PROBE1 (cookmem, name, a1)
+#define COOKMEM_PROBE2(name, a1, a2)        DTRACE_PROBE2 (cookmem, name, a1, a2)
+#define COOKMEM_PROBE3(name, a1, a2, a3)    DTRACE_PROBE3 (cookmem, name, a1, a2, a3)
+#else
+#define COOKMEM_PROBE1(name, a1)
+#define COOKMEM_PROBE2(name, a1, a2)
+#define COOKMEM_PROBE3(name, a1, a2, a3)
+#endif /* COOKMEM_HAVE_SDT */
+
+#endif /* COOKMEM_PROBE1 */
+
+#endif  // COOK_PROBES_H
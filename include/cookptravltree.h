@@ -386,6 +386,26 @@ public:
         return m_root == nullptr;
     }
 
+    /**
+     * Get the largest size in the tree.
+     *
+     * @return  the largest size.  0 if the tree is empty.
+     */
+    std::size_t
+    getMaxSize () const
+    {
+        const Node* node = m_root;
+        if (node == nullptr)
+        {
+            return 0;
+        }
+        while (node->right)
+        {
+            node = node->right;
+        }
+        return node->size;
+    }
+
     /**
      * Debugging function that prints the tree nodes to GraphViz format.
      */
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_REGION_MEM_ARENA_H
+#define COOK_REGION_MEM_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "cookexception.h"
+
+namespace cookmem
+{
+
+/**
+ * A memory arena that carves segments out of a single memory region.
+ *
+ * All the bookkeeping information, including the region header and the
+ * boundary tags of the segments, is stored inside the region itself.  So
+ * a region that is mapped again at the same address (such as a memory
+ * mapped file) can be attached along with all its segments.
+ *
+ * Segments are found using first fit.  Released segments are coalesced
+ * with the free neighbors.
+ */
+class RegionArena
+{
+private:
+    /**
+     * The region header at the start of the region.
+     */
+    struct Header
+    {
+        /** magic number to validate the region.  It is set last. */
+        std::atomic<std::uint64_t>  magic;
+        /** the address the region was initialized at */
+        void*           base;
+        /** the size of the region */
+        std::size_t     capacity;
+        /** the offset of the unused space at the end */
+        std::size_t     top;
+        /** the size and the used flag of the block just below top */
+        std::size_t     topPrev;
+        /** user data root pointer */
+        std::atomic<void*>  root;
+        /** reserved */
+        std::size_t     reserved[2];
+    };
+
+    /**
+     * The boundary tag in front of each block.
+     *
+     * Similar to the memory chunk of MemPool, the lowest bit of the sizes
+     * is used to indicate if the block is being used.
+     */
+    struct Tag
+    {
+        /** the size of the previous block.  0 for the first block. */
+        std::size_t     prevSize;
+        /** the size of this block, including the tag. */
+        std::size_t     size;
+    };
+
+    static const std::uint64_t  MAGIC = 0x636f6f6b72676e31ULL;
+    static const std::size_t    BIT_USED = 1;
+    static const std::size_t    ALIGN_MASK = 0x0f;
+    static const std::size_t    HEADER_SIZE = (sizeof(Header) + ALIGN_MASK) & ~ALIGN_MASK;
+    static const std::size_t    TAG_SIZE = sizeof(Tag);
+    /** the smallest free block worth splitting */
+    static const std::size_t    MIN_SPLIT_SIZE = 256;
+
+public:
+    /**
+     * Default constructor.  The arena is not usable until init () is called.
+     */
+    RegionArena ()
+    : m_header (nullptr)
+    {
+    }
+
+    /**
+     * Constructor.
+     *
+     * @param   ptr
+     *          the memory region.  It needs to be 16-byte aligned.
+     * @param   size
+     *          the size of the memory region.
+     * @param   attach
+     *          if true, and the region has been previously initialized at
+     *          the same address, the existing segments are kept.
+     */
+    RegionArena (void* ptr, std::size_t size, bool attach = false)
+    : m_header (nullptr)
+    {
+        init (ptr, size, attach);
+    }
+
+    /**
+     * Initialize the arena.
+     *
+     * @param   ptr
+     *          the memory region.  It needs to be 16-byte aligned.
+     * @param   size
+     *          the size of the memory region.
+     * @param   attach
+     *          if true, and the region has been previously initialized at
+     *          the same address, the existing segments are kept.
+     * @return  true if an existing region was attached.  false if the
+     *          region is initialized as empty.
+     */
+    bool
+    init (void* ptr, std::size_t size, bool attach = false)
+    {
+        COOKMEM_ASSERT (((std::size_t)ptr & ALIGN_MASK) == 0);
+
+        m_header = nullptr;
+        if (size < HEADER_SIZE)
+        {
+            return false;
+        }
+        m_header = reinterpret_cast<Header*>(ptr);
+        if (attach && isRegion (ptr, size))
+        {
+            return true;
+        }
+        // publish the magic after the rest of the header, so that another
+        // process mapping the region never sees a partial header.
+        m_header->magic.store (0, std::memory_order_relaxed);
+        m_header->base = ptr;
+        m_header->capacity = size & ~ALIGN_MASK;
+        m_header->top = HEADER_SIZE;
+        m_header->topPrev = 0;
+        m_header->root.store (nullptr, std::memory_order_relaxed);
+        m_header->magic.store (MAGIC, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * Check if a memory region has been previously initialized at the same
+     * address with the same size.
+     *
+     * @param   ptr
+     *          the memory region.  It needs to be 16-byte aligned.
+     * @param   size
+     *          the size of the memory region.
+     * @return  true if the region can be attached.  false otherwise.
+     */
+    static bool
+    isRegion (const void* ptr, std::size_t size)
+    {
+        if (size < HEADER_SIZE)
+        {
+            return false;
+        }
+        const Header* header = reinterpret_cast<const Header*>(ptr);
+        return header->magic.load (std::memory_order_acquire) == MAGIC &&
+               header->base == ptr &&
+               header->capacity == (size & ~ALIGN_MASK);
+    }
+
+    /**
+     * Allocate an arena segment.
+     *
+     * @param [in,out]  size
+     *          the size of the segment.  This value is updated upon successful
+     *          request to indicate the actual size obtained.
+     * @return  the allocated pointer.  nullptr if allocation failed.
+     */
+    void*
+    getSegment (std::size_t& size)
+    {
+        if (m_header == nullptr)
+        {
+            return nullptr;
+        }
+        std::size_t need = ((size + ALIGN_MASK) & ~ALIGN_MASK) + TAG_SIZE;
+        if (need <= size)
+        {
+            return nullptr;
+        }
+
+        // first fit among the free blocks
+        char* const base = getBase ();
+        char* const top = base + m_header->top;
+        for (char* ptr = base + HEADER_SIZE; ptr < top; ptr += getBlockSize (ptr))
+        {
+            Tag* tag = reinterpret_cast<Tag*>(ptr);
+            if ((tag->size & BIT_USED) || tag->size < need)
+            {
+                continue;
+            }
+            std::size_t blockSize = tag->size;
+            if (blockSize - need >= MIN_SPLIT_SIZE)
+            {
+                Tag* remain = reinterpret_cast<Tag*>(ptr + need);
+                remain->prevSize = need | BIT_USED;
+                remain->size = blockSize - need;
+                setNextPrevSize (remain);
+                blockSize = need;
+            }
+            tag->size = blockSize | BIT_USED;
+            setNextPrevSize (tag);
+            size = blockSize - TAG_SIZE;
+            return ptr + TAG_SIZE;
+        }
+
+        // allocate from the unused space at the end
+        if (need > m_header->capacity - m_header->top)
+        {
+            return nullptr;
+        }
+        Tag* tag = reinterpret_cast<Tag*>(top);
+        tag->prevSize = m_header->topPrev;
+        tag->size = need | BIT_USED;
+        m_header->top += need;
+        m_header->topPrev = tag->size;
+        size = need - TAG_SIZE;
+        return top + TAG_SIZE;
+    }
+
+    /**
+     * Free an arena segment.
+     *
+     * @param   ptr
+     *          the pointer to be freed.
+     * @param   size
+     *          the size of the pointer.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        if (!contains (ptr))
+        {
+            return true;
+        }
+        char* block = reinterpret_cast<char*>(ptr) - TAG_SIZE;
+        Tag* tag = reinterpret_cast<Tag*>(block);
+        if (!(tag->size & BIT_USED) || getBlockSize (block) != size + TAG_SIZE)
+        {
+            return true;
+        }
+
+        char* const top = getBase () + m_header->top;
+        std::size_t blockSize = getBlockSize (block);
+        // clear the used bit first in case the tag ends up inside a larger
+        // free block, so freeing it again is detected.
+        tag->size = blockSize;
+
+        // coalesce with the next block
+        char* next = block + blockSize;
+        if (next < top && !(reinterpret_cast<Tag*>(next)->size & BIT_USED))
+        {
+            blockSize += reinterpret_cast<Tag*>(next)->size;
+        }
+        // coalesce with the previous block
+        if (tag->prevSize != 0 && !(tag->prevSize & BIT_USED))
+        {
+            block -= tag->prevSize;
+            blockSize += tag->prevSize;
+            tag = reinterpret_cast<Tag*>(block);
+        }
+
+        if (block + blockSize == top)
+        {
+            // The block is at the end.  Simply return it to the unused space.
+            m_header->top = block - getBase ();
+            m_header->topPrev = tag->prevSize;
+        }
+        else
+        {
+            tag->size = blockSize;
+            setNextPrevSize (tag);
+        }
+        return false;
+    }
+
+    /**
+     * Iterate through the segments being used.
+     *
+     * @param   ptr
+     *          the previous segment obtained from this function.  nullptr
+     *          to get the first segment.
+     * @param [out] size
+     *          the size of the segment returned.
+     * @return  the next segment being used.  nullptr if there are no more.
+     */
+    void*
+    nextSegment (void* ptr, std::size_t& size)
+    {
+        if (m_header == nullptr)
+        {
+            return nullptr;
+        }
+        char* const top = getBase () + m_header->top;
+        char* block;
+        if (ptr == nullptr)
+        {
+            block = getBase () + HEADER_SIZE;
+        }
+        else
+        {
+            block = reinterpret_cast<char*>(ptr) - TAG_SIZE;
+            block += getBlockSize (block);
+        }
+        for (; block < top; block += getBlockSize (block))
+        {
+            Tag* tag = reinterpret_cast<Tag*>(block);
+            if (tag->size & BIT_USED)
+            {
+                size = getBlockSize (block) - TAG_SIZE;
+                return block + TAG_SIZE;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Check if a pointer is within the segment space of this region.
+     *
+     * @param   ptr
+     *          memory pointer
+     * @return  true if the pointer is in the region.  false otherwise.
+     */
+    bool
+    contains (const void* ptr) const
+    {
+        if (m_header == nullptr)
+        {
+            return false;
+        }
+        const char* p = reinterpret_cast<const char*>(ptr);
+        const char* base = reinterpret_cast<const char*>(m_header);
+        return p >= base + HEADER_SIZE && p < base + m_header->top;
+    }
+
+    /**
+     * Get the user data root pointer saved in the region.
+     *
+     * @return  the root pointer.
+     */
+    void*
+    getRoot () const
+    {
+        return m_header ? m_header->root.load (std::memory_order_acquire) : nullptr;
+    }
+
+    /**
+     * Save a user data root pointer in the region, such that the data can
+     * be found after the region is attached again.  The data written
+     * before are visible to another process that reads the root pointer.
+     *
+     * @param   root
+     *          the root pointer.
+     */
+    void
+    setRoot (void* root)
+    {
+        if (m_header)
+        {
+            m_header->root.store (root, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Get the number of bytes used by the segments and their tags.
+     *
+     * @return  the number of bytes used.
+     */
+    std::size_t
+    getUsedSize () const
+    {
+        return m_header ? m_header->top - HEADER_SIZE : 0;
+    }
+
+private:
+    inline char*
+    getBase () const
+    {
+        return reinterpret_cast<char*>(m_header);
+    }
+
+    static inline std::size_t
+    getBlockSize (const char* block)
+    {
+        return reinterpret_cast<const Tag*>(block)->size & ~BIT_USED;
+    }
+
+    /**
+     * Update the previous size information of the block after a block.
+     */
+    inline void
+    setNextPrevSize (Tag* tag)
+    {
+        char* next = reinterpret_cast<char*>(tag) + (tag->size & ~BIT_USED);
+        if (next < getBase () + m_header->top)
+        {
+            reinterpret_cast<Tag*>(next)->prevSize = tag->size;
+        }
+        else
+        {
+            m_header->topPrev = tag->size;
+        }
+    }
+
+private:
+    Header*     m_header;
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_REGION_MEM_ARENA_H
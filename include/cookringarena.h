@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_RING_MEM_ARENA_H
+#define COOK_RING_MEM_ARENA_H
+
+#ifndef WIN32
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cookexception.h"
+
+namespace cookmem
+{
+
+/**
+ * A memory arena that maps the same memory twice back to back.
+ *
+ * The byte at base + capacity + i is the same byte as base + i.  So any
+ * range of up to capacity bytes starting inside the first mapping is
+ * contiguous, even if it wraps around the end of the ring.
+ *
+ * The memory is backed by an anonymous memfd.  On systems without memfd,
+ * an unlinked temporary file is used instead.
+ */
+class RingArena
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   capacity
+     *          the size of the ring.  It is rounded up to the page size.
+     */
+    RingArena (std::size_t capacity)
+    : m_base (nullptr),
+      m_capacity (0)
+    {
+        std::size_t pageMask = (std::size_t)sysconf (_SC_PAGESIZE) - 1;
+        capacity = (capacity + pageMask) & ~pageMask;
+        if (capacity == 0)
+        {
+            return;
+        }
+
+        int fd = openMemFile ();
+        if (fd < 0)
+        {
+            return;
+        }
+        if (ftruncate (fd, (off_t)capacity) != 0)
+        {
+            close (fd);
+            return;
+        }
+
+        // reserve the address space for both mappings first
+        char* base = (char*)mmap (nullptr, capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            close (fd);
+            return;
+        }
+        if (mmap (base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap (base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            munmap (base, capacity * 2);
+            close (fd);
+            return;
+        }
+        // the mappings keep the memory alive
+        close (fd);
+
+        m_base = base;
+        m_capacity = capacity;
+    }
+
+    /**
+     * Destructor.
+     */
+    ~RingArena ()
+    {
+        if (m_base)
+        {
+            munmap (m_base, m_capacity * 2);
+        }
+    }
+
+    /**
+     * Check if the ring was successfully mapped.
+     *
+     * @return  true if the ring is mapped.  false otherwise.
+     */
+    bool
+    isOpen () const
+    {
+        return m_base != nullptr;
+    }
+
+    /**
+     * Get the start of the ring.
+     *
+     * @return  the start of the first mapping.
+     */
+    char*
+    getBase () const
+    {
+        return m_base;
+    }
+
+    /**
+     * Get the size of the ring.
+     *
+     * @return  the size of the ring.
+     */
+    std::size_t
+    getCapacity () const
+    {
+        return m_capacity;
+    }
+
+private:
+    RingArena (const RingArena&) = delete;
+    RingArena& operator= (const RingArena&) = delete;
+
+    static int
+    openMemFile ()
+    {
+#ifdef SYS_memfd_create
+        int fd = (int)syscall (SYS_memfd_create, "cookmem_ring", 0);
+        if (fd >= 0)
+        {
+            return fd;
+        }
+#endif
+        char path[] = "/tmp/cookmem_ring_XXXXXX";
+        int fd2 = mkstemp (path);
+        if (fd2 >= 0)
+        {
+            unlink (path);
+        }
+        return fd2;
+    }
+
+private:
+    char*           m_base;
+    std::size_t     m_capacity;
+};
+
+/**
+ * A FIFO memory context on top of a RingArena.
+ *
+ * Memory is allocated at the head of the ring and released from the tail.
+ * Consecutive allocations are contiguous, so the data between the tail and
+ * the head can always be accessed as a single range.  This is useful for
+ * parsing a stream of variable length records directly from the buffer
+ * that read () fills, without copying the records that wrap around the end
+ * of the ring.
+ *
+ * The memory allocated has no alignment guarantee.
+ */
+class RingMemContext
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   arena
+     *          the ring arena.
+     */
+    RingMemContext (RingArena& arena)
+    : m_arena (arena),
+      m_tail (0),
+      m_used (0),
+      m_last (0)
+    {
+    }
+
+    /**
+     * Allocate memory at the head of the ring.
+     *
+     * @param   size
+     *          memory request size.
+     * @return  the memory allocated.  nullptr if the size is 0 or there is
+     *          not enough free space in the ring.
+     */
+    char*
+    allocate (std::size_t size)
+    {
+        if (size == 0 || size > getFreeSize ())
+        {
+            return nullptr;
+        }
+        char* ptr = getHead ();
+        m_used += size;
+        m_last = size;
+        return ptr;
+    }
+
+    /**
+     * Shrink the most recent allocation, and give the unused memory back
+     * to the head of the ring.  It is typically used after read () fills
+     * less than what was allocated.
+     *
+     * @param   ptr
+     *          the most recent allocation.
+     * @param   size
+     *          the new size.  It cannot be larger than the allocated size.
+     * @return  ptr
+     */
+    char*
+    reallocate (char* ptr, std::size_t size)
+    {
+        if (m_last == 0 || size > m_last || ptr != getPointer (m_tail + m_used - m_last))
+        {
+            throw Exception (MEM_ERROR_GENERAL, "only the most recent allocation can be shrunk.");
+        }
+        m_used -= m_last - size;
+        m_last = size;
+        return ptr;
+    }
+
+    /**
+     * Release memory from the tail of the ring.
+     *
+     * @param   ptr
+     *          the tail of the ring, which must be the value of getTail ().
+     * @param   size
+     *          the number of bytes to release.
+     */
+    void
+    deallocate (char* ptr, std::size_t size)
+    {
+        if (ptr != getTail () || size > getUsedSize ())
+        {
+            throw Exception (MEM_ERROR_GENERAL, "memory must be released from the tail of the ring.");
+        }
+        m_tail += size;
+        if (m_tail >= m_arena.getCapacity ())
+        {
+            m_tail -= m_arena.getCapacity ();
+        }
+        m_used -= size;
+        if (m_used < m_last)
+        {
+            m_last = m_used;
+        }
+    }
+
+    /**
+     * Release all the memory in the ring.
+     */
+    void
+    releaseAll ()
+    {
+        m_tail = 0;
+        m_used = 0;
+        m_last = 0;
+    }
+
+    /**
+     * Get the oldest memory not yet released.
+     *
+     * @return  the tail of the ring.
+     */
+    char*
+    getTail () const
+    {
+        return getPointer (m_tail);
+    }
+
+    /**
+     * Get the position of the next allocation.
+     *
+     * @return  the head of the ring.
+     */
+    char*
+    getHead () const
+    {
+        return getPointer (m_tail + m_used);
+    }
+
+    /**
+     * Get the number of bytes allocated but not yet released.  These bytes
+     * are contiguous starting from getTail ().
+     *
+     * @return  the number of bytes used.
+     */
+    std::size_t
+    getUsedSize () const
+    {
+        return m_used;
+    }
+
+    /**
+     * Get the number of bytes that can still be allocated.
+     *
+     * @return  the number of bytes free.
+     */
+    std::size_t
+    getFreeSize () const
+    {
+        return m_arena.getCapacity () - getUsedSize ();
+    }
+
+private:
+    /**
+     * Get the pointer of an offset less than twice the capacity.
+     */
+    inline char*
+    getPointer (std::size_t offset) const
+    {
+        if (offset >= m_arena.getCapacity ())
+        {
+            offset -= m_arena.getCapacity ();
+        }
+        return m_arena.getBase () + offset;
+    }
+
+private:
+    RingArena&      m_arena;
+    /** the offset of the tail */
+    std::size_t     m_tail;
+    /** the number of bytes between the tail and the head */
+    std::size_t     m_used;
+    /** the size of the most recent allocation */
+    std::size_t     m_last;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_RING_MEM_ARENA_H
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_SAMPLING_MEM_LOGGER_H
+#define COOK_SAMPLING_MEM_LOGGER_H
+
+#ifndef WIN32
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <execinfo.h>
+
+#include "cookmemlogger.h"
+
+namespace cookmem
+{
+
+/**
+ * A MemLogger that samples the allocations and produces heap profiles that
+ * can be read by pprof.
+ *
+ * Like tcmalloc, the distance between two samples is a random number of
+ * bytes following a geometric distribution, whose mean is the sample
+ * interval.  So an allocation of size s is sampled with the probability of
+ * 1 - exp (-s / interval), and large allocations are almost always
+ * sampled.  An allocation that is not sampled only costs a subtraction.
+ *
+ * A backtrace is captured for each sampled allocation, and the sample is
+ * tracked until the memory is freed.  Frees need a hash lookup only when
+ * there are live samples.
+ *
+ * The internal tables use the global heap.  Memory corruptions are
+ * reported the same way as NoActionMemLogger.
+ */
+class SamplingMemLogger
+{
+public:
+    /** the maximum number of stack frames captured */
+    static const int MAX_FRAMES = 32;
+
+private:
+    /**
+     * The samples of a unique call stack.
+     */
+    struct Stack
+    {
+        std::vector<void*>  frames;
+        std::size_t         liveCount;
+        std::size_t         liveBytes;
+        std::size_t         allocCount;
+        std::size_t         allocBytes;
+    };
+
+    /**
+     * A sampled allocation that is still live.
+     */
+    struct LiveSample
+    {
+        std::size_t stack;
+        std::size_t size;
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   sampleInterval
+     *          the average number of bytes between samples.  1 samples
+     *          every allocation.
+     * @param   seed
+     *          the random seed.
+     */
+    SamplingMemLogger (std::size_t sampleInterval = 512 * 1024, std::uint64_t seed = 0x2545f4914f6cdd1dULL)
+    : m_sampleInterval (sampleInterval ? sampleInterval : 1),
+      m_random (seed ? seed : 1),
+      m_bytesUntilSample (0)
+    {
+        m_bytesUntilSample = nextSampleDistance ();
+    }
+
+    /**
+     * Get the sample interval.
+     *
+     * @return  the average number of bytes between samples.
+     */
+    std::size_t
+    getSampleInterval () const
+    {
+        return m_sampleInterval;
+    }
+
+    /**
+     * Set the sample interval.
+     *
+     * @param   sampleInterval
+     *          the average number of bytes between samples.  Changing the
+     *          interval while there are live samples makes the profile
+     *          inaccurate.
+     */
+    void
+    setSampleInterval (std::size_t sampleInterval)
+    {
+        m_sampleInterval = sampleInterval ? sampleInterval : 1;
+        m_bytesUntilSample = nextSampleDistance ();
+    }
+
+    /**
+     * Get the number of live samples.
+     */
+    std::size_t
+    getNumLiveSamples () const
+    {
+        return m_live.size ();
+    }
+
+    /**
+     * Estimate the number of bytes live from the samples.
+     *
+     * @return  the estimated number of bytes allocated.
+     */
+    double
+    getEstimatedLiveBytes () const
+    {
+        double total = 0;
+        for (std::unordered_map<void*, LiveSample>::const_iterator it = m_live.begin (); it != m_live.end (); ++it)
+        {
+            total += it->second.size * getScale (it->second.size);
+        }
+        return total;
+    }
+
+    /**
+     * Write the heap profile in the legacy heap profile format of pprof.
+     *
+     * @param   file
+     *          the output file.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    writeHeapProfile (FILE* file) const
+    {
+        std::size_t liveCount = 0;
+        std::size_t liveBytes = 0;
+        std::size_t allocCount = 0;
+        std::size_t allocBytes = 0;
+        for (std::size_t i = 0; i < m_stacks.size (); ++i)
+        {
+            liveCount += m_stacks[i].liveCount;
+            liveBytes += m_stacks[i].liveBytes;
+            allocCount += m_stacks[i].allocCount;
+            allocBytes += m_stacks[i].allocBytes;
+        }
+        // pprof scales the samples of heap_v2 profiles using the interval.
+        fprintf (file, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+                 liveCount, liveBytes, allocCount, allocBytes, m_sampleInterval);
+        for (std::size_t i = 0; i < m_stacks.size (); ++i)
+        {
+            const Stack& stack = m_stacks[i];
+            fprintf (file, "%zu: %zu [%zu: %zu] @",
+                     stack.liveCount, stack.liveBytes, stack.allocCount, stack.allocBytes);
+            for (std::size_t j = 0; j < stack.frames.size (); ++j)
+            {
+                fprintf (file, " %p", stack.frames[j]);
+            }
+            fprintf (file, "\n");
+        }
+
+        // the mappings are needed to symbolize the addresses.
+        fprintf (file, "\nMAPPED_LIBRARIES:\n");
+        FILE* maps = fopen ("/proc/self/maps", "r");
+        if (maps)
+        {
+            char buffer[4096];
+            std::size_t n;
+            while ((n = fread (buffer, 1, sizeof(buffer), maps)) > 0)
+            {
+                fwrite (buffer, 1, n, file);
+            }
+            fclose (maps);
+        }
+        return ferror (file) != 0;
+    }
+
+    /**
+     * Write the heap profile to a file.
+     *
+     * @param   path
+     *          the file path.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    dumpHeapProfile (const char* path) const
+    {
+        FILE* file = fopen (path, "w");
+        if (file == nullptr)
+        {
+            return true;
+        }
+        bool error = writeHeapProfile (file);
+        return (fclose (file) != 0) || error;
+    }
+
+    inline void logGetSegment (void* segment, std::size_t segmentSize) { }
+
+    inline void logFreeSegment (void* segment, std::size_t segmentSize) { }
+
+    inline void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        if (userSize < m_bytesUntilSample)
+        {
+            m_bytesUntilSample -= userSize;
+            return;
+        }
+        if (userPtr)
+        {
+            sample (userPtr, userSize);
+        }
+    }
+
+    inline void
+    logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        if (!m_live.empty ())
+        {
+            std::unordered_map<void*, LiveSample>::iterator it = m_live.find (userPtr);
+            if (it != m_live.end ())
+            {
+                Stack& stack = m_stacks[it->second.stack];
+                stack.liveBytes = stack.liveBytes - it->second.size + newUserSize;
+                it->second.size = newUserSize;
+            }
+        }
+    }
+
+    inline void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        if (!m_live.empty ())
+        {
+            std::unordered_map<void*, LiveSample>::iterator it = m_live.find (userPtr);
+            if (it != m_live.end ())
+            {
+                Stack& stack = m_stacks[it->second.stack];
+                --stack.liveCount;
+                stack.liveBytes -= it->second.size;
+                m_live.erase (it);
+            }
+        }
+    }
+
+    inline void
+    logError (void* userPtr, MemError_et error)
+    {
+        throw Exception (error, "memory corruption detected.");
+    }
+
+private:
+    SamplingMemLogger (const SamplingMemLogger&) = delete;
+    SamplingMemLogger& operator= (const SamplingMemLogger&) = delete;
+
+    /**
+     * Record a sample.  It is not inlined to keep the fast path small.
+     */
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((noinline))
+#endif
+    void
+    sample (void* userPtr, std::size_t userSize)
+    {
+        m_bytesUntilSample = nextSampleDistance ();
+
+        void* frames[MAX_FRAMES + 2];
+        int n = backtrace (frames, MAX_FRAMES + 2);
+        // skip this function and logAllocation
+        int skip = n > 2 ? 2 : 0;
+        std::vector<void*> key (frames + skip, frames + n);
+
+        std::map<std::vector<void*>, std::size_t>::iterator it = m_stackIndex.find (key);
+        std::size_t index;
+        if (it == m_stackIndex.end ())
+        {
+            index = m_stacks.size ();
+            Stack stack;
+            stack.frames = key;
+            stack.liveCount = stack.liveBytes = stack.allocCount = stack.allocBytes = 0;
+            m_stacks.push_back (stack);
+            m_stackIndex[key] = index;
+        }
+        else
+        {
+            index = it->second;
+        }
+
+        Stack& stack = m_stacks[index];
+        ++stack.liveCount;
+        stack.liveBytes += userSize;
+        ++stack.allocCount;
+        stack.allocBytes += userSize;
+
+        LiveSample& live = m_live[userPtr];
+        live.stack = index;
+        live.size = userSize;
+    }
+
+    /**
+     * Get a random distance to the next sample.
+     */
+    std::size_t
+    nextSampleDistance ()
+    {
+        if (m_sampleInterval == 1)
+        {
+            return 1;
+        }
+        // xorshift64*
+        m_random ^= m_random >> 12;
+        m_random ^= m_random << 25;
+        m_random ^= m_random >> 27;
+        std::uint64_t r = m_random * 0x2545f4914f6cdd1dULL;
+        // uniform in (0, 1]
+        double u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+        double d = -std::log (u) * m_sampleInterval;
+        return d < 1 ? 1 : (std::size_t)d;
+    }
+
+    /**
+     * The number of allocations a sample of the size represents.
+     */
+    double
+    getScale (std::size_t size) const
+    {
+        if (m_sampleInterval == 1 || size == 0)
+        {
+            return 1;
+        }
+        return 1 / (1 - std::exp (-(double)size / m_sampleInterval));
+    }
+
+private:
+    std::size_t                                 m_sampleInterval;
+    std::uint64_t                               m_random;
+    std::size_t                                 m_bytesUntilSample;
+    std::vector<Stack>                          m_stacks;
+    std::map<std::vector<void*>, std::size_t>   m_stackIndex;
+    std::unordered_map<void*, LiveSample>       m_live;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_SAMPLING_MEM_LOGGER_H
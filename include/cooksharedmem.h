@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_SHARED_MEM_H
+#define COOK_SHARED_MEM_H
+
+#ifndef WIN32
+
+#include <cerrno>
+#include <new>
+#include <type_traits>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "cookfilemmaparena.h"
+#include "cookmemlogger.h"
+#include "cookmempool.h"
+
+namespace cookmem
+{
+
+/**
+ * A memory arena backed by a shared memory object.
+ *
+ * The shared memory object is either a named POSIX shared memory object,
+ * which can be opened by unrelated processes, or an anonymous memfd, which
+ * is shared with the child processes.  In either case, the region is mapped
+ * at the same address in every process, so pointers stored in the region
+ * are valid in all of them.
+ */
+class SharedMemArena : public FileMmapArena
+{
+public:
+    /**
+     * The number of milliseconds a process waits for the creator of a
+     * named region to initialize it.
+     */
+    static const int OPEN_TIMEOUT_MS = 10000;
+
+    /**
+     * Constructor.
+     *
+     * Exactly one process creates the named shared memory object and
+     * initializes the region.  The other processes, including those started
+     * at the same time, wait until the region is initialized and then
+     * attach to it.
+     *
+     * @param   name
+     *          the name of the POSIX shared memory object, such as
+     *          "/myregion".  nullptr creates an anonymous memfd instead.
+     * @param   base
+     *          the fixed base address to map the region.  It needs to be
+     *          page aligned.  For a memfd, it can be nullptr since the
+     *          child processes inherit the mapping.
+     * @param   capacity
+     *          the size of the region.
+     */
+    SharedMemArena (const char* name, void* base, std::size_t capacity)
+    : FileMmapArena (),
+      m_creator (false)
+    {
+        if (name == nullptr)
+        {
+#ifdef SYS_memfd_create
+            m_creator = true;
+            map ((int)syscall (SYS_memfd_create, "cookmem", 0), base, capacity);
+#endif
+            return;
+        }
+
+        int fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+        {
+            m_creator = true;
+            map (fd, base, capacity);
+            return;
+        }
+        if (errno != EEXIST)
+        {
+            return;
+        }
+
+        // Another process created the object.  Wait until it has sized
+        // the object and published the region header.
+        for (int i = 0; i < OPEN_TIMEOUT_MS; ++i)
+        {
+            fd = shm_open (name, O_RDWR, 0);
+            if (fd < 0)
+            {
+                return;
+            }
+            struct stat st;
+            if (fstat (fd, &st) == 0 && st.st_size > 0)
+            {
+                map (fd, base, capacity);
+                if (isOpen ())
+                {
+                    return;
+                }
+            }
+            else
+            {
+                ::close (fd);
+            }
+            usleep (1000);
+        }
+    }
+
+    /**
+     * Check if this process created the shared memory object, and is thus
+     * responsible for initializing the shared states in it.
+     *
+     * @return  true if this process created the shared memory object.
+     */
+    bool
+    isCreator () const
+    {
+        return m_creator;
+    }
+
+    /**
+     * Remove a named shared memory object.  Processes that have the region
+     * mapped can continue to use it.
+     *
+     * @param   name
+     *          the name of the POSIX shared memory object.
+     * @return  true if there is an error.  false is okay.
+     */
+    static bool
+    unlink (const char* name)
+    {
+        return shm_unlink (name) != 0;
+    }
+
+private:
+    bool    m_creator;
+};
+
+/**
+ * A memory pool that can be used by several processes at the same time.
+ *
+ * All the states of the memory pool, including a process-shared robust
+ * mutex, live inside the shared region.  This class is merely a process
+ * local handle, so each process creates its own SharedMemPool on the same
+ * SharedMemArena.
+ *
+ * The SharedMemPool created by the process that created the region
+ * initializes the shared states and publishes them through the region
+ * root pointer.  The SharedMemPool of any other process waits up to
+ * SharedMemArena::OPEN_TIMEOUT_MS for them to be published.  For an
+ * anonymous region, the SharedMemPool should be created before the
+ * child processes are forked.  Once a SharedMemPool is created, the arena
+ * should not be used directly anymore.
+ *
+ * If a process dies while holding the lock, the next process acquiring the
+ * lock reports MEM_ERROR_OWNER_DEAD through the logger since the pool may
+ * be in an inconsistent state.
+ *
+ * The logger lives in the shared region along with the pool, so it cannot
+ * be polymorphic, such as a class derived from MemLogger.  Its virtual
+ * table pointer would only be valid in the process that created it.
+ */
+template<class Logger = NoActionMemLogger, class T = void>
+class SharedMemPool
+{
+public:
+    typedef MemPool<RegionArena, Logger, T> Pool;
+
+    static_assert (!std::is_polymorphic<Logger>::value, "the logger of a SharedMemPool is shared by all the processes and cannot have virtual functions.");
+
+    /** size type */
+    typedef typename Pool::size_type        size_type;
+    /** pointer difference type */
+    typedef typename Pool::difference_type  difference_type;
+    /** value type */
+    typedef typename Pool::value_type       value_type;
+    /** pointer type */
+    typedef typename Pool::pointer          pointer;
+    /** const pointer type */
+    typedef typename Pool::const_pointer    const_pointer;
+
+private:
+    /**
+     * The shared states stored in the region.
+     */
+    struct Control
+    {
+        pthread_mutex_t mutex;
+        RegionArena     arena;
+        Logger          logger;
+        Pool            pool;
+        void*           root;
+        std::size_t     size;
+
+        Control (const RegionArena& region, std::size_t segSize)
+        : arena (region),
+          logger (),
+          pool (arena, logger),
+          root (nullptr),
+          size (segSize)
+        {
+        }
+    };
+
+    /**
+     * Internal lock guard.
+     */
+    class Lock
+    {
+    public:
+        Lock (Control* control)
+        : m_control (control),
+          m_ownerDead (false)
+        {
+            int ret = pthread_mutex_lock (&m_control->mutex);
+            if (ret == EOWNERDEAD)
+            {
+                pthread_mutex_consistent (&m_control->mutex);
+                m_ownerDead = true;
+            }
+            else if (ret != 0)
+            {
+                throw Exception (MEM_ERROR_GENERAL, "unable to lock the shared memory pool.");
+            }
+        }
+
+        ~Lock ()
+        {
+            pthread_mutex_unlock (&m_control->mutex);
+        }
+
+        bool
+        isOwnerDead () const
+        {
+            return m_ownerDead;
+        }
+
+    private:
+        Control*    m_control;
+        bool        m_ownerDead;
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   arena
+     *          the shared memory arena.
+     */
+    SharedMemPool (SharedMemArena& arena)
+    : m_arena (arena),
+      m_control ((Control*)arena.getRoot ())
+    {
+        if (m_control || !arena.isOpen ())
+        {
+            return;
+        }
+        if (!arena.isCreator ())
+        {
+            // wait for the creator to publish the shared states
+            for (int i = 0; i < SharedMemArena::OPEN_TIMEOUT_MS && m_control == nullptr; ++i)
+            {
+                usleep (1000);
+                m_control = (Control*)arena.getRoot ();
+            }
+            return;
+        }
+
+        size_type size = sizeof(Control);
+        void* ptr = arena.getSegment (size);
+        if (ptr == nullptr)
+        {
+            return;
+        }
+
+        Control* control = new (ptr) Control (arena.getRegion (), size);
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init (&attr);
+        pthread_mutexattr_setpshared (&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust (&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init (&control->mutex, &attr);
+        pthread_mutexattr_destroy (&attr);
+
+        // publish the shared states to the other processes
+        arena.setRoot (control);
+        m_control = control;
+    }
+
+    /**
+     * Check if the shared states are available.
+     *
+     * @return  true if the pool can be used.  false otherwise.
+     */
+    bool
+    isValid () const
+    {
+        return m_control != nullptr;
+    }
+
+    /**
+     * Allocate memory from the shared memory pool.
+     *
+     * @param   size
+     *          memory request size.
+     * @return  the memory region that is at least the request size.
+     *          nullptr if the request cannot be satisfied.
+     */
+    T*
+    allocate (size_type size)
+    {
+        if (m_control == nullptr)
+        {
+            return nullptr;
+        }
+        Lock lock (m_control);
+        checkLock (lock);
+        return m_control->pool.allocate (size);
+    }
+
+    /**
+     * This function reallocate a memory.
+     *
+     * @param   ptr
+     *          the current memory pointer.
+     * @param   size
+     *          the new size
+     * @return  the reallocated pointer.  If the new size cannot be
+     *          satisfied, a nullptr is returned and the old pointer
+     *          remains valid.
+     */
+    T*
+    reallocate (T* ptr, size_type size)
+    {
+        if (m_control == nullptr)
+        {
+            return nullptr;
+        }
+        Lock lock (m_control);
+        checkLock (lock);
+        return m_control->pool.reallocate (ptr, size);
+    }
+
+    /**
+     * Allocate n items of certain size.  The memory allocated is zeroed.
+     *
+     * @param   num
+     *          number of elements
+     * @param   size
+     *          element size
+     * @return  memory allocated.
+     */
+    T*
+    callocate (size_type num, size_type size)
+    {
+        if (m_control == nullptr)
+        {
+            return nullptr;
+        }
+        Lock lock (m_control);
+        checkLock (lock);
+        return m_control->pool.callocate (num, size);
+    }
+
+    /**
+     * Free a piece of memory previously allocated by any process from this
+     * shared memory pool.
+     *
+     * @param   ptr
+     *          a piece of memory to be freed.
+     * @param   size
+     *          mostly ignored.  It is only used by the memory logger.
+     */
+    void
+    deallocate (T* ptr, size_type size = 0)
+    {
+        if (m_control == nullptr)
+        {
+            return;
+        }
+        Lock lock (m_control);
+        checkLock (lock);
+        m_control->pool.deallocate (ptr, size);
+    }
+
+    /**
+     * Check if a pointer is within the address space of segments owned
+     * by this memory pool.
+     *
+     * @param   ptr
+     *          memory pointer
+     * @param   checkUsed
+     *          check the pointer if it is used.
+     * @return  whether the memory address is in the space of segments owned
+     *          by this memory pool.
+     */
+    bool
+    contains (T* ptr, bool checkUsed = false)
+    {
+        if (m_control == nullptr)
+        {
+            return false;
+        }
+        Lock lock (m_control);
+        checkLock (lock);
+        return m_control->pool.contains (ptr, checkUsed);
+    }
+
+    /**
+     * Get the current memory footprint.
+     *
+     * @return  the current memory footprint.
+     */
+    size_type
+    getFootprint ()
+    {
+        if (m_control == nullptr)
+        {
+            return 0;
+        }
+        Lock lock (m_control);
+        return m_control->pool.getFootprint ();
+    }
+
+    /**
+     * Get the user data root pointer shared by all the processes.
+     *
+     * @return  the root pointer.
+     */
+    void*
+    getRoot () const
+    {
+        return m_control ? m_control->root : nullptr;
+    }
+
+    /**
+     * Set the user data root pointer shared by all the processes.
+     *
+     * @param   root
+     *          the root pointer.
+     */
+    void
+    setRoot (void* root)
+    {
+        if (m_control)
+        {
+            m_control->root = root;
+        }
+    }
+
+    /**
+     * Release all the memory and the shared states.  This should only be
+     * called by the last process using the pool.
+     */
+    void
+    destroy ()
+    {
+        if (m_control == nullptr)
+        {
+            return;
+        }
+        m_control->pool.releaseAll ();
+        pthread_mutex_destroy (&m_control->mutex);
+        std::size_t size = m_control->size;
+        m_control->~Control ();
+        m_arena.freeSegment (m_control, size);
+        m_arena.setRoot (nullptr);
+        m_control = nullptr;
+    }
+
+private:
+    inline void
+    checkLock (const Lock& lock)
+    {
+        if (lock.isOwnerDead ())
+        {
+            m_control->logger.logError (nullptr, MEM_ERROR_OWNER_DEAD);
+        }
+    }
+
+private:
+    SharedMemArena& m_arena;
+    Control*        m_control;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_SHARED_MEM_H
@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_SPILL_H
+#define COOK_SPILL_H
+
+#ifndef WIN32
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+namespace cookmem
+{
+
+typedef enum
+{
+    SPILL_FILE,         // write the segments to a temporary file
+    SPILL_PAGEOUT       // ask the kernel to page out the segments in place
+}  SpillMode_et;
+
+class MmapArena;
+class BatchMmapArena;
+template<class Arena> class CachedArena;
+template<class Arena> class BucketCachedArena;
+
+/**
+ * Check if the segments of an arena are plain private anonymous mappings,
+ * which SPILL_FILE can recreate without losing any property.  Arenas that
+ * lock, bind, back with huge pages or back with files their segments are
+ * not.
+ */
+template<class Arena>
+struct ArenaIsSpillable
+{
+    static const bool value = false;
+};
+
+template<>
+struct ArenaIsSpillable<MmapArena>
+{
+    static const bool value = true;
+};
+
+template<>
+struct ArenaIsSpillable<BatchMmapArena>
+{
+    static const bool value = true;
+};
+
+template<class Arena>
+struct ArenaIsSpillable<CachedArena<Arena> > : public ArenaIsSpillable<Arena>
+{
+};
+
+template<class Arena>
+struct ArenaIsSpillable<BucketCachedArena<Arena> > : public ArenaIsSpillable<Arena>
+{
+};
+
+/**
+ * MemSpill evicts all the memory segments of a MemPool out of the memory
+ * without walking the objects inside, and later restores them at the same
+ * addresses, so the pointers stored in the memory remain valid.
+ *
+ * With SPILL_FILE, the segments are written to an unlinked temporary file,
+ * and their address ranges are replaced with inaccessible reservations
+ * such that no other mapping can take the addresses.  On restore, the
+ * segments are mapped again as plain private anonymous memory.  So this
+ * mode only accepts the pools whose arena is listed by ArenaIsSpillable,
+ * which are MmapArena and BatchMmapArena, possibly behind CachedArena or
+ * BucketCachedArena.  MmapArena needs to use its default flags.  Any other
+ * arena is refused, since its segments would lose their locking, NUMA
+ * binding or file backing.
+ *
+ * With SPILL_PAGEOUT, the segments are left in place and the kernel is
+ * asked to reclaim the pages with MADV_PAGEOUT.  This mode suits file
+ * backed arenas such as FileMmapArena, where the pages are written back to
+ * the file.
+ *
+ * The MemPool must not be used while it is evicted.  One MemSpill holds at
+ * most one evicted MemPool at a time, and only restores that MemPool.
+ */
+class MemSpill
+{
+private:
+    /**
+     * Internal segment record.
+     */
+    struct Entry
+    {
+        void*       ptr;
+        std::size_t size;
+    };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   mode
+     *          the spill mode.
+     * @param   dir
+     *          the directory for the temporary file.  nullptr uses TMPDIR
+     *          or /tmp.
+     */
+    MemSpill (SpillMode_et mode = SPILL_FILE, const char* dir = nullptr)
+    : m_mode (mode),
+      m_dir (dir),
+      m_fd (-1),
+      m_pool (nullptr),
+      m_entries (nullptr),
+      m_numEntries (0),
+      m_spilledSize (0)
+    {
+    }
+
+    /**
+     * Destructor.
+     *
+     * An evicted MemPool should be restored before the destructor is called.
+     */
+    ~MemSpill ()
+    {
+        if (m_fd >= 0)
+        {
+            close (m_fd);
+        }
+        delete[] m_entries;
+    }
+
+    /**
+     * Evict all the memory segments of a MemPool.
+     *
+     * @param   pool
+     *          the memory pool, such as the one obtained from
+     *          MemContext::getPool ().
+     * @return  true if there is an error, such as the arena cannot be used
+     *          with SPILL_FILE.  false is okay.  On error, the segments
+     *          that have been evicted are restored.
+     */
+    template<class Pool>
+    bool
+    evict (Pool& pool)
+    {
+        if (m_entries)
+        {
+            return true;
+        }
+        if (m_mode == SPILL_FILE && !ArenaIsSpillable<typename Pool::arena_type>::value)
+        {
+            return true;
+        }
+
+        const std::size_t pageMask = (std::size_t)sysconf (_SC_PAGESIZE) - 1;
+
+        std::size_t size;
+        std::size_t count = 0;
+        for (void* seg = pool.nextSegment (nullptr, size); seg; seg = pool.nextSegment (seg, size))
+        {
+            if ((std::size_t)seg & pageMask)
+            {
+                return true;
+            }
+            ++count;
+        }
+        if (count == 0)
+        {
+            return false;
+        }
+
+        m_entries = new (std::nothrow) Entry[count];
+        if (m_entries == nullptr)
+        {
+            return true;
+        }
+        m_numEntries = 0;
+        m_spilledSize = 0;
+        for (void* seg = pool.nextSegment (nullptr, size); seg; seg = pool.nextSegment (seg, size))
+        {
+            m_entries[m_numEntries].ptr = seg;
+            m_entries[m_numEntries].size = (size + pageMask) & ~pageMask;
+            ++m_numEntries;
+        }
+        m_pool = &pool;
+
+        if (m_mode == SPILL_PAGEOUT)
+        {
+            for (std::size_t i = 0; i < m_numEntries; ++i)
+            {
+                if (madvise (m_entries[i].ptr, m_entries[i].size, MADV_PAGEOUT) != 0)
+                {
+                    clear ();
+                    return true;
+                }
+                m_spilledSize += m_entries[i].size;
+            }
+            return false;
+        }
+
+        if (m_fd < 0 && openTempFile ())
+        {
+            clear ();
+            return true;
+        }
+
+        off_t offset = 0;
+        for (std::size_t i = 0; i < m_numEntries; ++i)
+        {
+            Entry& entry = m_entries[i];
+            if (writeFully (entry.ptr, entry.size, offset) ||
+                mmap (entry.ptr, entry.size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED)
+            {
+                // undo the segments already evicted
+                m_numEntries = i;
+                restoreSegments ();
+                clear ();
+                return true;
+            }
+            offset += entry.size;
+            m_spilledSize += entry.size;
+        }
+        return false;
+    }
+
+    /**
+     * Restore the memory segments of the MemPool previously evicted.
+     *
+     * @param   pool
+     *          the memory pool previously evicted.
+     * @return  true if there is an error, such as the pool is not the one
+     *          evicted.  false is okay.
+     */
+    template<class Pool>
+    bool
+    restore (Pool& pool)
+    {
+        if (m_entries == nullptr)
+        {
+            return false;
+        }
+        if (m_pool != (const void*)&pool)
+        {
+            return true;
+        }
+        bool error = false;
+        if (m_mode == SPILL_PAGEOUT)
+        {
+            for (std::size_t i = 0; i < m_numEntries; ++i)
+            {
+                madvise (m_entries[i].ptr, m_entries[i].size, MADV_WILLNEED);
+            }
+        }
+        else
+        {
+            error = restoreSegments ();
+        }
+        clear ();
+        return error;
+    }
+
+    /**
+     * Check if a MemPool is currently evicted.
+     *
+     * @return  true if a MemPool is evicted.
+     */
+    bool
+    isEvicted () const
+    {
+        return m_entries != nullptr;
+    }
+
+    /**
+     * Get the number of bytes evicted.
+     *
+     * @return  the number of bytes evicted.
+     */
+    std::size_t
+    getSpilledSize () const
+    {
+        return m_spilledSize;
+    }
+
+private:
+    MemSpill (const MemSpill&) = delete;
+    MemSpill& operator= (const MemSpill&) = delete;
+
+    bool
+    openTempFile ()
+    {
+        const char* dir = m_dir;
+        if (dir == nullptr)
+        {
+            dir = getenv ("TMPDIR");
+        }
+        if (dir == nullptr)
+        {
+            dir = "/tmp";
+        }
+        char path[4096];
+        if (snprintf (path, sizeof(path), "%s/cookmem_spill_XXXXXX", dir) >= (int)sizeof(path))
+        {
+            return true;
+        }
+        m_fd = mkstemp (path);
+        if (m_fd < 0)
+        {
+            return true;
+        }
+        unlink (path);
+        return false;
+    }
+
+    bool
+    writeFully (const void* ptr, std::size_t size, off_t offset)
+    {
+        const char* p = (const char*)ptr;
+        while (size > 0)
+        {
+            ssize_t n = pwrite (m_fd, p, size, offset);
+            if (n <= 0)
+            {
+                return true;
+            }
+            p += n;
+            size -= n;
+            offset += n;
+        }
+        return false;
+    }
+
+    bool
+    readFully (void* ptr, std::size_t size, off_t offset)
+    {
+        char* p = (char*)ptr;
+        while (size > 0)
+        {
+            ssize_t n = pread (m_fd, p, size, offset);
+            if (n <= 0)
+            {
+                return true;
+            }
+            p += n;
+            size -= n;
+            offset += n;
+        }
+        return false;
+    }
+
+    bool
+    restoreSegments ()
+    {
+        bool error = false;
+        off_t offset = 0;
+        for (std::size_t i = 0; i < m_numEntries; ++i)
+        {
+            Entry& entry = m_entries[i];
+            if (mmap (entry.ptr, entry.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED ||
+                readFully (entry.ptr, entry.size, offset))
+            {
+                error = true;
+            }
+            offset += entry.size;
+        }
+        // release the disk space
+        if (ftruncate (m_fd, 0) != 0)
+        {
+            error = true;
+        }
+        return error;
+    }
+
+    void
+    clear ()
+    {
+        delete[] m_entries;
+        m_entries = nullptr;
+        m_pool = nullptr;
+        m_numEntries = 0;
+        m_spilledSize = 0;
+    }
+
+private:
+    SpillMode_et    m_mode;
+    const char*     m_dir;
+    int             m_fd;
+    const void*     m_pool;
+    Entry*          m_entries;
+    std::size_t     m_numEntries;
+    std::size_t     m_spilledSize;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_SPILL_H
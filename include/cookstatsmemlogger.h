@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_STATS_MEM_LOGGER_H
+#define COOK_STATS_MEM_LOGGER_H
+
+#include <cstddef>
+#include <cstring>
+
+#include "cookmemlogger.h"
+
+namespace cookmem
+{
+
+/**
+ * The counters of a size class.
+ */
+struct SizeClassStats
+{
+    /** the number of allocations */
+    std::size_t numAllocs;
+    /** the number of deallocations */
+    std::size_t numFrees;
+    /** the number of bytes currently allocated */
+    std::size_t liveBytes;
+    /** the maximum number of bytes allocated at the same time */
+    std::size_t peakBytes;
+};
+
+/**
+ * A snapshot of the statistics collected by StatsMemLogger.
+ *
+ * Size class i holds the requests of size (2^(i+3), 2^(i+4)], except
+ * that class 0 holds all the requests up to 16 bytes.
+ *
+ * The histogram is finer.  Each power of two range of the size classes is
+ * further split into 4 buckets of equal width.
+ */
+struct MemStats
+{
+    static const int NUM_SIZE_CLASSES = 48;
+    static const int NUM_SUB_BUCKETS = 4;
+    static const int NUM_HISTOGRAM_BUCKETS = NUM_SIZE_CLASSES * NUM_SUB_BUCKETS;
+
+    /** the number of allocations */
+    std::size_t     numAllocs;
+    /** the number of failed allocations */
+    std::size_t     numFailures;
+    /** the number of reallocations done in place */
+    std::size_t     numReallocs;
+    /** the number of deallocations */
+    std::size_t     numFrees;
+    /** the number of bytes currently allocated */
+    std::size_t     liveBytes;
+    /** the maximum number of bytes allocated at the same time */
+    std::size_t     peakBytes;
+
+    /** the number of segments obtained from the arena */
+    std::size_t     numGetSegments;
+    /** the number of segments released to the arena */
+    std::size_t     numFreeSegments;
+    /** the number of bytes in the segments currently held */
+    std::size_t     segmentBytes;
+    /** the maximum number of bytes in the segments held */
+    std::size_t     peakSegmentBytes;
+
+    /** the counters per size class */
+    SizeClassStats  sizeClasses[NUM_SIZE_CLASSES];
+    /** the request size histogram */
+    std::size_t     histogram[NUM_HISTOGRAM_BUCKETS];
+
+    /**
+     * Get the size class of a request size.
+     *
+     * @param   size
+     *          the request size.
+     * @return  the size class.
+     */
+    static int
+    getSizeClass (std::size_t size)
+    {
+        if (size <= 16)
+        {
+            return 0;
+        }
+        int c = getHighBit (size - 1) - 3;
+        return c < NUM_SIZE_CLASSES ? c : NUM_SIZE_CLASSES - 1;
+    }
+
+    /**
+     * Get the largest request size of a size class.
+     *
+     * @param   sizeClass
+     *          the size class.
+     * @return  the largest request size of the size class.
+     */
+    static std::size_t
+    getSizeClassLimit (int sizeClass)
+    {
+        return ((std::size_t)16) << sizeClass;
+    }
+
+    /**
+     * Get the histogram bucket of a request size.
+     *
+     * @param   size
+     *          the request size.
+     * @return  the histogram bucket.
+     */
+    static int
+    getHistogramBucket (std::size_t size)
+    {
+        if (size <= 16)
+        {
+            // 4 byte steps
+            return size == 0 ? 0 : (int)((size - 1) >> 2);
+        }
+        int c = getSizeClass (size);
+        if (c == NUM_SIZE_CLASSES - 1 && size > getSizeClassLimit (c))
+        {
+            return NUM_HISTOGRAM_BUCKETS - 1;
+        }
+        std::size_t low = getSizeClassLimit (c) >> 1;
+        int sub = (int)(((size - 1 - low) * NUM_SUB_BUCKETS) / low);
+        return c * NUM_SUB_BUCKETS + sub;
+    }
+
+    /**
+     * Get the largest request size of a histogram bucket.
+     *
+     * @param   bucket
+     *          the histogram bucket.
+     * @return  the largest request size of the bucket.
+     */
+    static std::size_t
+    getHistogramBucketLimit (int bucket)
+    {
+        int c = bucket / NUM_SUB_BUCKETS;
+        int sub = bucket % NUM_SUB_BUCKETS;
+        if (c == 0)
+        {
+            return (std::size_t)(sub + 1) * 4;
+        }
+        std::size_t low = getSizeClassLimit (c) >> 1;
+        return low + (low / NUM_SUB_BUCKETS) * (sub + 1);
+    }
+
+private:
+    static int
+    getHighBit (std::size_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return (int)(sizeof(unsigned long long) * 8 - 1) - __builtin_clzll ((unsigned long long)v);
+#else
+        int bit = 0;
+        while (v >>= 1)
+        {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+};
+
+/**
+ * A MemLogger that collects the allocation statistics.
+ *
+ * All the counters are plain integers, since a memory context is only
+ * used by one thread at a time.  The overhead is a few additions per
+ * call, so it is suitable for production use.
+ *
+ * The allocation counts and the histogram use the requested sizes.  The
+ * byte counts use the usable sizes reported by logUsableSize (), which
+ * are the sizes reported again on deallocation.  When MemPool does not
+ * store the exact size, the usable size is that of the whole chunk, which
+ * can be larger than the requested size, for example when a free chunk is
+ * reused without being split.  The live byte counts are thus the memory
+ * held by the user rather than the memory requested.
+ *
+ * Memory corruptions are reported the same way as NoActionMemLogger.
+ */
+class StatsMemLogger
+{
+public:
+    StatsMemLogger ()
+    {
+        memset (&m_stats, 0, sizeof(m_stats));
+    }
+
+    inline void
+    logGetSegment (void* segment, std::size_t segmentSize)
+    {
+        if (segment == nullptr)
+        {
+            return;
+        }
+        ++m_stats.numGetSegments;
+        if ((m_stats.segmentBytes += segmentSize) > m_stats.peakSegmentBytes)
+        {
+            m_stats.peakSegmentBytes = m_stats.segmentBytes;
+        }
+    }
+
+    inline void
+    logFreeSegment (void* segment, std::size_t segmentSize)
+    {
+        ++m_stats.numFreeSegments;
+        m_stats.segmentBytes -= segmentSize;
+    }
+
+    inline void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        if (userPtr == nullptr)
+        {
+            ++m_stats.numFailures;
+            return;
+        }
+        ++m_stats.numAllocs;
+        ++m_stats.histogram[MemStats::getHistogramBucket (userSize)];
+        SizeClassStats& sc = m_stats.sizeClasses[MemStats::getSizeClass (userSize)];
+        ++sc.numAllocs;
+    }
+
+    inline void
+    logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        ++m_stats.numReallocs;
+    }
+
+    inline void
+    logUsableSize (void* userPtr, std::size_t oldUsableSize, std::size_t newUsableSize)
+    {
+        if (oldUsableSize != 0)
+        {
+            remove (m_stats.sizeClasses[MemStats::getSizeClass (oldUsableSize)], oldUsableSize);
+        }
+        add (m_stats.sizeClasses[MemStats::getSizeClass (newUsableSize)], newUsableSize);
+    }
+
+    inline void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        if (userPtr == nullptr)
+        {
+            return;
+        }
+        ++m_stats.numFrees;
+        SizeClassStats& sc = m_stats.sizeClasses[MemStats::getSizeClass (userSize)];
+        ++sc.numFrees;
+        remove (sc, userSize);
+    }
+
+    inline void
+    logError (void* userPtr, MemError_et error)
+    {
+        throw Exception (error, "memory corruption detected.");
+    }
+
+    /**
+     * Get the current statistics.
+     *
+     * @return  the current statistics.
+     */
+    const MemStats&
+    getStats () const
+    {
+        return m_stats;
+    }
+
+    /**
+     * Copy the current statistics.
+     *
+     * @param [out] stats
+     *          the statistics copied.
+     */
+    void
+    snapshot (MemStats& stats) const
+    {
+        stats = m_stats;
+    }
+
+    /**
+     * Reset the counters and the histogram.  The live byte counts are kept
+     * since the memory allocated is still there, and the peaks start over
+     * from the current live byte counts.
+     */
+    void
+    reset ()
+    {
+        MemStats stats;
+        memset (&stats, 0, sizeof(stats));
+        stats.liveBytes = stats.peakBytes = m_stats.liveBytes;
+        stats.segmentBytes = stats.peakSegmentBytes = m_stats.segmentBytes;
+        for (int i = 0; i < MemStats::NUM_SIZE_CLASSES; ++i)
+        {
+            stats.sizeClasses[i].liveBytes = stats.sizeClasses[i].peakBytes = m_stats.sizeClasses[i].liveBytes;
+        }
+        m_stats = stats;
+    }
+
+private:
+    inline void
+    add (SizeClassStats& sc, std::size_t size)
+    {
+        if ((sc.liveBytes += size) > sc.peakBytes)
+        {
+            sc.peakBytes = sc.liveBytes;
+        }
+        if ((m_stats.liveBytes += size) > m_stats.peakBytes)
+        {
+            m_stats.peakBytes = m_stats.liveBytes;
+        }
+    }
+
+    inline void
+    remove (SizeClassStats& sc, std::size_t size)
+    {
+        sc.liveBytes -= size;
+        m_stats.liveBytes -= size;
+    }
+
+private:
+    MemStats    m_stats;
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_STATS_MEM_LOGGER_H
@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_STATS_REGISTRY_H
+#define COOK_STATS_REGISTRY_H
+
+#ifndef WIN32
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cookmemarena.h"
+
+namespace cookmem
+{
+
+typedef enum
+{
+    STATS_READ_OK,          // the entry was copied
+    STATS_READ_UNUSED,      // the entry is not registered
+    STATS_READ_BUSY,        // the entry stayed locked by the writer
+}  StatsRead_et;
+
+/**
+ * A copy of the statistics of a named memory context read from a stats
+ * page.
+ */
+struct StatsSnapshot
+{
+    /** the name of the memory context */
+    char            name[48];
+    /** the time of the last update in nanoseconds since the epoch */
+    std::uint64_t   updateTime;
+    /** the number of updates so far */
+    std::uint64_t   numUpdates;
+    /** the current memory footprint */
+    std::uint64_t   footprint;
+    /** the maximum memory footprint */
+    std::uint64_t   maxFootprint;
+    /** the bytes allocated by the user */
+    std::uint64_t   liveBytes;
+    /** the bytes in the free chunks */
+    std::uint64_t   freeBytes;
+    /** the number of allocations live */
+    std::uint64_t   numAllocations;
+    /** the number of segments, including the direct segments */
+    std::uint64_t   numSegments;
+    /** the number of direct segments */
+    std::uint64_t   numDirectSegments;
+    /** the number of segment requests satisfied by the arena cache */
+    std::uint64_t   cacheHits;
+    /** the number of segment requests passed through the arena cache */
+    std::uint64_t   cacheMisses;
+    /** the bytes held by the arena cache */
+    std::uint64_t   cachedBytes;
+};
+
+/**
+ * The layout of the shared memory page.
+ *
+ * Each entry is protected by its own sequence lock.  The writer makes the
+ * sequence odd, updates the values, then makes it even again.  A reader
+ * retries if the sequence is odd or changed while it was copying.  Thus
+ * the writer never waits for the readers.  The retries are bounded, so a
+ * writer that died in the middle of an update does not hang the readers.
+ */
+struct StatsPage
+{
+    static const std::uint64_t  MAGIC = 0x315453544b4f4f43ULL;  // "COOKTST1"
+    static const int            MAX_ENTRIES = 64;
+    static const int            NUM_VALUES = 12;
+    static const int            MAX_READ_RETRIES = 1000;
+
+    struct Entry
+    {
+        /** odd while the entry is being written */
+        std::atomic<std::uint32_t>  seq;
+        /** 1 if the entry is registered, 2 while it is being registered */
+        std::atomic<std::uint32_t>  used;
+        char                        name[48];
+        /** the values in the order of StatsSnapshot, after the name */
+        std::atomic<std::uint64_t>  values[NUM_VALUES];
+    };
+
+    std::uint64_t   magic;
+    std::uint64_t   pid;
+    Entry           entries[MAX_ENTRIES];
+
+    /**
+     * Copy an entry consistently.
+     *
+     * @param   index
+     *          the entry index.
+     * @param [out] snapshot
+     *          the copy of the entry.
+     * @return  STATS_READ_OK if the entry was copied.  STATS_READ_UNUSED
+     *          if the entry is not registered.  STATS_READ_BUSY if the
+     *          entry was still being written after all the retries, or
+     *          was left locked by a writer that died.
+     */
+    StatsRead_et
+    read (int index, StatsSnapshot& snapshot) const
+    {
+        const Entry& entry = entries[index];
+        for (int retry = 0; retry < MAX_READ_RETRIES; ++retry)
+        {
+            std::uint32_t seq = entry.seq.load (std::memory_order_acquire);
+            if (seq & 1)
+            {
+                sched_yield ();
+                continue;
+            }
+            if (entry.used.load (std::memory_order_relaxed) != 1)
+            {
+                return STATS_READ_UNUSED;
+            }
+            memcpy (snapshot.name, entry.name, sizeof(snapshot.name));
+            snapshot.name[sizeof(snapshot.name) - 1] = 0;
+            std::uint64_t* values = &snapshot.updateTime;
+            for (int i = 0; i < NUM_VALUES; ++i)
+            {
+                values[i] = entry.values[i].load (std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence (std::memory_order_acquire);
+            if (entry.seq.load (std::memory_order_relaxed) == seq)
+            {
+                return STATS_READ_OK;
+            }
+        }
+        return STATS_READ_BUSY;
+    }
+
+    /**
+     * Write the statistics of all the registered entries in the Prometheus
+     * text exposition format.  The busy entries are skipped.
+     *
+     * @param   file
+     *          the output file.
+     */
+    void
+    writePrometheus (FILE* file) const
+    {
+        static const char* const names[NUM_VALUES] =
+        {
+            "update_time_seconds",
+            "updates_total",
+            "footprint_bytes",
+            "max_footprint_bytes",
+            "live_bytes",
+            "free_bytes",
+            "allocations",
+            "segments",
+            "direct_segments",
+            "cache_hits_total",
+            "cache_misses_total",
+            "cached_bytes"
+        };
+        StatsSnapshot snapshots[MAX_ENTRIES];
+        bool used[MAX_ENTRIES];
+        for (int i = 0; i < MAX_ENTRIES; ++i)
+        {
+            used[i] = read (i, snapshots[i]) == STATS_READ_OK;
+        }
+        for (int v = 0; v < NUM_VALUES; ++v)
+        {
+            const char* name = names[v];
+            bool counter = strstr (name, "_total") != nullptr;
+            fprintf (file, "# TYPE cookmem_%s %s\n", name, counter ? "counter" : "gauge");
+            for (int i = 0; i < MAX_ENTRIES; ++i)
+            {
+                if (!used[i])
+                {
+                    continue;
+                }
+                const std::uint64_t* values = &snapshots[i].updateTime;
+                if (v == 0)
+                {
+                    fprintf (file, "cookmem_%s{pid=\"%llu\",context=\"%s\"} %.3f\n", name, (unsigned long long)pid, snapshots[i].name, values[v] / 1e9);
+                }
+                else
+                {
+                    fprintf (file, "cookmem_%s{pid=\"%llu\",context=\"%s\"} %llu\n", name, (unsigned long long)pid, snapshots[i].name, (unsigned long long)values[v]);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * An opt-in registry that publishes the statistics of named memory
+ * contexts into a POSIX shared memory page, so that a separate process
+ * such as cookmem_top can watch a running process.
+ *
+ * The allocation path is not touched.  The thread owning a memory context
+ * calls update () whenever it is convenient, such as at the end of a
+ * request or every so many allocations.  update () only reads counters
+ * MemPool already maintains and never blocks, since the page uses one
+ * sequence lock per entry.  Different contexts can be updated from
+ * different threads, but each entry should only be updated by one thread
+ * at a time.
+ *
+ * The page is named "/cookmem.<pid>" by default and is removed when the
+ * registry is destroyed.  The page is not created if the name is already
+ * in use, so that the page of a live process is never overwritten.  A page
+ * left behind by a process that crashed can be removed with shm_unlink.
+ */
+class StatsRegistry
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param   name
+     *          the name of the POSIX shared memory object.  nullptr uses
+     *          the default name "/cookmem.<pid>".
+     */
+    StatsRegistry (const char* name = nullptr)
+    : m_page (nullptr)
+    {
+        if (name)
+        {
+            snprintf (m_name, sizeof(m_name), "%s", name);
+        }
+        else
+        {
+            getDefaultName (getpid (), m_name, sizeof(m_name));
+        }
+
+        int fd = shm_open (m_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            // the name is in use, or the page cannot be created.
+            return;
+        }
+        if (ftruncate (fd, sizeof(StatsPage)) == 0)
+        {
+            void* ptr = mmap (nullptr, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED)
+            {
+                // the new object is zero filled, so all the entries are unused
+                m_page = (StatsPage*)ptr;
+                m_page->pid = (std::uint64_t)getpid ();
+                m_page->magic = StatsPage::MAGIC;
+            }
+        }
+        close (fd);
+        if (m_page == nullptr)
+        {
+            shm_unlink (m_name);
+        }
+    }
+
+    /**
+     * Destructor.  The shared memory page is removed.
+     */
+    ~StatsRegistry ()
+    {
+        if (m_page)
+        {
+            munmap (m_page, sizeof(StatsPage));
+            shm_unlink (m_name);
+        }
+    }
+
+    /**
+     * Get the default name of the page of a process.
+     *
+     * @param   pid
+     *          the process id.
+     * @param [out] name
+     *          the buffer for the name.
+     * @param   size
+     *          the size of the buffer.
+     */
+    static void
+    getDefaultName (pid_t pid, char* name, std::size_t size)
+    {
+        snprintf (name, size, "/cookmem.%ld", (long)pid);
+    }
+
+    /**
+     * Check if the shared memory page was created.
+     *
+     * @return  true if the page is usable.
+     */
+    bool
+    isOpen () const
+    {
+        return m_page != nullptr;
+    }
+
+    /**
+     * Register a memory context.
+     *
+     * @param   name
+     *          the name of the context.  It is truncated to 47 characters.
+     * @return  the entry index to be passed to update ().  -1 if there
+     *          are no more entries.
+     */
+    int
+    add (const char* name)
+    {
+        if (m_page == nullptr)
+        {
+            return -1;
+        }
+        for (int i = 0; i < StatsPage::MAX_ENTRIES; ++i)
+        {
+            StatsPage::Entry& entry = m_page->entries[i];
+            std::uint32_t expected = 0;
+            if (entry.used.compare_exchange_strong (expected, 2))
+            {
+                beginWrite (entry);
+                snprintf (entry.name, sizeof(entry.name), "%s", name);
+                for (int v = 0; v < StatsPage::NUM_VALUES; ++v)
+                {
+                    entry.values[v].store (0, std::memory_order_relaxed);
+                }
+                entry.used.store (1, std::memory_order_relaxed);
+                endWrite (entry);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * Unregister a memory context.
+     *
+     * @param   index
+     *          the entry index obtained from add ().
+     */
+    void
+    remove (int index)
+    {
+        if (m_page == nullptr || index < 0 || index >= StatsPage::MAX_ENTRIES)
+        {
+            return;
+        }
+        StatsPage::Entry& entry = m_page->entries[index];
+        beginWrite (entry);
+        entry.used.store (0, std::memory_order_relaxed);
+        endWrite (entry);
+    }
+
+    /**
+     * Publish the statistics of a memory context.
+     *
+     * @param   index
+     *          the entry index obtained from add ().
+     * @param   memCtx
+     *          the memory context or the MemPool.
+     */
+    template<class Context>
+    void
+    update (int index, const Context& memCtx)
+    {
+        update (index, memCtx, CacheStats ());
+    }
+
+    /**
+     * Publish the statistics of a memory context along with the cache
+     * statistics of its arena.
+     *
+     * @param   index
+     *          the entry index obtained from add ().
+     * @param   memCtx
+     *          the memory context or the MemPool.
+     * @param   cacheStats
+     *          the cache statistics, such as CachedArena::getCacheStats ().
+     */
+    template<class Context>
+    void
+    update (int index, const Context& memCtx, const CacheStats& cacheStats)
+    {
+        if (m_page == nullptr || index < 0 || index >= StatsPage::MAX_ENTRIES)
+        {
+            return;
+        }
+        typename Context::Pool::PoolStats stats;
+        memCtx.getStats (stats);
+
+        struct timespec ts;
+        clock_gettime (CLOCK_REALTIME, &ts);
+
+        StatsPage::Entry& entry = m_page->entries[index];
+        std::uint64_t values[StatsPage::NUM_VALUES] =
+        {
+            (std::uint64_t)ts.tv_sec * 1000000000ULL + (std::uint64_t)ts.tv_nsec,
+            entry.values[1].load (std::memory_order_relaxed) + 1,
+            stats.footprint,
+            memCtx.getMaxFootprint (),
+            stats.liveBytes,
+            stats.freeBytes,
+            stats.numAllocations,
+            stats.numSegments,
+            stats.numDirectSegments,
+            cacheStats.numHits,
+            cacheStats.numMisses,
+            cacheStats.cachedBytes
+        };
+        beginWrite (entry);
+        for (int v = 0; v < StatsPage::NUM_VALUES; ++v)
+        {
+            entry.values[v].store (values[v], std::memory_order_relaxed);
+        }
+        endWrite (entry);
+    }
+
+    /**
+     * Get the shared memory page.
+     *
+     * @return  the shared memory page.  nullptr if it was not created.
+     */
+    const StatsPage*
+    getPage () const
+    {
+        return m_page;
+    }
+
+    /**
+     * Get the name of the shared memory object.
+     *
+     * @return  the name of the shared memory object.
+     */
+    const char*
+    getName () const
+    {
+        return m_name;
+    }
+
+private:
+    StatsRegistry (const StatsRegistry&) = delete;
+    StatsRegistry& operator= (const StatsRegistry&) = delete;
+
+    static inline void
+    beginWrite (StatsPage::Entry& entry)
+    {
+        entry.seq.store (entry.seq.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+    }
+
+    static inline void
+    endWrite (StatsPage::Entry& entry)
+    {
+        entry.seq.store (entry.seq.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    StatsPage*  m_page;
+    char        m_name[64];
+};
+
+/**
+ * Maps the stats page of another process read only.
+ */
+class StatsReader
+{
+public:
+    StatsReader ()
+    : m_page (nullptr)
+    {
+    }
+
+    ~StatsReader ()
+    {
+        close ();
+    }
+
+    /**
+     * Open a stats page.
+     *
+     * @param   name
+     *          the name of the POSIX shared memory object.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    open (const char* name)
+    {
+        close ();
+        int fd = shm_open (name, O_RDONLY, 0);
+        if (fd < 0)
+        {
+            return true;
+        }
+        void* ptr = mmap (nullptr, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+        ::close (fd);
+        if (ptr == MAP_FAILED)
+        {
+            return true;
+        }
+        m_page = (const StatsPage*)ptr;
+        if (m_page->magic != StatsPage::MAGIC)
+        {
+            close ();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Unmap the stats page.
+     */
+    void
+    close ()
+    {
+        if (m_page)
+        {
+            munmap ((void*)m_page, sizeof(StatsPage));
+            m_page = nullptr;
+        }
+    }
+
+    /**
+     * Get the stats page.
+     *
+     * @return  the stats page.  nullptr if it is not open.
+     */
+    const StatsPage*
+    getPage () const
+    {
+        return m_page;
+    }
+
+private:
+    StatsReader (const StatsReader&) = delete;
+    StatsReader& operator= (const StatsReader&) = delete;
+
+private:
+    const StatsPage*    m_page;
+};
+
+}   // namespace cookmem
+
+#endif  // WIN32
+
+#endif  // COOK_STATS_REGISTRY_H
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_STREAM_MEM_H
+#define COOK_STREAM_MEM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define COOKMEM_STREAM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cookmem
+{
+
+#ifdef COOKMEM_STREAM_X86
+/**
+ * Internal use.  Copy using SSE2 non-temporal stores.  dst needs to be
+ * 16-byte aligned and size a multiple of 64.
+ */
+inline void
+streamCopySse2 (char* dst, const char* src, std::size_t size)
+{
+    for (char* end = dst + size; dst < end; dst += 64, src += 64)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i*)src);
+        __m128i b = _mm_loadu_si128 ((const __m128i*)(src + 16));
+        __m128i c = _mm_loadu_si128 ((const __m128i*)(src + 32));
+        __m128i d = _mm_loadu_si128 ((const __m128i*)(src + 48));
+        _mm_stream_si128 ((__m128i*)dst, a);
+        _mm_stream_si128 ((__m128i*)(dst + 16), b);
+        _mm_stream_si128 ((__m128i*)(dst + 32), c);
+        _mm_stream_si128 ((__m128i*)(dst + 48), d);
+    }
+}
+
+/**
+ * Internal use.  Fill using SSE2 non-temporal stores.  dst needs to be
+ * 16-byte aligned and size a multiple of 64.
+ */
+inline void
+streamFillSse2 (char* dst, int c, std::size_t size)
+{
+    __m128i v = _mm_set1_epi8 ((char)c);
+    for (char* end = dst + size; dst < end; dst += 64)
+    {
+        _mm_stream_si128 ((__m128i*)dst, v);
+        _mm_stream_si128 ((__m128i*)(dst + 16), v);
+        _mm_stream_si128 ((__m128i*)(dst + 32), v);
+        _mm_stream_si128 ((__m128i*)(dst + 48), v);
+    }
+}
+
+/**
+ * Internal use.  Copy using AVX2 non-temporal stores.  dst needs to be
+ * 32-byte aligned and size a multiple of 64.
+ */
+__attribute__((target("avx2"))) inline void
+streamCopyAvx2 (char* dst, const char* src, std::size_t size)
+{
+    for (char* end = dst + size; dst < end; dst += 64, src += 64)
+    {
+        __m256i a = _mm256_loadu_si256 ((const __m256i*)src);
+        __m256i b = _mm256_loadu_si256 ((const __m256i*)(src + 32));
+        _mm256_stream_si256 ((__m256i*)dst, a);
+        _mm256_stream_si256 ((__m256i*)(dst + 32), b);
+    }
+}
+
+/**
+ * Internal use.  Fill using AVX2 non-temporal stores.  dst needs to be
+ * 32-byte aligned and size a multiple of 64.
+ */
+__attribute__((target("avx2"))) inline void
+streamFillAvx2 (char* dst, int c, std::size_t size)
+{
+    __m256i v = _mm256_set1_epi8 ((char)c);
+    for (char* end = dst + size; dst < end; dst += 64)
+    {
+        _mm256_stream_si256 ((__m256i*)dst, v);
+        _mm256_stream_si256 ((__m256i*)(dst + 32), v);
+    }
+}
+
+/**
+ * Internal use.  Check once if the CPU supports AVX2.
+ */
+inline bool
+hasAvx2 ()
+{
+    static const bool avx2 = (__builtin_cpu_init (), __builtin_cpu_supports ("avx2"));
+    return avx2;
+}
+#endif  // COOKMEM_STREAM_X86
+
+/**
+ * Copy memory using non-temporal stores, which write the destination to
+ * the memory without bringing it into the cache.  This avoids evicting
+ * the working set when copying a buffer much larger than the cache.
+ *
+ * AVX2 is used if the CPU supports it, SSE2 otherwise.  On other platforms,
+ * it is simply memcpy.
+ *
+ * @param   dst
+ *          the destination.  It must not overlap with the source.
+ * @param   src
+ *          the source.
+ * @param   size
+ *          the number of bytes to copy.
+ */
+inline void
+streamCopy (void* dst, const void* src, std::size_t size)
+{
+#ifdef COOKMEM_STREAM_X86
+    char* d = (char*)dst;
+    const char* s = (const char*)src;
+    // copy the unaligned head normally
+    std::size_t head = (std::size_t)(-(std::uintptr_t)d & 31);
+    if (size < head + 64)
+    {
+        memcpy (dst, src, size);
+        return;
+    }
+    memcpy (d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    std::size_t bulk = size & ~(std::size_t)63;
+    if (hasAvx2 ())
+    {
+        streamCopyAvx2 (d, s, bulk);
+    }
+    else
+    {
+        streamCopySse2 (d, s, bulk);
+    }
+    // make the streaming stores visible before the normal ones
+    _mm_sfence ();
+    memcpy (d + bulk, s + bulk, size - bulk);
+#else
+    memcpy (dst, src, size);
+#endif
+}
+
+/**
+ * Fill memory using non-temporal stores.
+ *
+ * @param   dst
+ *          the destination.
+ * @param   c
+ *          the byte value.
+ * @param   size
+ *          the number of bytes to fill.
+ * @see     streamCopy
+ */
+inline void
+streamFill (void* dst, int c, std::size_t size)
+{
+#ifdef COOKMEM_STREAM_X86
+    char* d = (char*)dst;
+    std::size_t head = (std::size_t)(-(std::uintptr_t)d & 31);
+    if (size < head + 64)
+    {
+        memset (dst, c, size);
+        return;
+    }
+    memset (d, c, head);
+    d += head;
+    size -= head;
+
+    std::size_t bulk = size & ~(std::size_t)63;
+    if (hasAvx2 ())
+    {
+        streamFillAvx2 (d, c, bulk);
+    }
+    else
+    {
+        streamFillSse2 (d, c, bulk);
+    }
+    _mm_sfence ();
+    memset (d + bulk, c, size - bulk);
+#else
+    memset (dst, c, size);
+#endif
+}
+
+}   // namespace cookmem
+
+#endif  // COOK_STREAM_MEM_H
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COOK_TRACE_MEM_LOGGER_H
+#define COOK_TRACE_MEM_LOGGER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "cookmemlogger.h"
+
+namespace cookmem
+{
+
+/**
+ * The operation of a trace record.
+ */
+typedef enum
+{
+    TRACE_ALLOC = 1,        // size is the request size.  id 0 if failed.
+    TRACE_FREE = 2,         // size is the size reported by MemPool.
+    TRACE_REALLOC = 3,      // in place reallocation.  size is the new size.
+    TRACE_GET_SEGMENT = 4,  // id is the segment address.
+    TRACE_FREE_SEGMENT = 5  // id is the segment address.
+} TraceOp_et;
+
+/**
+ * A binary trace record.  The records are written in the native byte
+ * order.
+ */
+struct TraceRecord
+{
+    /** TraceOp_et */
+    std::uint8_t    op;
+    std::uint8_t    reserved[3];
+    /** nanoseconds since the previous record, saturated */
+    std::uint32_t   timeDelta;
+    /** the pointer id, which is the address of the memory */
+    std::uint64_t   id;
+    /** the size */
+    std::uint64_t   size;
+};
+
+/**
+ * The header at the start of a trace file.
+ */
+struct TraceHeader
+{
+    /** TRACE_MAGIC */
+    char            magic[8];
+    /** sizeof(TraceRecord) */
+    std::uint32_t   recordSize;
+    std::uint32_t   reserved;
+};
+
+/** the magic number of a trace file */
+static const char TRACE_MAGIC[8] = { 'C', 'O', 'O', 'K', 'T', 'R', 'C', '1' };
+
+/**
+ * A MemLogger that records all the allocation calls in a binary trace
+ * file, which can be replayed with the cookmem_replay tool to compare
+ * the allocators and the configurations on a real workload.
+ *
+ * The records are buffered and written when the buffer is full or when the
+ * logger is closed.  Memory corruptions are reported the same way as
+ * NoActionMemLogger after the buffer is flushed.
+ */
+class TraceMemLogger
+{
+public:
+    static const std::size_t BUFFER_RECORDS = 4096;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param   path
+     *          the trace file.  nullptr to open it later.
+     */
+    TraceMemLogger (const char* path = nullptr)
+    : m_file (nullptr),
+      m_numRecords (0),
+      m_numWritten (0),
+      m_error (false),
+      m_lastTime ()
+    {
+        if (path)
+        {
+            open (path);
+        }
+    }
+
+    ~TraceMemLogger ()
+    {
+        close ();
+    }
+
+    /**
+     * Open a trace file.  The existing file is overwritten.
+     *
+     * @param   path
+     *          the trace file.
+     * @return  true if there is an error.  false is okay.
+     */
+    bool
+    open (const char* path)
+    {
+        close ();
+        m_error = false;
+        m_file = fopen (path, "wb");
+        if (m_file == nullptr)
+        {
+            return true;
+        }
+        TraceHeader header;
+        memset (&header, 0, sizeof(header));
+        memcpy (header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.recordSize = sizeof(TraceRecord);
+        if (fwrite (&header, sizeof(header), 1, m_file) != 1)
+        {
+            m_error = true;
+        }
+        m_lastTime = std::chrono::steady_clock::now ();
+        return m_error;
+    }
+
+    /**
+     * Flush the buffered records and close the trace file.
+     *
+     * @return  true if there was an error writing the file.
+     */
+    bool
+    close ()
+    {
+        if (m_file == nullptr)
+        {
+            return false;
+        }
+        flush ();
+        if (fclose (m_file) != 0)
+        {
+            m_error = true;
+        }
+        m_file = nullptr;
+        return m_error;
+    }
+
+    /**
+     * Write the buffered records to the file.
+     *
+     * @return  true if there was an error writing the file.
+     */
+    bool
+    flush ()
+    {
+        if (m_file && m_numRecords > 0)
+        {
+            if (fwrite (m_records, sizeof(TraceRecord), m_numRecords, m_file) != m_numRecords)
+            {
+                m_error = true;
+            }
+            m_numWritten += m_numRecords;
+            m_numRecords = 0;
+        }
+        return m_error;
+    }
+
+    /**
+     * Check if the trace file is open.
+     */
+    bool
+    isOpen () const
+    {
+        return m_file != nullptr;
+    }
+
+    /**
+     * Get the number of records logged.
+     */
+    std::size_t
+    getNumRecords () const
+    {
+        return m_numWritten + m_numRecords;
+    }
+
+    inline void
+    logGetSegment (void* segment, std::size_t segmentSize)
+    {
+        record (TRACE_GET_SEGMENT, segment, segmentSize);
+    }
+
+    inline void
+    logFreeSegment (void* segment, std::size_t segmentSize)
+    {
+        record (TRACE_FREE_SEGMENT, segment, segmentSize);
+    }
+
+    inline void
+    logAllocation (void* userPtr, std::size_t userSize)
+    {
+        record (TRACE_ALLOC, userPtr, userSize);
+    }
+
+    inline void
+    logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize)
+    {
+        record (TRACE_REALLOC, userPtr, newUserSize);
+    }
+
+    inline void
+    logDeallocation (void* userPtr, std::size_t userSize)
+    {
+        if (userPtr)
+        {
+            record (TRACE_FREE, userPtr, userSize);
+        }
+    }
+
+    inline void
+    logError (void* userPtr, MemError_et error)
+    {
+        flush ();
+        throw Exception (error, "memory corruption detected.");
+    }
+
+private:
+    TraceMemLogger (const TraceMemLogger&) = delete;
+    TraceMemLogger& operator= (const TraceMemLogger&) = delete;
+
+    inline void
+    record (TraceOp_et op, void* ptr, std::size_t size)
+    {
+        if (m_file == nullptr)
+        {
+            return;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+        std::uint64_t delta = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_lastTime).count ();
+        m_lastTime = now;
+
+        TraceRecord& r = m_records[m_numRecords];
+        r.op = (std::uint8_t)op;
+        r.reserved[0] = r.reserved[1] = r.reserved[2] = 0;
+        r.timeDelta = delta > 0xffffffffu ? 0xffffffffu : (std::uint32_t)delta;
+        r.id = (std::uint64_t)(std::uintptr_t)ptr;
+        r.size = size;
+        if (++m_numRecords == BUFFER_RECORDS)
+        {
+            flush ();
+        }
+    }
+
+private:
+    FILE*           m_file;
+    std::size_t     m_numRecords;
+    std::size_t     m_numWritten;
+    bool            m_error;
+    std::chrono::steady_clock::time_point   m_lastTime;
+    TraceRecord     m_records[BUFFER_RECORDS];
+};
+
+}   // namespace cookmem
+
+#endif  // COOK_TRACE_MEM_LOGGER_H
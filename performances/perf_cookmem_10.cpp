@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookbatchmmaparena.h>
+
+/**
+ * Compares thousands of short lived memory contexts sharing a
+ * BatchMmapArena against the same contexts using SimpleMemContext, where
+ * each context maps its own segments.
+ */
+
+#define NUM_LIVE        256
+#define NUM_CONTEXTS    100000
+
+template<class MemCtx, class Factory>
+static std::size_t
+run (Factory& factory)
+{
+    MemCtx* contexts[NUM_LIVE] = {};
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < NUM_CONTEXTS; ++i)
+    {
+        std::size_t slot = (i * 7) % NUM_LIVE;
+        delete contexts[slot];
+        MemCtx* memCtx = factory.create ();
+        contexts[slot] = memCtx;
+        for (std::size_t j = 0; j < 8; ++j)
+        {
+            char* ptr = (char*)memCtx->allocate (64 + (i + j) % 2000);
+            ptr[0] = (char)j;
+            sum += ptr[0];
+        }
+    }
+    for (std::size_t i = 0; i < NUM_LIVE; ++i)
+    {
+        delete contexts[i];
+    }
+    return sum;
+}
+
+typedef cookmem::MemContext<cookmem::BatchMmapArena, cookmem::NoActionMemLogger> BatchMemCtx;
+typedef cookmem::SimpleMemContext<> SimpleMemCtx;
+
+class BatchFactory
+{
+public:
+    BatchMemCtx*
+    create ()
+    {
+        return new BatchMemCtx (arena, logger);
+    }
+
+    cookmem::BatchMmapArena     arena;
+    cookmem::NoActionMemLogger  logger;
+};
+
+class SimpleFactory
+{
+public:
+    SimpleMemCtx*
+    create ()
+    {
+        return new SimpleMemCtx ();
+    }
+};
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    BatchFactory batchFactory;
+    std::size_t sum1 = run<BatchMemCtx> (batchFactory);
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    SimpleFactory simpleFactory;
+    std::size_t sum2 = run<SimpleMemCtx> (simpleFactory);
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 != sum2)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+
+/**
+ * Compares growing large buffers with reallocate with and without the mmap
+ * threshold.  With the threshold, each buffer has its own segment, which
+ * MmapArena resizes using mremap without copying the memory.
+ */
+
+#define NUM_BUFFERS 8
+#define NUM_ROUNDS  5
+#define MAX_SIZE    (64 * 1024 * 1024)
+
+static std::size_t
+growBuffers (std::size_t threshold)
+{
+    cookmem::SimpleMemContext<> memCtx;
+    memCtx.setMmapThreshold (threshold);
+
+    std::size_t sum = 0;
+    for (int round = 0; round < NUM_ROUNDS; ++round)
+    {
+        char* ptrs[NUM_BUFFERS] = {};
+        std::size_t sizes[NUM_BUFFERS] = {};
+        for (std::size_t size = 1024 * 1024; size <= MAX_SIZE; size *= 2)
+        {
+            for (int i = 0; i < NUM_BUFFERS; ++i)
+            {
+                char* ptr = (char*)memCtx.reallocate (ptrs[i], size);
+                if (ptr == nullptr)
+                {
+                    return 0;
+                }
+                // only touch the newly grown part, like appending
+                memset (ptr + sizes[i], i + 1, size - sizes[i]);
+                sum += ptr[size - 1];
+                ptrs[i] = ptr;
+                sizes[i] = size;
+            }
+        }
+        for (int i = 0; i < NUM_BUFFERS; ++i)
+        {
+            sum += ptrs[i][0];
+            memCtx.deallocate (ptrs[i]);
+        }
+    }
+    return sum;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = growBuffers (256 * 1024);
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = growBuffers (0);
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 != sum2 || sum1 == 0)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <cookmem.h>
+
+/**
+ * Compares moving and clearing large buffers with and without the
+ * streaming threshold.
+ *
+ * While the buffers are copied, another thread keeps summing a small hot
+ * array.  The output is the copy time with and without streaming,
+ * followed by the average time of each pass over the hot array in
+ * nanoseconds with and without streaming.  Slower passes mean more of the
+ * hot array got evicted from the shared cache.
+ */
+
+#define BUFFER_SIZE (64 * 1024 * 1024)
+#define HOT_SIZE    (2 * 1024 * 1024)
+#define NUM_ROUNDS  10
+
+static std::atomic<bool>        s_stop;
+static std::atomic<std::size_t> s_passes;
+
+static void
+hotLoop (const long* hot, std::size_t count, long* result)
+{
+    long sum = 0;
+    std::size_t passes = 0;
+    while (!s_stop.load (std::memory_order_relaxed))
+    {
+        for (std::size_t i = 0; i < count; i += 8)
+        {
+            sum += hot[i];
+        }
+        ++passes;
+    }
+    s_passes = passes;
+    *result = sum;
+}
+
+static double
+moveBuffers (std::size_t threshold, const long* hot, double& passTime)
+{
+    cookmem::SimpleMemContext<> memCtx;
+    memCtx.setStreamThreshold (threshold);
+
+    long hotSum;
+    s_stop = false;
+    std::thread thread (hotLoop, hot, HOT_SIZE / sizeof(long), &hotSum);
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum = 0;
+    for (int round = 0; round < NUM_ROUNDS; ++round)
+    {
+        char* ptr = (char*)memCtx.callocate (BUFFER_SIZE, 1);
+        ptr[round] = 1;
+        // the block keeps the buffer from growing in place
+        void* block = memCtx.allocate (100);
+        ptr = (char*)memCtx.reallocate (ptr, BUFFER_SIZE * 2);
+        sum += ptr[round];
+        memCtx.deallocate (block);
+        memCtx.deallocate (ptr);
+    }
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    s_stop = true;
+    thread.join ();
+
+    double t = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+    passTime = s_passes ? t * 1e9 / s_passes : 0;
+    return sum == NUM_ROUNDS ? t : -1;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    long* hot = new long[HOT_SIZE / sizeof(long)];
+    for (std::size_t i = 0; i < HOT_SIZE / sizeof(long); ++i)
+    {
+        hot[i] = (long)i;
+    }
+
+    double pass1;
+    double pass2;
+    double t1 = moveBuffers (1024 * 1024, hot, pass1);
+    double t2 = moveBuffers (0, hot, pass2);
+    delete[] hot;
+
+    if (t1 < 0 || t2 < 0)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << t1 << "," << t2 << "," << pass1 << "," << pass2 << std::endl;
+    return 0;
+}
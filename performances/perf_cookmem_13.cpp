@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookdynamicmemlogger.h>
+
+/**
+ * Compares small allocations and deallocations using NoActionMemLogger
+ * and DynamicMemLogger without any sink installed.  The two should be
+ * within the noise of each other.
+ */
+
+#define NUM_PTRS    1024
+#define NUM_ROUNDS  20000
+
+template<class Logger>
+static std::size_t
+churn ()
+{
+    cookmem::SimpleMemContext<cookmem::MmapArena, Logger> memCtx;
+
+    std::size_t sum = 0;
+    void* ptrs[NUM_PTRS];
+    for (int round = 0; round < NUM_ROUNDS; ++round)
+    {
+        for (int i = 0; i < NUM_PTRS; ++i)
+        {
+            ptrs[i] = memCtx.allocate ((i * 7 + round) % 256 + 1);
+        }
+        for (int i = 0; i < NUM_PTRS; ++i)
+        {
+            sum += (std::size_t)ptrs[i] & 0xff;
+            memCtx.deallocate (ptrs[i]);
+        }
+    }
+    return sum;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = churn<cookmem::NoActionMemLogger> ();
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = churn<cookmem::DynamicMemLogger> ();
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 == 0 || sum2 == 0)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
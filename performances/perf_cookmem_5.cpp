@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <iostream>
+
+#include <cookmem.h>
+
+/**
+ * Compares CachedArena against BucketCachedArena for a context churn
+ * pattern: thousands of contexts each creating and releasing 64KB - 1MB
+ * segments.
+ */
+template<class CachedArenaType>
+static void
+test1 ()
+{
+    cookmem::MmapArena arena;
+    CachedArenaType cachedArena (arena);
+    cookmem::NoActionMemLogger logger;
+
+    unsigned int seed = 12345;
+    for (int i = 0; i < 20000; ++i)
+    {
+        cookmem::MemContext<CachedArenaType, cookmem::NoActionMemLogger> memCtx (cachedArena, logger);
+
+        for (int j = 0; j < 8; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            std::size_t size = 65536 + (seed >> 8) % (1048576 - 65536);
+            memCtx.allocate (size);
+        }
+    }
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    test1<cookmem::CachedArena<cookmem::MmapArena> > ();
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    test1<cookmem::BucketCachedArena<cookmem::MmapArena> > ();
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookspill.h>
+
+/**
+ * Compares evicting and restoring a whole context using MemSpill against
+ * serializing the objects to a file and rebuilding them, using a hash join
+ * build partition like structure.
+ */
+
+#define NUM_ENTRIES 200000
+
+typedef cookmem::SimpleMemContext<cookmem::MmapArena> MemCtx;
+
+struct Entry
+{
+    Entry*          next;
+    std::size_t     key;
+    std::size_t     length;
+    char*           payload;
+};
+
+static Entry*
+build (MemCtx& memCtx)
+{
+    Entry* head = nullptr;
+    for (std::size_t i = 0; i < NUM_ENTRIES; ++i)
+    {
+        Entry* entry = (Entry*)memCtx.allocate (sizeof(Entry));
+        entry->key = i * 2654435761UL;
+        entry->length = 32 + (i % 64) * 4;
+        entry->payload = (char*)memCtx.allocate (entry->length);
+        memset (entry->payload, (int)i, entry->length);
+        entry->next = head;
+        head = entry;
+    }
+    return head;
+}
+
+static std::size_t
+checksum (Entry* head)
+{
+    std::size_t sum = 0;
+    for (Entry* entry = head; entry; entry = entry->next)
+    {
+        sum += entry->key + entry->length + (unsigned char)entry->payload[entry->length - 1];
+    }
+    return sum;
+}
+
+static std::size_t
+test1 ()
+{
+    MemCtx memCtx;
+    Entry* head = build (memCtx);
+
+    cookmem::MemSpill spill;
+    spill.evict (memCtx.getPool ());
+    spill.restore (memCtx.getPool ());
+
+    return checksum (head);
+}
+
+static std::size_t
+test2 ()
+{
+    MemCtx memCtx;
+    Entry* head = build (memCtx);
+
+    FILE* file = tmpfile ();
+    for (Entry* entry = head; entry; entry = entry->next)
+    {
+        fwrite (&entry->key, sizeof(entry->key), 1, file);
+        fwrite (&entry->length, sizeof(entry->length), 1, file);
+        fwrite (entry->payload, 1, entry->length, file);
+    }
+    fflush (file);
+    memCtx.releaseAll ();
+
+    rewind (file);
+    head = nullptr;
+    Entry* tail = nullptr;
+    std::size_t key;
+    while (fread (&key, sizeof(key), 1, file) == 1)
+    {
+        Entry* entry = (Entry*)memCtx.allocate (sizeof(Entry));
+        entry->key = key;
+        if (fread (&entry->length, sizeof(entry->length), 1, file) != 1)
+        {
+            break;
+        }
+        entry->payload = (char*)memCtx.allocate (entry->length);
+        if (fread (entry->payload, 1, entry->length, file) != entry->length)
+        {
+            break;
+        }
+        entry->next = nullptr;
+        if (tail)
+        {
+            tail->next = entry;
+        }
+        else
+        {
+            head = entry;
+        }
+        tail = entry;
+    }
+    fclose (file);
+
+    return checksum (head);
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = test1 ();
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = test2 ();
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 != sum2)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
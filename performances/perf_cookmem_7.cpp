@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <cookringarena.h>
+
+/**
+ * Compares parsing variable length records from a RingMemContext against
+ * a plain circular buffer, which has to copy the records that wrap around
+ * the end of the buffer.
+ */
+
+#define RING_SIZE   (32 * 1024)
+#define READ_SIZE   4000
+#define STREAM_SIZE (4 * 1024 * 1024)
+#define NUM_PASSES  50
+
+static char s_stream[STREAM_SIZE];
+static std::size_t s_streamSize;
+
+static void
+initStream ()
+{
+    std::size_t pos = 0;
+    for (unsigned int i = 0; ; ++i)
+    {
+        std::size_t len = 4000 + (i * 7919) % 12000;
+        if (pos + 2 + len > STREAM_SIZE)
+        {
+            break;
+        }
+        s_stream[pos] = (char)(len & 0xff);
+        s_stream[pos + 1] = (char)(len >> 8);
+        memset (s_stream + pos + 2, (char)i, len);
+        pos += 2 + len;
+    }
+    s_streamSize = pos;
+}
+
+static inline std::size_t
+getLength (const unsigned char* ptr)
+{
+    return ptr[0] | ((std::size_t)ptr[1] << 8);
+}
+
+static inline std::size_t
+processRecord (const char* record, std::size_t len)
+{
+    return len + (unsigned char)record[0] + (unsigned char)record[len - 1];
+}
+
+static std::size_t
+test1 ()
+{
+    cookmem::RingArena arena (RING_SIZE);
+    cookmem::RingMemContext ring (arena);
+
+    std::size_t sum = 0;
+    for (int pass = 0; pass < NUM_PASSES; ++pass)
+    {
+        std::size_t pos = 0;
+        while (pos < s_streamSize || ring.getUsedSize () > 0)
+        {
+            std::size_t size = s_streamSize - pos;
+            if (size > READ_SIZE)
+            {
+                size = READ_SIZE;
+            }
+            if (size > ring.getFreeSize ())
+            {
+                size = ring.getFreeSize ();
+            }
+            if (size > 0)
+            {
+                // simulates read ()
+                char* ptr = ring.allocate (size);
+                memcpy (ptr, s_stream + pos, size);
+                pos += size;
+            }
+
+            while (ring.getUsedSize () >= 2)
+            {
+                char* tail = ring.getTail ();
+                std::size_t len = getLength ((unsigned char*)tail);
+                if (ring.getUsedSize () < len + 2)
+                {
+                    break;
+                }
+                sum += processRecord (tail + 2, len);
+                ring.deallocate (tail, len + 2);
+            }
+        }
+    }
+    return sum;
+}
+
+static std::size_t
+test2 ()
+{
+    static char buffer[RING_SIZE];
+    static char scratch[RING_SIZE];
+
+    std::size_t sum = 0;
+    for (int pass = 0; pass < NUM_PASSES; ++pass)
+    {
+        std::size_t head = 0;
+        std::size_t tail = 0;
+        std::size_t pos = 0;
+        while (pos < s_streamSize || head != tail)
+        {
+            std::size_t size = s_streamSize - pos;
+            if (size > READ_SIZE)
+            {
+                size = READ_SIZE;
+            }
+            if (size > RING_SIZE - (head - tail))
+            {
+                size = RING_SIZE - (head - tail);
+            }
+            if (size > 0)
+            {
+                // simulates read (), which has to be split at the end.
+                std::size_t offset = head % RING_SIZE;
+                std::size_t first = RING_SIZE - offset;
+                if (first > size)
+                {
+                    first = size;
+                }
+                memcpy (buffer + offset, s_stream + pos, first);
+                memcpy (buffer, s_stream + pos + first, size - first);
+                head += size;
+                pos += size;
+            }
+
+            while (head - tail >= 2)
+            {
+                std::size_t offset = tail % RING_SIZE;
+                unsigned char lenBytes[2];
+                lenBytes[0] = buffer[offset];
+                lenBytes[1] = buffer[(offset + 1) % RING_SIZE];
+                std::size_t len = getLength (lenBytes);
+                if (head - tail < len + 2)
+                {
+                    break;
+                }
+                std::size_t start = (offset + 2) % RING_SIZE;
+                if (start + len <= RING_SIZE)
+                {
+                    sum += processRecord (buffer + start, len);
+                }
+                else
+                {
+                    // copy the record that wraps around
+                    std::size_t first = RING_SIZE - start;
+                    memcpy (scratch, buffer + start, first);
+                    memcpy (scratch + first, buffer, len - first);
+                    sum += processRecord (scratch, len);
+                }
+                tail += len + 2;
+            }
+        }
+    }
+    return sum;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    initStream ();
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = test1 ();
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = test2 ();
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 != sum2)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cookmem.h>
+#include <cookiobufferpool.h>
+
+/**
+ * Compares streaming a temporary file using buffers from IoBufferPool
+ * against allocating a buffer with posix_memalign for every I/O.
+ *
+ * The file size in MB can be specified as the first argument.  O_DIRECT
+ * is used if the file system supports it.
+ */
+
+#define IO_SIZE (256 * 1024)
+
+static int
+openFile (char* path)
+{
+    int fd = mkstemp (path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    unlink (path);
+
+#ifdef O_DIRECT
+    int flags = fcntl (fd, F_GETFL);
+    fcntl (fd, F_SETFL, flags | O_DIRECT);
+#endif
+    return fd;
+}
+
+template<class Alloc>
+static std::size_t
+stream (int fd, std::size_t fileSize, Alloc& alloc)
+{
+    std::size_t sum = 0;
+    for (std::size_t offset = 0; offset < fileSize; offset += IO_SIZE)
+    {
+        char* buffer = (char*)alloc.allocate ();
+        memset (buffer, (int)(offset / IO_SIZE), IO_SIZE);
+        if (pwrite (fd, buffer, IO_SIZE, offset) != IO_SIZE)
+        {
+            std::cout << "pwrite failed" << std::endl;
+            exit (1);
+        }
+        alloc.deallocate (buffer);
+    }
+    for (std::size_t offset = 0; offset < fileSize; offset += IO_SIZE)
+    {
+        char* buffer = (char*)alloc.allocate ();
+        if (pread (fd, buffer, IO_SIZE, offset) != IO_SIZE)
+        {
+            std::cout << "pread failed" << std::endl;
+            exit (1);
+        }
+        sum += (unsigned char)buffer[IO_SIZE - 1];
+        alloc.deallocate (buffer);
+    }
+    return sum;
+}
+
+class MemalignAlloc
+{
+public:
+    void*
+    allocate ()
+    {
+        void* ptr;
+        if (posix_memalign (&ptr, 4096, IO_SIZE) != 0)
+        {
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    void
+    deallocate (void* ptr)
+    {
+        free (ptr);
+    }
+};
+
+int
+main (int argc, const char* argv[])
+{
+    std::size_t fileSize = 64;
+    if (argc > 1)
+    {
+        fileSize = (std::size_t)atol (argv[1]);
+    }
+    fileSize *= 1024 * 1024;
+
+    char path1[] = "/tmp/perf_cookmem_8_XXXXXX";
+    char path2[] = "/tmp/perf_cookmem_8_XXXXXX";
+    int fd1 = openFile (path1);
+    int fd2 = openFile (path2);
+    if (fd1 < 0 || fd2 < 0)
+    {
+        std::cout << "Unable to create the temporary files" << std::endl;
+        return 1;
+    }
+
+    cookmem::MmapArena arena;
+    cookmem::IoBufferPool<> pool (arena, IO_SIZE, 4);
+    MemalignAlloc memalign;
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = stream (fd1, fileSize, pool);
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = stream (fd2, fileSize, memalign);
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    close (fd1);
+    close (fd2);
+
+    if (sum1 != sum2)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+
+/**
+ * Compares short lived per row memory contexts using InlineMemContext
+ * against SimpleMemContext using MmapArena.  Most rows only need a few
+ * hundred bytes, and one in a thousand needs a megabyte.
+ */
+
+#define NUM_ROWS    200000
+
+template<class MemCtx>
+static std::size_t
+processRow (std::size_t row)
+{
+    MemCtx memCtx;
+    std::size_t sum = 0;
+    int numFields = 4 + row % 8;
+    for (int i = 0; i < numFields; ++i)
+    {
+        std::size_t size = 16 + (row * 31 + i * 7) % 64;
+        char* ptr = (char*)memCtx.allocate (size);
+        memset (ptr, i, size);
+        sum += ptr[size - 1];
+    }
+    if (row % 1000 == 0)
+    {
+        char* ptr = (char*)memCtx.allocate (1024 * 1024);
+        memset (ptr, 1, 1024 * 1024);
+        sum += ptr[1024 * 1024 - 1];
+    }
+    return sum;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum1 = 0;
+    for (std::size_t row = 0; row < NUM_ROWS; ++row)
+    {
+        sum1 += processRow<cookmem::InlineMemContext<> > (row);
+    }
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    std::size_t sum2 = 0;
+    for (std::size_t row = 0; row < NUM_ROWS; ++row)
+    {
+        sum2 += processRow<cookmem::SimpleMemContext<> > (row);
+    }
+
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    if (sum1 != sum2)
+    {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << ","
+              << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << std::endl;
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookbatchmmaparena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_SEGMENTS 40
+
+static int
+test1 ()
+{
+    cookmem::BatchMmapArena arena (65536, 16);
+
+    void* ptrs[NUM_SEGMENTS];
+    for (int i = 0; i < NUM_SEGMENTS; ++i)
+    {
+        std::size_t size = 1000;
+        ptrs[i] = arena.getSegment (size);
+        ASSERT_NE (nullptr, ptrs[i]);
+        ASSERT_EQ (65536, size);
+        memset (ptrs[i], i, size);
+    }
+    // 40 segments need 3 batches.
+    ASSERT_EQ (3, arena.getNumBatches ());
+    ASSERT_EQ (3, arena.getNumMappings ());
+    ASSERT_EQ (NUM_SEGMENTS, arena.getStats ().numSegments);
+
+    // a large segment is mapped individually.
+    std::size_t size = 1024 * 1024;
+    void* large = arena.getSegment (size);
+    ASSERT_NE (nullptr, large);
+    ASSERT_EQ (4, arena.getNumMappings ());
+    ASSERT_EQ (false, arena.freeSegment (large, size));
+    ASSERT_EQ (3, arena.getNumMappings ());
+
+    // double free is detected.
+    ASSERT_EQ (false, arena.freeSegment (ptrs[0], 65536));
+    ASSERT_EQ (true, arena.freeSegment (ptrs[0], 65536));
+    ASSERT_EQ (true, arena.freeSegment ((char*)ptrs[1] + 16, 65536));
+
+    // the freed segment is reused.
+    size = 100;
+    ASSERT_EQ (ptrs[0], arena.getSegment (size));
+
+    for (int i = 0; i < NUM_SEGMENTS; ++i)
+    {
+        ASSERT_EQ (false, arena.freeSegment (ptrs[i], 65536));
+    }
+    // one empty batch is kept.
+    ASSERT_EQ (1, arena.getNumBatches ());
+    ASSERT_EQ (1, arena.getNumMappings ());
+    ASSERT_EQ (0, arena.getStats ().numSegments);
+    ASSERT_EQ (0, arena.getStats ().segmentSize);
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::BatchMmapArena arena;
+    cookmem::NoActionMemLogger logger;
+
+    typedef cookmem::MemContext<cookmem::BatchMmapArena, cookmem::NoActionMemLogger> MemCtx;
+    for (int i = 0; i < 1000; ++i)
+    {
+        MemCtx memCtx1 (arena, logger);
+        MemCtx memCtx2 (arena, logger);
+        ASSERT_NE (nullptr, memCtx1.allocate (1000));
+        ASSERT_NE (nullptr, memCtx2.allocate (100000));
+        ASSERT_NE (nullptr, memCtx1.allocate (50000));
+    }
+    ASSERT_EQ (1, arena.getNumBatches ());
+    ASSERT_EQ (1, arena.getNumMappings ());
+    ASSERT_EQ (0, arena.getStats ().numSegments);
+
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_ENTRIES 9
+
+static int
+test1 ()
+{
+    cookmem::MallocArena arena;
+    cookmem::BucketCachedArena<cookmem::MallocArena> cachedArena (arena);
+    cookmem::NoActionMemLogger logger;
+
+    for (int loop = 0; loop < 2; ++loop)
+    {
+        cookmem::MemContext<cookmem::BucketCachedArena<cookmem::MallocArena>, cookmem::NoActionMemLogger> memCtx (cachedArena, logger);
+
+        void* ptrs[NUM_ENTRIES];
+
+        std::size_t size = 3;
+        for (int i = 0; i < NUM_ENTRIES; ++i)
+        {
+            size *= 10;
+            ptrs[i] = memCtx.allocate (size);
+            ASSERT_NE (nullptr, ptrs[i]);
+            ASSERT_EQ (true, memCtx.contains (ptrs[i]));
+        }
+
+        for (int i = 0; i < NUM_ENTRIES; ++i)
+        {
+            memCtx.deallocate (ptrs[i]);
+        }
+
+        memCtx.releaseAll ();
+        for (int i = 0; i < NUM_ENTRIES; ++i)
+        {
+            ASSERT_EQ (false, memCtx.contains (ptrs[i]));
+        }
+    }
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::MallocArena arena (16);
+    cookmem::BucketCachedArena<cookmem::MallocArena> cachedArena (arena);
+
+    ASSERT_EQ (true, cachedArena.isEmpty ());
+
+    std::size_t size1 = 100000;
+    void* ptr1 = cachedArena.getSegment (size1);
+    ASSERT_NE (nullptr, ptr1);
+    std::size_t size2 = 70000;
+    void* ptr2 = cachedArena.getSegment (size2);
+    ASSERT_NE (nullptr, ptr2);
+
+    // both segments are in the same size class.
+    ASSERT_EQ (false, cachedArena.freeSegment (ptr2, size2));
+    ASSERT_EQ (false, cachedArena.freeSegment (ptr1, size1));
+    ASSERT_EQ (false, cachedArena.isEmpty ());
+
+    // the largest segment of the size class is at the head.
+    std::size_t size = 80000;
+    ASSERT_EQ (ptr1, cachedArena.getSegment (size));
+    ASSERT_EQ (100000, size);
+
+    // a request that cannot be satisfied by the size class head goes to
+    // the underlying arena.
+    size = 80000;
+    void* ptr3 = cachedArena.getSegment (size);
+    ASSERT_NE (nullptr, ptr3);
+    ASSERT_NE (ptr2, ptr3);
+    ASSERT_EQ (80000, size);
+
+    // a smaller request is satisfied by a larger size class.
+    size = 1000;
+    ASSERT_EQ (ptr2, cachedArena.getSegment (size));
+    ASSERT_EQ (70000, size);
+    ASSERT_EQ (true, cachedArena.isEmpty ());
+
+    cachedArena.freeSegment (ptr1, 100000);
+    cachedArena.freeSegment (ptr2, 70000);
+    cachedArena.freeSegment (ptr3, 80000);
+
+    return 0;
+}
+
+/**
+ * Segments of size 0 are cached in the smallest size class by both
+ * freeSegment and getSegment.
+ */
+static int
+test3 ()
+{
+    cookmem::MallocArena arena (16);
+    cookmem::BucketCachedArena<cookmem::MallocArena> cachedArena (arena);
+
+    std::size_t size = 1000;
+    void* ptr = cachedArena.getSegment (size);
+    ASSERT_NE (nullptr, ptr);
+
+    ASSERT_EQ (false, cachedArena.freeSegment (ptr, 0));
+    ASSERT_EQ (false, cachedArena.isEmpty ());
+
+    size = 0;
+    ASSERT_EQ (ptr, cachedArena.getSegment (size));
+    ASSERT_EQ (0, size);
+    ASSERT_EQ (true, cachedArena.isEmpty ());
+
+    cachedArena.freeSegment (ptr, 1000);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+
+    return 0;
+}
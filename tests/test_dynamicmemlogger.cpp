@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookdynamicmemlogger.h>
+#include <cookstatsmemlogger.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::DynamicMemLogger> MemCtx;
+
+/**
+ * A sink that counts the events and remembers the last error.
+ */
+class CountSink : public cookmem::MemLogger
+{
+public:
+    CountSink ()
+    : numAllocs (0),
+      numFrees (0),
+      numErrors (0),
+      numReleases (0),
+      lastError (cookmem::MEM_ERROR_GENERAL)
+    {
+    }
+
+    virtual void logGetSegment (void* segment, std::size_t segmentSize) { }
+
+    virtual void logFreeSegment (void* segment, std::size_t segmentSize) { }
+
+    virtual void logAllocation (void* userPtr, std::size_t userSize) { ++numAllocs; }
+
+    virtual void logDeallocation (void* userPtr, std::size_t userSize) { ++numFrees; }
+
+    virtual void
+    logError (void* userPtr, cookmem::MemError_et error)
+    {
+        ++numErrors;
+        lastError = error;
+    }
+
+    virtual void logReleaseAll () { ++numReleases; }
+
+    int                     numAllocs;
+    int                     numFrees;
+    int                     numErrors;
+    int                     numReleases;
+    cookmem::MemError_et    lastError;
+};
+
+static int
+test1 ()
+{
+    MemCtx memCtx;
+    cookmem::DynamicMemLogger& logger = memCtx.getLogger ();
+    ASSERT_EQ (0, logger.getNumSinks ());
+
+    // nothing is logged without sinks
+    void* ptr1 = memCtx.allocate (100);
+    ASSERT_NE (nullptr, ptr1);
+
+    cookmem::StatsMemLogger stats;
+    cookmem::MemLoggerSink<cookmem::StatsMemLogger> statsSink (stats);
+    CountSink counter;
+
+    ASSERT_EQ (false, logger.attach (&statsSink));
+    ASSERT_EQ (false, logger.attach (&counter));
+    ASSERT_EQ (true, logger.attach (&counter));
+    ASSERT_EQ (true, logger.attach (nullptr));
+    ASSERT_EQ (2, logger.getNumSinks ());
+
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i + 1);
+    }
+    ASSERT_EQ (100, stats.getStats ().numAllocs);
+    ASSERT_EQ (100, counter.numAllocs);
+
+    // the events are no longer seen once the sink is detached
+    ASSERT_EQ (false, logger.detach (&statsSink));
+    ASSERT_EQ (true, logger.detach (&statsSink));
+    ASSERT_EQ (1, logger.getNumSinks ());
+    for (int i = 0; i < 50; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (0, stats.getStats ().numFrees);
+    ASSERT_EQ (50, counter.numFrees);
+
+    ASSERT_EQ (false, logger.attach (&statsSink));
+    for (int i = 50; i < 100; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (50, stats.getStats ().numFrees);
+    ASSERT_EQ (100, counter.numFrees);
+
+    memCtx.releaseAll ();
+    ASSERT_EQ (1, counter.numReleases);
+    ptr1 = memCtx.allocate (100);
+
+    logger.detachAll ();
+    ASSERT_EQ (0, logger.getNumSinks ());
+    memCtx.deallocate (ptr1);
+    ASSERT_EQ (100, counter.numFrees);
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::DynamicMemLogger logger;
+    CountSink sinks[cookmem::DynamicMemLogger::MAX_SINKS + 1];
+    for (std::size_t i = 0; i < cookmem::DynamicMemLogger::MAX_SINKS; ++i)
+    {
+        ASSERT_EQ (false, logger.attach (&sinks[i]));
+    }
+    ASSERT_EQ (true, logger.attach (&sinks[cookmem::DynamicMemLogger::MAX_SINKS]));
+
+    // detaching from the middle keeps the order of the rest
+    ASSERT_EQ (false, logger.detach (&sinks[3]));
+    logger.logAllocation (&logger, 10);
+    for (std::size_t i = 0; i < cookmem::DynamicMemLogger::MAX_SINKS; ++i)
+    {
+        ASSERT_EQ (i == 3 ? 0 : 1, sinks[i].numAllocs);
+    }
+
+    // errors reach all the sinks before the exception is thrown
+    bool thrown = false;
+    try
+    {
+        logger.logError (nullptr, cookmem::MEM_ERROR_ARENA_CALL);
+    }
+    catch (cookmem::Exception& ex)
+    {
+        thrown = true;
+        ASSERT_EQ (cookmem::MEM_ERROR_ARENA_CALL, ex.getError ());
+    }
+    ASSERT_EQ (true, thrown);
+    ASSERT_EQ (1, sinks[0].numErrors);
+    ASSERT_EQ (cookmem::MEM_ERROR_ARENA_CALL, sinks[7].lastError);
+    ASSERT_EQ (0, sinks[3].numErrors);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
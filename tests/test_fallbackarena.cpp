@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+class CountingArena
+{
+public:
+    CountingArena ()
+    : numSegments (0)
+    {
+    }
+
+    void*
+    getSegment (std::size_t& size)
+    {
+        void* ptr = m_arena.getSegment (size);
+        if (ptr)
+        {
+            ++numSegments;
+        }
+        return ptr;
+    }
+
+    bool
+    freeSegment (void* ptr, std::size_t size)
+    {
+        --numSegments;
+        return m_arena.freeSegment (ptr, size);
+    }
+
+    int numSegments;
+
+private:
+    cookmem::MallocArena    m_arena;
+};
+
+static int
+test1 ()
+{
+    char buffer[4096];
+    cookmem::FixedArena fixedArena (buffer, sizeof(buffer));
+    CountingArena countingArena;
+    cookmem::FallbackArena<cookmem::FixedArena, CountingArena> arena (fixedArena, countingArena);
+
+    std::size_t size = 100;
+    void* ptr1 = arena.getSegment (size);
+    ASSERT_EQ (true, fixedArena.contains (ptr1));
+    ASSERT_EQ (0, countingArena.numSegments);
+
+    size = 100;
+    void* ptr2 = arena.getSegment (size);
+    ASSERT_NE (nullptr, ptr2);
+    ASSERT_EQ (false, fixedArena.contains (ptr2));
+    ASSERT_EQ (1, countingArena.numSegments);
+    ASSERT_EQ (false, arena.freeSegment (ptr2, size));
+    ASSERT_EQ (0, countingArena.numSegments);
+
+    ASSERT_EQ (false, arena.freeSegment (ptr1, sizeof(buffer)));
+    size = 100;
+    ASSERT_EQ (ptr1, arena.getSegment (size));
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::InlineMemContext<4096, CountingArena> memCtx;
+    CountingArena& countingArena = memCtx.getArena ().getSecondary ();
+    cookmem::FixedArena& fixedArena = memCtx.getArena ().getPrimary ();
+
+    // small allocations are served from the inline buffer.
+    void* ptrs[20];
+    for (int i = 0; i < 20; ++i)
+    {
+        ptrs[i] = memCtx.allocate (100);
+        ASSERT_NE (nullptr, ptrs[i]);
+        ASSERT_EQ (true, fixedArena.contains (ptrs[i]));
+        memset (ptrs[i], i, 100);
+    }
+    ASSERT_EQ (0, countingArena.numSegments);
+
+    // oversized requests spill to the secondary arena.
+    void* ptr = memCtx.allocate (1000000);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (false, fixedArena.contains (ptr));
+    ASSERT_EQ (1, countingArena.numSegments);
+
+    memCtx.releaseAll ();
+    ASSERT_EQ (0, countingArena.numSegments);
+
+    ptr = memCtx.allocate (100);
+    ASSERT_EQ (true, fixedArena.contains (ptr));
+    ASSERT_EQ (0, countingArena.numSegments);
+
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
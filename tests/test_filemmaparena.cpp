@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookfilemmaparena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_ENTRIES 100
+
+static void* const BASE = (void*)0x5a0000000000UL;
+static const std::size_t CAPACITY = 16 * 1024 * 1024;
+
+typedef cookmem::MemContext<cookmem::FileMmapArena, cookmem::NoActionMemLogger> FileMemCtx;
+
+struct Entry
+{
+    Entry*  next;
+    int     value;
+    char*   name;
+};
+
+static int
+test1 (const char* path)
+{
+    cookmem::NoActionMemLogger logger;
+
+    void* freed;
+    {
+        cookmem::FileMmapArena arena (path, BASE, CAPACITY);
+        ASSERT_EQ (true, arena.isOpen ());
+        ASSERT_EQ (false, arena.isAttached ());
+
+        FileMemCtx memCtx (arena, logger);
+
+        Entry* head = nullptr;
+        for (int i = 0; i < NUM_ENTRIES; ++i)
+        {
+            Entry* entry = (Entry*)memCtx.allocate (sizeof(Entry));
+            ASSERT_NE (nullptr, entry);
+            entry->value = i;
+            entry->name = (char*)memCtx.allocate (16 + i * 100);
+            ASSERT_NE (nullptr, entry->name);
+            snprintf (entry->name, 16, "entry %d", i);
+            entry->next = head;
+            head = entry;
+        }
+        arena.setRoot (head);
+
+        // leave a free chunk behind
+        freed = memCtx.allocate (5000);
+        memCtx.deallocate (freed);
+
+        // keep the segments in the file
+        memCtx.detach ();
+        ASSERT_EQ (0, memCtx.getFootprint ());
+    }
+
+    {
+        cookmem::FileMmapArena arena (path, BASE, CAPACITY);
+        ASSERT_EQ (true, arena.isOpen ());
+        ASSERT_EQ (true, arena.isAttached ());
+
+        FileMemCtx memCtx (arena, logger);
+        memCtx.reattach ();
+        ASSERT_NE (0, memCtx.getFootprint ());
+
+        int count = 0;
+        char buffer[16];
+        for (Entry* entry = (Entry*)arena.getRoot (); entry; entry = entry->next)
+        {
+            ++count;
+            snprintf (buffer, sizeof(buffer), "entry %d", entry->value);
+            ASSERT_EQ (0, strcmp (buffer, entry->name));
+            ASSERT_EQ (true, memCtx.contains (entry, true));
+        }
+        ASSERT_EQ (NUM_ENTRIES, count);
+
+        ASSERT_EQ (false, memCtx.contains (freed, true));
+        ASSERT_EQ (freed, memCtx.allocate (5000));
+
+        // release the segments back to the file.
+        memCtx.releaseAll ();
+        std::size_t size;
+        ASSERT_EQ (nullptr, arena.nextSegment (nullptr, size));
+    }
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    char buffer[100000];
+    cookmem::RegionArena arena (buffer, sizeof(buffer));
+
+    std::size_t size1 = 10000;
+    void* ptr1 = arena.getSegment (size1);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (10000, size1);
+
+    std::size_t size2 = 20000;
+    void* ptr2 = arena.getSegment (size2);
+    ASSERT_NE (nullptr, ptr2);
+
+    std::size_t size3 = 30000;
+    void* ptr3 = arena.getSegment (size3);
+    ASSERT_NE (nullptr, ptr3);
+
+    std::size_t size = 50000;
+    ASSERT_EQ (nullptr, arena.getSegment (size));
+
+    ASSERT_EQ (true, arena.freeSegment (ptr1, size2));
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size1));
+    ASSERT_EQ (true, arena.freeSegment (ptr1, size1));
+    ASSERT_EQ (false, arena.freeSegment (ptr2, size2));
+
+    // the two free segments are coalesced.
+    std::size_t size4 = 25000;
+    ASSERT_EQ (ptr1, arena.getSegment (size4));
+    ASSERT_EQ (25008, size4);
+
+    ASSERT_EQ (ptr3, arena.nextSegment (ptr1, size));
+    ASSERT_EQ (30000, size);
+    ASSERT_EQ (nullptr, arena.nextSegment (ptr3, size));
+
+    ASSERT_EQ (false, arena.freeSegment (ptr3, size3));
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size4));
+    ASSERT_EQ (0, arena.getUsedSize ());
+
+    return 0;
+}
+
+static int
+test3 (const char* path)
+{
+    // a file with foreign contents is not overwritten.
+    char data[8192];
+    memset (data, 'x', sizeof(data));
+    FILE* file = fopen (path, "wb");
+    ASSERT_NE (nullptr, file);
+    ASSERT_EQ (sizeof(data), fwrite (data, 1, sizeof(data), file));
+    fclose (file);
+    {
+        cookmem::FileMmapArena arena (path, BASE, CAPACITY);
+        ASSERT_EQ (false, arena.isOpen ());
+        ASSERT_EQ (false, arena.isAttached ());
+        std::size_t size = 100;
+        ASSERT_EQ (nullptr, arena.getSegment (size));
+    }
+    char check[sizeof(data)];
+    file = fopen (path, "rb");
+    ASSERT_NE (nullptr, file);
+    ASSERT_EQ (sizeof(check), fread (check, 1, sizeof(check), file));
+    fclose (file);
+    ASSERT_EQ (0, memcmp (data, check, sizeof(data)));
+    unlink (path);
+
+    // neither is a heap created at a different base address.
+    void* const otherBase = (char*)BASE + 4 * CAPACITY;
+    {
+        cookmem::FileMmapArena arena (path, otherBase, CAPACITY);
+        ASSERT_EQ (true, arena.isOpen ());
+    }
+    {
+        cookmem::FileMmapArena arena (path, BASE, CAPACITY);
+        ASSERT_EQ (false, arena.isOpen ());
+    }
+    {
+        cookmem::FileMmapArena arena (path, otherBase, CAPACITY);
+        ASSERT_EQ (true, arena.isOpen ());
+        ASSERT_EQ (true, arena.isAttached ());
+    }
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    char path[] = "/tmp/test_filemmaparena_XXXXXX";
+    int fd = mkstemp (path);
+    ASSERT_NE (-1, fd);
+    close (fd);
+    unlink (path);
+
+    int ret = test1 (path);
+    unlink (path);
+    ASSERT_EQ (0, ret);
+    ASSERT_EQ (0, test2 ());
+
+    ret = test3 (path);
+    unlink (path);
+    ASSERT_EQ (0, ret);
+
+    return 0;
+}
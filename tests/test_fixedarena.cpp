@@ -105,12 +105,86 @@ test3 ()
     return 0;
 }
 
+static int
+test4 ()
+{
+    struct
+    {
+        char dummy;
+        char buffer[256000];
+    }   s;
+    cookmem::MultiFixedArena arena (s.buffer, sizeof(s.buffer));
+    cookmem::NoActionMemLogger logger;
+
+    // several memory contexts share the same buffer.
+    cookmem::MemContext<cookmem::MultiFixedArena, cookmem::NoActionMemLogger> memCtx1 (arena, logger);
+    cookmem::MemContext<cookmem::MultiFixedArena, cookmem::NoActionMemLogger> memCtx2 (arena, logger);
+
+    void* ptr1 = memCtx1.allocate (30000);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (0, (std::size_t)ptr1 & 0xf);
+    void* ptr2 = memCtx2.allocate (30000);
+    ASSERT_NE (nullptr, ptr2);
+    ASSERT_EQ (true, arena.contains (ptr1));
+    ASSERT_EQ (true, arena.contains (ptr2));
+    ASSERT_EQ (true, memCtx1.contains (ptr1));
+    ASSERT_EQ (false, memCtx1.contains (ptr2));
+
+    ASSERT_NE (nullptr, memCtx1.allocate (100000));
+    ASSERT_EQ (nullptr, memCtx2.allocate (100000));
+
+    // the segments released are reused.
+    memCtx1.releaseAll ();
+    ASSERT_NE (nullptr, memCtx2.allocate (100000));
+    void* ptr3 = memCtx1.allocate (20000);
+    ASSERT_NE (nullptr, ptr3);
+    ASSERT_EQ (true, ptr3 < ptr2);
+
+    memCtx1.releaseAll ();
+    memCtx2.releaseAll ();
+    ASSERT_EQ (0, arena.getUsedSize ());
+
+    return 0;
+}
+
+static int
+test5 ()
+{
+    char buffer[64000];
+    cookmem::MultiFixedArena arena (buffer, sizeof(buffer));
+
+    std::size_t size1 = 3000;
+    void* ptr1 = arena.getSegment (size1);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (true, size1 >= 3000);
+    std::size_t size2 = 3000;
+    void* ptr2 = arena.getSegment (size2);
+    ASSERT_NE (nullptr, ptr2);
+    std::size_t size3 = 3000;
+    void* ptr3 = arena.getSegment (size3);
+    ASSERT_NE (nullptr, ptr3);
+
+    // the two free segments are coalesced to satisfy a larger request.
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size1));
+    ASSERT_EQ (false, arena.freeSegment (ptr2, size2));
+    ASSERT_EQ (true, arena.freeSegment (ptr2, size2));
+    std::size_t size = 5000;
+    ASSERT_EQ (ptr1, arena.getSegment (size));
+
+    size = 64000;
+    ASSERT_EQ (nullptr, arena.getSegment (size));
+
+    return 0;
+}
+
 int
 main (int argc, const char* argv[])
 {
     ASSERT_EQ (0, test1 ());
     ASSERT_EQ (0, test2 ());
     ASSERT_EQ (0, test3 ());
+    ASSERT_EQ (0, test4 ());
+    ASSERT_EQ (0, test5 ());
 
     return 0;
 }
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<> MemCtx;
+typedef MemCtx::Pool::ChunkInfo ChunkInfo;
+
+static std::string
+readFile (FILE* f)
+{
+    std::string str;
+    char buffer[1024];
+    rewind (f);
+    std::size_t n;
+    while ((n = fread (buffer, 1, sizeof(buffer), f)) > 0)
+    {
+        str.append (buffer, n);
+    }
+    return str;
+}
+
+static int
+testWalk (bool padding)
+{
+    MemCtx memCtx (padding);
+    memCtx.setMmapThreshold (1024 * 1024);
+
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i * 10 + 1);
+    }
+    void* big = memCtx.allocate (2 * 1024 * 1024);
+    for (int i = 0; i < 100; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+
+    std::size_t numUsed = 0;
+    std::size_t numDirect = 0;
+    std::size_t numFree = 0;
+    std::size_t userBytes = 0;
+    std::size_t chunkBytes = 0;
+    ChunkInfo info;
+    info.chunk = nullptr;
+    while (memCtx.getPool ().nextChunk (info))
+    {
+        chunkBytes += info.chunkSize;
+        if (info.used)
+        {
+            ++numUsed;
+            numDirect += info.direct;
+            userBytes += info.userSize;
+            ASSERT_EQ (true, memCtx.contains (info.userPtr, true));
+            if (info.direct)
+            {
+                ASSERT_EQ (big, info.userPtr);
+            }
+        }
+        else
+        {
+            ++numFree;
+            ASSERT_EQ (nullptr, info.userPtr);
+        }
+    }
+    ASSERT_EQ (51, numUsed);
+    ASSERT_EQ (1, numDirect);
+    ASSERT_NE (0, numFree);
+    ASSERT_EQ (true, chunkBytes < memCtx.getFootprint ());
+    if (padding)
+    {
+        // exact size
+        std::size_t expected = 2 * 1024 * 1024;
+        for (int i = 1; i < 100; i += 2)
+        {
+            expected += i * 10 + 1;
+        }
+        ASSERT_EQ (expected, userBytes);
+    }
+    return 0;
+}
+
+static int
+test1 ()
+{
+    ASSERT_EQ (0, testWalk (false));
+    ASSERT_EQ (0, testWalk (true));
+
+    // empty pool
+    MemCtx memCtx;
+    ChunkInfo info;
+    info.chunk = nullptr;
+    ASSERT_EQ (false, memCtx.getPool ().nextChunk (info));
+    return 0;
+}
+
+static int
+test2 ()
+{
+    FILE* f = tmpfile ();
+    ASSERT_NE (nullptr, f);
+    {
+        MemCtx memCtx (true);
+        memCtx.setLeakReport (f);
+        memCtx.allocate (10);
+        memCtx.allocate (10);
+        memCtx.allocate (1000);
+        memCtx.deallocate (memCtx.allocate (100));
+        memCtx.releaseAll ();
+
+        // nothing leaked
+        memCtx.allocate (10);
+        memCtx.deallocate (memCtx.allocate (10));
+    }
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_EQ (std::string ("cookmem: 3 live allocations, 1020 bytes\n"
+                            "  size <= 16: 2 allocations, 20 bytes\n"
+                            "  size <= 1024: 1 allocations, 1000 bytes\n"
+                            "cookmem: 1 live allocations, 10 bytes\n"
+                            "  size <= 16: 1 allocations, 10 bytes\n"), str);
+    return 0;
+}
+
+static int
+test3 ()
+{
+    FILE* f = tmpfile ();
+    ASSERT_NE (nullptr, f);
+    MemCtx memCtx;
+    void* ptrs[1000];
+    for (int i = 0; i < 1000; ++i)
+    {
+        ptrs[i] = memCtx.allocate (1000);
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    memCtx.printFragmentation (f);
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_NE (std::string::npos, str.find ("used: 500 chunks"));
+    ASSERT_NE (std::string::npos, str.find ("free fragmentation: 0.9"));
+    ASSERT_NE (std::string::npos, str.find ("  segment 0x"));
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookiobufferpool.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+class CountingHook
+{
+public:
+    CountingHook ()
+    : numRegistered (0),
+      registeredSize (0),
+      fail (false)
+    {
+    }
+
+    bool
+    registerSegment (void* ptr, std::size_t size)
+    {
+        if (fail)
+        {
+            return true;
+        }
+        ++numRegistered;
+        registeredSize += size;
+        return false;
+    }
+
+    void
+    unregisterSegment (void* ptr, std::size_t size)
+    {
+        --numRegistered;
+        registeredSize -= size;
+    }
+
+    int         numRegistered;
+    std::size_t registeredSize;
+    bool        fail;
+};
+
+static int
+test1 ()
+{
+    cookmem::MmapArena arena;
+    cookmem::IoBufferPool<> pool (arena, 10000, 4);
+    ASSERT_EQ (12288, pool.getBufferSize ());
+
+    void* ptrs[10];
+    for (int i = 0; i < 10; ++i)
+    {
+        ptrs[i] = pool.allocate ();
+        ASSERT_NE (nullptr, ptrs[i]);
+        ASSERT_EQ (0, (std::size_t)ptrs[i] % 4096);
+        ASSERT_EQ (true, pool.contains (ptrs[i]));
+        memset (ptrs[i], i, pool.getBufferSize ());
+    }
+    // MmapArena returns 64KB segments, which hold 5 buffers each.
+    ASSERT_EQ (10, pool.getNumBuffers ());
+    ASSERT_EQ (0, pool.getNumFreeBuffers ());
+    ASSERT_EQ (false, pool.contains ((char*)ptrs[0] + 1));
+
+    // released buffers are reused first.
+    pool.deallocate (ptrs[3]);
+    ASSERT_EQ (ptrs[3], pool.allocate ());
+    ASSERT_EQ (10, pool.getNumBuffers ());
+
+    pool.releaseAll ();
+    ASSERT_EQ (0, pool.getNumBuffers ());
+    ASSERT_EQ (false, pool.contains (ptrs[0]));
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // malloc segments are not aligned, some space is skipped.
+    cookmem::MallocArena arena;
+    cookmem::IoBufferPool<cookmem::MallocArena> pool (arena, 4096, 8);
+
+    void* ptr = pool.allocate ();
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (0, (std::size_t)ptr % 4096);
+    ASSERT_EQ (true, pool.getNumBuffers () >= 7);
+
+    return 0;
+}
+
+static int
+test3 ()
+{
+    cookmem::MmapArena arena;
+    cookmem::CachedArena<cookmem::MmapArena> cachedArena (arena);
+    {
+        cookmem::IoBufferPool<cookmem::CachedArena<cookmem::MmapArena>, CountingHook> pool (cachedArena, 65536, 2);
+        CountingHook& hook = pool.getHook ();
+
+        for (int i = 0; i < 5; ++i)
+        {
+            ASSERT_NE (nullptr, pool.allocate ());
+        }
+        ASSERT_EQ (3, hook.numRegistered);
+        ASSERT_EQ (6 * 65536, hook.registeredSize);
+
+        // a segment that cannot be registered is not used.
+        hook.fail = true;
+        ASSERT_NE (nullptr, pool.allocate ());
+        ASSERT_EQ (nullptr, pool.allocate ());
+        ASSERT_EQ (6, pool.getNumBuffers ());
+
+        pool.releaseAll ();
+        ASSERT_EQ (0, hook.numRegistered);
+        ASSERT_EQ (0, hook.registeredSize);
+    }
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <cookmem.h>
+#include <cooklifetimememlogger.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::LifetimeMemLogger> MemCtx;
+
+static const char* const TAG_TEMP = "temp";
+static const char* const TAG_TUPLE = "tuple";
+static const char* const TAG_CACHE = "cache";
+
+static std::string
+readFile (FILE* f)
+{
+    std::string str;
+    char buffer[1024];
+    rewind (f);
+    std::size_t n;
+    while ((n = fread (buffer, 1, sizeof(buffer), f)) > 0)
+    {
+        str.append (buffer, n);
+    }
+    return str;
+}
+
+static int
+test1 ()
+{
+    ASSERT_EQ (0, cookmem::LifetimeStats::getAgeBucket (0));
+    ASSERT_EQ (0, cookmem::LifetimeStats::getAgeBucket (1));
+    ASSERT_EQ (1, cookmem::LifetimeStats::getAgeBucket (2));
+    ASSERT_EQ (1, cookmem::LifetimeStats::getAgeBucket (3));
+    ASSERT_EQ (10, cookmem::LifetimeStats::getAgeBucket (1024));
+    ASSERT_EQ (cookmem::LifetimeStats::NUM_AGE_BUCKETS - 1, cookmem::LifetimeStats::getAgeBucket (~(std::uint64_t)0));
+    for (std::uint64_t age = 1; age < 100000; age += 7)
+    {
+        ASSERT_EQ (true, age < cookmem::LifetimeStats::getAgeBucketLimit (cookmem::LifetimeStats::getAgeBucket (age)));
+    }
+    return 0;
+}
+
+static int
+test2 ()
+{
+    MemCtx memCtx;
+    cookmem::LifetimeMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (1);
+
+    // short lived temporaries
+    logger.setTag (TAG_TEMP);
+    for (int i = 0; i < 100; ++i)
+    {
+        void* ptr = memCtx.allocate (24);
+        memCtx.deallocate (ptr);
+    }
+
+    // tuples that are never freed individually
+    logger.setTag (TAG_TUPLE);
+    for (int i = 0; i < 50; ++i)
+    {
+        memCtx.allocate (200);
+    }
+    logger.setTag (nullptr);
+    ASSERT_EQ (50, logger.getNumLive ());
+
+    const cookmem::LifetimeStats* temp = logger.getTagStats (TAG_TEMP);
+    ASSERT_NE (nullptr, temp);
+    ASSERT_EQ (100, temp->numSampled);
+    ASSERT_EQ (100, temp->numFreed);
+    ASSERT_EQ (0, temp->numSurvived);
+    ASSERT_NE (0, temp->getAgePercentile (0.5));
+    ASSERT_EQ (nullptr, logger.getTagStats (nullptr));
+
+    memCtx.releaseAll ();
+    ASSERT_EQ (0, logger.getNumLive ());
+
+    const cookmem::LifetimeStats* tuple = logger.getTagStats (TAG_TUPLE);
+    ASSERT_NE (nullptr, tuple);
+    ASSERT_EQ (50, tuple->numSampled);
+    ASSERT_EQ (0, tuple->numFreed);
+    ASSERT_EQ (50, tuple->numSurvived);
+    ASSERT_EQ (50 * 200, tuple->survivedBytes);
+    ASSERT_EQ (0, tuple->getAgePercentile (0.5));
+
+    const cookmem::LifetimeStats& sc = logger.getSizeClassStats (cookmem::MemStats::getSizeClass (24));
+    ASSERT_EQ (100, sc.numFreed);
+
+    FILE* f = tmpfile ();
+    logger.printReport (f);
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_NE (std::string::npos, str.find ("tuple"));
+    ASSERT_NE (std::string::npos, str.find ("monotonic context"));
+    ASSERT_NE (std::string::npos, str.find ("short-lived child context"));
+    return 0;
+}
+
+/**
+ * Find the suggestion of a group in the report.
+ */
+static std::string
+getSuggestion (const std::string& report, const std::string& group)
+{
+    std::size_t start = report.find ("\n" + group + " ");
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+    std::size_t end = report.find ('\n', start + 1);
+    std::size_t pos = report.rfind ("  ", end);
+    return report.substr (pos + 2, end - pos - 2);
+}
+
+static int
+test4 ()
+{
+    MemCtx memCtx;
+    cookmem::LifetimeMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (1);
+
+    // freed right away
+    logger.setTag (TAG_TEMP);
+    for (int i = 0; i < 100; ++i)
+    {
+        memCtx.deallocate (memCtx.allocate (24));
+    }
+
+    // freed individually, but they outlive the short lived age
+    logger.setTag (TAG_CACHE);
+    void* ptrs[10];
+    for (int i = 0; i < 10; ++i)
+    {
+        ptrs[i] = memCtx.allocate (5000);
+    }
+    std::this_thread::sleep_for (std::chrono::milliseconds (5));
+    for (int i = 0; i < 10; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+
+    // never freed individually
+    logger.setTag (TAG_TUPLE);
+    for (int i = 0; i < 10; ++i)
+    {
+        memCtx.allocate (200);
+    }
+    logger.setTag (nullptr);
+    memCtx.releaseAll ();
+
+    FILE* f = tmpfile ();
+    logger.printReport (f);
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_EQ ("short-lived child context", getSuggestion (str, TAG_TEMP));
+    ASSERT_EQ ("general pool", getSuggestion (str, TAG_CACHE));
+    ASSERT_EQ ("monotonic context", getSuggestion (str, TAG_TUPLE));
+
+    // with a shorter limit, nothing is short lived.
+    logger.setShortLivedAge (0);
+    f = tmpfile ();
+    logger.printReport (f);
+    str = readFile (f);
+    fclose (f);
+    ASSERT_EQ ("general pool", getSuggestion (str, TAG_TEMP));
+    return 0;
+}
+
+static int
+test3 ()
+{
+    MemCtx memCtx;
+    cookmem::LifetimeMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (10);
+
+    void* ptrs[1024];
+    for (int i = 0; i < 1024; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i + 1);
+    }
+    // rounded down to one in every 8 allocations
+    ASSERT_EQ (1024 / 8, logger.getNumLive ());
+    for (int i = 0; i < 1024; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (0, logger.getNumLive ());
+
+    std::size_t numFreed = 0;
+    for (int c = 0; c < cookmem::MemStats::NUM_SIZE_CLASSES; ++c)
+    {
+        numFreed += logger.getSizeClassStats (c).numFreed;
+    }
+    ASSERT_EQ (1024 / 8, numFreed);
+
+    logger.reset ();
+    ASSERT_EQ (nullptr, logger.getTagStats (nullptr));
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    ASSERT_EQ (0, test4 ());
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookmlockarena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static int
+test1 ()
+{
+    // segments that cannot be locked due to RLIMIT_MEMLOCK are still used.
+    cookmem::MlockArena arena;
+
+    std::size_t size = 100;
+    void* ptr = arena.getSegment (size);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (65536, size);
+    memset (ptr, 0xab, size);
+    ASSERT_EQ (false, arena.freeSegment (ptr, size));
+
+    size = 4 * 1024 * 1024;
+    ptr = arena.getSegment (size);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (false, arena.freeSegment (ptr, size));
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::SimpleMemContext<cookmem::MlockArena> memCtx;
+
+    ASSERT_EQ (false, memCtx.reserve (1024 * 1024));
+    std::size_t footprint = memCtx.getFootprint ();
+    ASSERT_EQ (true, footprint > 1024 * 1024);
+
+    memCtx.setWarmedUp (true);
+    ASSERT_EQ (true, memCtx.isWarmedUp ());
+
+    // allocations within the reserved space do not call the arena.
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = memCtx.allocate (100 + i * 100);
+        ASSERT_NE (nullptr, ptrs[i]);
+    }
+    for (int i = 0; i < 100; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    for (int i = 0; i < 50; ++i)
+    {
+        ASSERT_NE (nullptr, memCtx.allocate (50 + i * 10));
+    }
+    ASSERT_EQ (footprint, memCtx.getFootprint ());
+
+    // a request beyond the reserved space is reported.
+    bool reported = false;
+    try
+    {
+        memCtx.allocate (2 * 1024 * 1024);
+    }
+    catch (cookmem::Exception& ex)
+    {
+        reported = (ex.getError () == cookmem::MEM_ERROR_ARENA_CALL);
+    }
+    ASSERT_EQ (true, reported);
+
+    memCtx.setWarmedUp (false);
+    ASSERT_NE (nullptr, memCtx.allocate (2 * 1024 * 1024));
+
+    return 0;
+}
+
+static int
+test3 ()
+{
+    // touch a large reservation using several threads.
+    cookmem::SimpleMemContext<> memCtx;
+
+    const std::size_t size = 64 * 1024 * 1024;
+    ASSERT_EQ (false, memCtx.reserve (size, 4));
+    memCtx.setWarmedUp (true);
+
+    char* ptr = (char*)memCtx.allocate (size);
+    ASSERT_NE (nullptr, ptr);
+    memset (ptr, 1, size);
+
+    // the reserved segment is the only segment.
+    std::size_t segSize;
+    void* seg = memCtx.getPool ().nextSegment (nullptr, segSize);
+    ASSERT_NE (nullptr, seg);
+    ASSERT_EQ (nullptr, memCtx.getPool ().nextSegment (seg, segSize));
+
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
@@ -13,8 +13,15 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <cookmem.h>
 
 #define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
@@ -117,6 +124,94 @@ test4 ()
     return 0;
 }
 
+static bool
+isZero (const char* ptr, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (ptr[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+test5 ()
+{
+    const std::size_t size = 16 * 1024 * 1024;
+    cookmem::SimpleMemContext<cookmem::MmapArena> memCtx;
+
+    // overflow
+    ASSERT_EQ (nullptr, memCtx.callocate (SIZE_MAX / 2, 3));
+    ASSERT_EQ (nullptr, memCtx.callocate (3, SIZE_MAX / 2));
+
+    // fresh segment is not cleared, so its pages are not touched.
+    char* ptr = (char*)memCtx.callocate (size / 16, 16);
+    ASSERT_NE (nullptr, ptr);
+#if defined(__linux__)
+    const std::size_t pageSize = (std::size_t)sysconf (_SC_PAGESIZE);
+    char* page = (char*)(((std::size_t)ptr + pageSize * 2) & ~(pageSize - 1));
+    unsigned char vec[16];
+    ASSERT_EQ (0, mincore (page, pageSize * 16, vec));
+    int resident = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        resident += vec[i] & 1;
+    }
+    ASSERT_EQ (0, resident);
+#endif
+    ASSERT_EQ (true, isZero (ptr, size));
+
+    // reused memory is cleared.
+    memset (ptr, 0xab, size);
+    memCtx.deallocate (ptr);
+    ptr = (char*)memCtx.callocate (size / 16, 16);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (true, isZero (ptr, size));
+
+    // the same with the direct segments.
+    memCtx.deallocate (ptr);
+    memCtx.setMmapThreshold (1024 * 1024);
+    ptr = (char*)memCtx.callocate (size, 1);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (true, isZero (ptr, size));
+    memset (ptr, 0xab, size);
+    ptr = (char*)memCtx.reallocate (ptr, size / 2);
+    memCtx.deallocate (ptr);
+    ptr = (char*)memCtx.callocate (size, 1);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (true, isZero (ptr, size));
+
+    // small requests carved from the remaining part of a segment
+    void* small = memCtx.allocate (100);
+    memset (small, 0xab, 100);
+    memCtx.deallocate (small);
+    ASSERT_EQ (true, isZero ((char*)memCtx.callocate (10, 10), 100));
+    return 0;
+}
+
+/**
+ * Huge requests fail instead of wrapping around with padding enabled.
+ */
+static int
+test6 ()
+{
+    cookmem::SimpleMemContext<cookmem::MmapArena> memCtx (true);
+    memCtx.setMmapThreshold (1024 * 1024);
+
+    ASSERT_EQ (nullptr, memCtx.callocate ((std::size_t)1 << 33, (std::size_t)1 << 33));
+    ASSERT_EQ (nullptr, memCtx.allocate (SIZE_MAX));
+    ASSERT_EQ (nullptr, memCtx.allocate (SIZE_MAX - 1));
+
+    void* ptr = memCtx.allocate (2 * 1024 * 1024);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (nullptr, memCtx.reallocate (ptr, SIZE_MAX));
+    memCtx.deallocate (ptr);
+    ASSERT_EQ (0, memCtx.getFootprint ());
+    return 0;
+}
 
 int
 main (int argc, const char* argv[])
@@ -125,6 +220,8 @@ main (int argc, const char* argv[])
     ASSERT_EQ (0, test2 ());
     ASSERT_EQ (0, test3 ());
     ASSERT_EQ (0, test4 ());
+    ASSERT_EQ (0, test5 ());
+    ASSERT_EQ (0, test6 ());
 
     return 0;
 }
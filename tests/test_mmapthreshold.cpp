@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static bool
+checkBytes (const char* ptr, std::size_t size, char c)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (ptr[i] != c)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class Arena>
+static int
+testArena (bool padding)
+{
+    const std::size_t MB = 1024 * 1024;
+
+    cookmem::SimpleMemContext<Arena> memCtx (padding);
+    ASSERT_EQ (0, memCtx.getMmapThreshold ());
+    memCtx.setMmapThreshold (256 * 1024);
+    ASSERT_EQ (256 * 1024, memCtx.getMmapThreshold ());
+
+    // small requests still come from the shared segments.
+    char* small = (char*)memCtx.allocate (1000);
+    ASSERT_NE (nullptr, small);
+    std::size_t footprint = memCtx.getFootprint ();
+
+    // each large request gets its own segment.
+    char* ptr1 = (char*)memCtx.allocate (MB);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (0, (std::size_t)ptr1 & 0x0f);
+    ASSERT_EQ (true, memCtx.getFootprint () >= footprint + MB);
+    ASSERT_EQ (true, memCtx.contains (ptr1, true));
+    memset (ptr1, 'a', MB);
+
+    char* ptr2 = (char*)memCtx.allocate (MB + 1);
+    ASSERT_NE (nullptr, ptr2);
+    memset (ptr2, 'b', MB + 1);
+    ASSERT_EQ (true, memCtx.contains (ptr2 + MB, false));
+
+    // grow and shrink
+    ptr1 = (char*)memCtx.reallocate (ptr1, 8 * MB);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (true, checkBytes (ptr1, MB, 'a'));
+    memset (ptr1, 'c', 8 * MB);
+    ptr1 = (char*)memCtx.reallocate (ptr1, 7 * MB);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (true, checkBytes (ptr1, 7 * MB, 'c'));
+    ptr1 = (char*)memCtx.reallocate (ptr1, 2 * MB);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (true, checkBytes (ptr1, 2 * MB, 'c'));
+    if (memCtx.isStoringExactSize ())
+    {
+        ASSERT_EQ (2 * MB, memCtx.getSize (ptr1));
+    }
+
+    // shrink below the threshold
+    ptr1 = (char*)memCtx.reallocate (ptr1, 100);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (true, checkBytes (ptr1, 100, 'c'));
+
+    ASSERT_EQ (true, checkBytes (ptr2, MB + 1, 'b'));
+
+    // direct segments are returned to the arena immediately.
+    std::size_t before = memCtx.getFootprint ();
+    memCtx.deallocate (ptr2);
+    ASSERT_EQ (true, memCtx.getFootprint () + MB < before);
+
+    // the segments can be iterated
+    std::size_t count = 0;
+    std::size_t total = 0;
+    std::size_t size;
+    for (void* seg = memCtx.getPool ().nextSegment (nullptr, size); seg; seg = memCtx.getPool ().nextSegment (seg, size))
+    {
+        ++count;
+        total += size;
+    }
+    ASSERT_NE (0, count);
+    ASSERT_EQ (memCtx.getFootprint (), total);
+
+    memCtx.deallocate (ptr1);
+    memCtx.deallocate (small);
+
+    // leave some large allocations to be released by releaseAll
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_NE (nullptr, memCtx.allocate (MB * (i + 1)));
+    }
+    memCtx.releaseAll ();
+    ASSERT_EQ (0, memCtx.getFootprint ());
+
+    // leave some to be released by the destructor.
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_NE (nullptr, memCtx.allocate (MB * (i + 1)));
+    }
+    return 0;
+}
+
+static int
+test1 ()
+{
+    // arena with resizeSegment
+    ASSERT_EQ (0, testArena<cookmem::MmapArena> (false));
+    ASSERT_EQ (0, testArena<cookmem::MmapArena> (true));
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // arena without resizeSegment
+    ASSERT_EQ (0, testArena<cookmem::MallocArena> (false));
+    ASSERT_EQ (0, testArena<cookmem::MallocArena> (true));
+    return 0;
+}
+
+static int
+test3 ()
+{
+    // footprint limit applies to the direct segments as well.
+    cookmem::SimpleMemContext<cookmem::MmapArena> memCtx;
+    memCtx.setMmapThreshold (128 * 1024);
+    memCtx.setFootprintLimit (4 * 1024 * 1024);
+
+    void* ptr = memCtx.allocate (1024 * 1024);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (nullptr, memCtx.allocate (8 * 1024 * 1024));
+    ASSERT_EQ (nullptr, memCtx.reallocate (ptr, 8 * 1024 * 1024));
+    ptr = memCtx.reallocate (ptr, 2 * 1024 * 1024);
+    ASSERT_NE (nullptr, ptr);
+    memCtx.deallocate (ptr);
+    ASSERT_EQ (0, memCtx.getFootprint ());
+    return 0;
+}
+
+/**
+ * Counts the arena calls reported after the warm-up.
+ */
+class WarmUpLogger : public cookmem::NoActionMemLogger
+{
+public:
+    WarmUpLogger ()
+    : numArenaCalls (0)
+    {
+    }
+
+    void
+    logError (void* userPtr, cookmem::MemError_et error)
+    {
+        if (error == cookmem::MEM_ERROR_ARENA_CALL)
+        {
+            ++numArenaCalls;
+        }
+    }
+
+    int numArenaCalls;
+};
+
+static int
+test4 ()
+{
+    // releasing a direct segment after the warm-up is reported.
+    cookmem::SimpleMemContext<cookmem::MmapArena, WarmUpLogger> memCtx;
+    memCtx.setMmapThreshold (1024 * 1024);
+
+    void* ptr1 = memCtx.allocate (4 * 1024 * 1024);
+    void* ptr2 = memCtx.allocate (4 * 1024 * 1024);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_NE (nullptr, ptr2);
+    memCtx.setWarmedUp (true);
+    ASSERT_EQ (0, memCtx.getLogger ().numArenaCalls);
+
+    memCtx.deallocate (ptr1);
+    ASSERT_EQ (1, memCtx.getLogger ().numArenaCalls);
+
+    // releasing everything at once is expected.
+    memCtx.releaseAll ();
+    ASSERT_EQ (1, memCtx.getLogger ().numArenaCalls);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    ASSERT_EQ (0, test4 ());
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+
+#include <cookmem.h>
+#include <cooknumaarena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_ENTRIES 9
+
+static int
+test1 ()
+{
+    cookmem::NumaMemContext<> memCtx;
+
+    ASSERT_EQ (cookmem::getCurrentNumaNode (), memCtx.getArena ().getNode ());
+
+    void* ptrs[NUM_ENTRIES];
+
+    std::size_t size = 3;
+    for (int i = 0; i < NUM_ENTRIES; ++i)
+    {
+        size *= 10;
+        ptrs[i] = memCtx.allocate (size);
+        ASSERT_NE (nullptr, ptrs[i]);
+        ASSERT_EQ (true, memCtx.contains (ptrs[i]));
+        memset (ptrs[i], 0xff, size);
+    }
+
+    for (int i = 0; i < NUM_ENTRIES; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+
+    memCtx.releaseAll();
+    for (int i = 0; i < NUM_ENTRIES; ++i)
+    {
+        ASSERT_EQ (false, memCtx.contains (ptrs[i]));
+    }
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // The last node does not exist on any reasonable machine.
+    int node = cookmem::NUMA_MAX_NODES - 1;
+
+    cookmem::NumaMmapArena arena (node);
+    std::size_t size = 1000;
+    void* ptr = arena.getSegment (size);
+    ASSERT_NE (nullptr, ptr);
+    ASSERT_EQ (65536, size);
+    ASSERT_EQ (false, arena.freeSegment (ptr, size));
+
+    cookmem::NumaMmapArena strictArena (node, 65536, true);
+    size = 1000;
+    ASSERT_EQ (nullptr, strictArena.getSegment (size));
+
+    return 0;
+}
+
+static int
+test3 ()
+{
+    cookmem::NumaCachedArenas arenas;
+    cookmem::NoActionMemLogger logger;
+
+    typedef cookmem::MemContext<cookmem::NumaCachedArenas::Arena, cookmem::NoActionMemLogger> NumaCachedMemCtx;
+
+    void* ptr;
+    {
+        NumaCachedMemCtx memCtx (arenas.getLocalArena (), logger);
+        ptr = memCtx.allocate (100);
+        ASSERT_NE (nullptr, ptr);
+    }
+    {
+        NumaCachedMemCtx memCtx (arenas.getLocalArena (), logger);
+        // The cached segment is re-used.
+        ASSERT_EQ (ptr, memCtx.allocate (100));
+    }
+
+    ASSERT_NE (&arenas.getArena (0), &arenas.getArena (1));
+    ASSERT_EQ (&arenas.getArena (0), &arenas.getArena (-1));
+
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define COOKMEM_PATH_STATS
+
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<> MemCtx;
+
+static int
+test1 ()
+{
+    MemCtx memCtx;
+    memCtx.setMmapThreshold (1024 * 1024);
+    memCtx.setPathSampleInterval (1);
+
+    cookmem::AllocPathStats stats;
+    memCtx.getPathStats (stats);
+    for (int i = 0; i < cookmem::NUM_ALLOC_PATHS; ++i)
+    {
+        ASSERT_EQ (0, stats.counts[i]);
+    }
+
+    // the first allocation needs a segment from the arena
+    void* p1 = memCtx.allocate (100);
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_ARENA]);
+
+    // the remainder of the segment is in a tree bin
+    void* p2 = memCtx.allocate (100);
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_TREE]);
+
+    // the freed chunk is found in the exact small bin
+    memCtx.deallocate (p1);
+    p1 = memCtx.allocate (100);
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_SMALL_EXACT]);
+
+    // a larger small chunk gets split
+    void* p3 = memCtx.allocate (200);
+    void* p4 = memCtx.allocate (100);
+    memCtx.deallocate (p3);
+    void* p5 = memCtx.allocate (16);
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_SMALL_SPLIT]);
+
+    void* p6 = memCtx.allocate (2 * 1024 * 1024);
+    ASSERT_EQ (nullptr, memCtx.allocate ((std::size_t)-64));
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_DIRECT]);
+    ASSERT_EQ (1, stats.counts[cookmem::PATH_TOO_BIG]);
+    ASSERT_EQ (0, stats.counts[cookmem::PATH_FAILED]);
+
+    // every allocation is timed with the interval of 1
+    std::size_t total = 0;
+    for (int i = 0; i < cookmem::NUM_ALLOC_PATHS; ++i)
+    {
+        total += stats.counts[i];
+        ASSERT_EQ (stats.counts[i], stats.numSamples[i]);
+    }
+    ASSERT_EQ (8, total);
+    ASSERT_EQ (true, stats.getAverageTicks (cookmem::PATH_ARENA) > 0);
+
+    memCtx.resetPathStats ();
+    memCtx.getPathStats (stats);
+    ASSERT_EQ (0, stats.counts[cookmem::PATH_ARENA]);
+
+    memCtx.deallocate (p1);
+    memCtx.deallocate (p2);
+    memCtx.deallocate (p4);
+    memCtx.deallocate (p5);
+    memCtx.deallocate (p6);
+    return 0;
+}
+
+static int
+test2 ()
+{
+    MemCtx memCtx;
+    memCtx.setPathSampleInterval (100);
+
+    void* ptrs[1024];
+    for (int i = 0; i < 1024; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i % 200 + 1);
+    }
+    for (int i = 0; i < 1024; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+
+    // rounded down to one in every 64 allocations
+    cookmem::AllocPathStats stats;
+    memCtx.getPathStats (stats);
+    std::size_t numSamples = 0;
+    std::size_t total = 0;
+    for (int i = 0; i < cookmem::NUM_ALLOC_PATHS; ++i)
+    {
+        total += stats.counts[i];
+        numSamples += stats.numSamples[i];
+    }
+    ASSERT_EQ (1024, total);
+    ASSERT_EQ (1024 / 64, numSamples);
+    ASSERT_EQ (0, strcmp ("tree", cookmem::AllocPathStats::getPathName (cookmem::PATH_TREE)));
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
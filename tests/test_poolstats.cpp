@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdlib>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookregionarena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<> MemCtx;
+typedef cookmem::MemContext<cookmem::RegionArena, cookmem::NoActionMemLogger> RegionMemCtx;
+typedef MemCtx::Pool::PoolStats PoolStats;
+
+alignas(16) static char s_region[16 * 1024 * 1024];
+
+/**
+ * Compare the incremental statistics against a full walk of the chunks.
+ */
+template<class Ctx>
+static int
+checkStats (Ctx& memCtx)
+{
+    typename Ctx::Pool::PoolStats stats;
+    memCtx.getStats (stats);
+
+    std::size_t numUsed = 0;
+    std::size_t freeBytes = 0;
+    std::size_t largestFree = 0;
+    std::size_t usedChunkBytes = 0;
+    typename Ctx::Pool::ChunkInfo info;
+    info.chunk = nullptr;
+    while (memCtx.getPool ().nextChunk (info))
+    {
+        if (info.used)
+        {
+            ++numUsed;
+            usedChunkBytes += info.chunkSize;
+        }
+        else
+        {
+            freeBytes += info.chunkSize;
+            if (info.chunkSize > largestFree)
+            {
+                largestFree = info.chunkSize;
+            }
+        }
+    }
+
+    std::size_t binBytes = 0;
+    for (int i = 0; i < 32; ++i)
+    {
+        binBytes += stats.smallBinBytes[i] + stats.treeBinBytes[i];
+    }
+
+    ASSERT_EQ (memCtx.getFootprint (), stats.footprint);
+    ASSERT_EQ (numUsed, stats.numAllocations);
+    ASSERT_EQ (freeBytes, stats.freeBytes);
+    ASSERT_EQ (freeBytes, binBytes);
+    ASSERT_EQ (largestFree, stats.largestFreeChunk);
+    ASSERT_EQ (stats.footprint, stats.liveBytes + stats.freeBytes + stats.overheadBytes);
+    ASSERT_EQ (usedChunkBytes, stats.liveBytes + stats.numAllocations * 16);
+    return 0;
+}
+
+static int
+test1 ()
+{
+    MemCtx memCtx;
+    memCtx.setMmapThreshold (512 * 1024);
+
+    PoolStats stats;
+    memCtx.getStats (stats);
+    ASSERT_EQ (0, stats.footprint);
+    ASSERT_EQ (0, stats.numSegments);
+    ASSERT_EQ (0.0, stats.fragmentation);
+
+    const int N = 2000;
+    void* ptrs[N] = {};
+    srand (1234);
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            int r = rand ();
+            if (ptrs[i] && (r & 1))
+            {
+                memCtx.deallocate (ptrs[i]);
+                ptrs[i] = nullptr;
+            }
+            else if (ptrs[i] && (r & 2))
+            {
+                ptrs[i] = memCtx.reallocate (ptrs[i], (r >> 2) % 4096 + 1);
+            }
+            else if (ptrs[i] == nullptr)
+            {
+                std::size_t size = (i % 100 == 0) ? 600 * 1024 + (r % 1000) : (r >> 2) % 2048 + 1;
+                ptrs[i] = memCtx.allocate (size);
+            }
+        }
+        ASSERT_EQ (0, checkStats (memCtx));
+    }
+
+    memCtx.getStats (stats);
+    ASSERT_NE (0, stats.numDirectSegments);
+    ASSERT_EQ (true, stats.numSegments > stats.numDirectSegments);
+    ASSERT_EQ (true, stats.fragmentation >= 0 && stats.fragmentation < 1);
+
+    for (int i = 0; i < N; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (0, checkStats (memCtx));
+    memCtx.getStats (stats);
+    ASSERT_EQ (0, stats.numAllocations);
+    ASSERT_EQ (0, stats.liveBytes);
+    ASSERT_EQ (0, stats.numDirectSegments);
+
+    memCtx.releaseAll ();
+    memCtx.getStats (stats);
+    ASSERT_EQ (0, stats.footprint);
+    ASSERT_EQ (0, stats.numSegments);
+    ASSERT_EQ (0, stats.freeBytes);
+    ASSERT_EQ (0, stats.overheadBytes);
+    return 0;
+}
+
+/**
+ * The statistics are rebuilt when the segments are attached again.
+ */
+static int
+test2 ()
+{
+    cookmem::RegionArena arena (s_region, sizeof(s_region));
+    cookmem::NoActionMemLogger logger;
+    RegionMemCtx memCtx (arena, logger);
+    memCtx.setMmapThreshold (512 * 1024);
+
+    void* ptrs[200];
+    for (int i = 0; i < 200; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i * 37 + 1);
+    }
+    void* big = memCtx.allocate (1024 * 1024);
+    for (int i = 0; i < 200; i += 3)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (0, checkStats (memCtx));
+
+    RegionMemCtx::Pool::PoolStats before;
+    memCtx.getStats (before);
+
+    memCtx.detach ();
+    RegionMemCtx::Pool::PoolStats after;
+    memCtx.getStats (after);
+    ASSERT_EQ (0, after.numSegments);
+    ASSERT_EQ (0, after.numAllocations);
+    ASSERT_EQ (0, after.freeBytes);
+
+    memCtx.reattach ();
+    ASSERT_EQ (0, checkStats (memCtx));
+    memCtx.getStats (after);
+    ASSERT_EQ (before.footprint, after.footprint);
+    ASSERT_EQ (before.numSegments, after.numSegments);
+    ASSERT_EQ (before.numDirectSegments, after.numDirectSegments);
+    ASSERT_EQ (before.numAllocations, after.numAllocations);
+    ASSERT_EQ (before.liveBytes, after.liveBytes);
+    ASSERT_EQ (before.freeBytes, after.freeBytes);
+    ASSERT_EQ (before.overheadBytes, after.overheadBytes);
+
+    memCtx.deallocate (big);
+    ASSERT_EQ (0, checkStats (memCtx));
+    memCtx.releaseAll ();
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
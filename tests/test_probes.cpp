@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+/*
+ * Hook the probe points to count how often each one fires.
+ */
+static std::map<std::string, int> s_probes;
+
+#define COOKMEM_PROBE1(name, a1)            (++s_probes[#name])
+#define COOKMEM_PROBE2(name, a1, a2)        (++s_probes[#name])
+#define COOKMEM_PROBE3(name, a1, a2, a3)    (++s_probes[#name])
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static int
+test1 ()
+{
+    cookmem::SimpleMemContext<> memCtx;
+    memCtx.setMmapThreshold (1024 * 1024);
+
+    void* ptrs[10];
+    for (int i = 0; i < 10; ++i)
+    {
+        ptrs[i] = memCtx.allocate (100);
+    }
+    ASSERT_EQ (10, s_probes["alloc_entry"]);
+    ASSERT_EQ (10, s_probes["alloc_return"]);
+    ASSERT_EQ (1, s_probes["arena_alloc"]);
+    ASSERT_EQ (1, s_probes["segment_get"]);
+
+    ptrs[0] = memCtx.reallocate (ptrs[0], 50);
+    ASSERT_EQ (1, s_probes["realloc"]);
+
+    void* big = memCtx.allocate (2 * 1024 * 1024);
+    ASSERT_EQ (2, s_probes["segment_get"]);
+    memCtx.deallocate (big);
+    ASSERT_EQ (1, s_probes["segment_free"]);
+
+    ASSERT_EQ (nullptr, memCtx.allocate ((std::size_t)-64));
+    ASSERT_EQ (12, s_probes["alloc_return"]);
+
+    for (int i = 0; i < 5; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (6, s_probes["free"]);
+
+    memCtx.releaseAll ();
+    ASSERT_EQ (1, s_probes["release_all"]);
+    ASSERT_EQ (2, s_probes["segment_free"]);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    return 0;
+}
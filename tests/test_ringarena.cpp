@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+
+#include <cookringarena.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static int
+test1 ()
+{
+    cookmem::RingArena arena (100);
+    ASSERT_EQ (true, arena.isOpen ());
+    std::size_t capacity = arena.getCapacity ();
+    ASSERT_EQ (0, capacity % 4096);
+
+    // the second mapping mirrors the first.
+    char* base = arena.getBase ();
+    base[10] = 'a';
+    ASSERT_EQ ('a', base[capacity + 10]);
+    base[capacity + 20] = 'b';
+    ASSERT_EQ ('b', base[20]);
+
+    cookmem::RingMemContext ring (arena);
+    ASSERT_EQ (capacity, ring.getFreeSize ());
+    ASSERT_EQ (nullptr, ring.allocate (0));
+    ASSERT_EQ (nullptr, ring.allocate (capacity + 1));
+
+    char* ptr = ring.allocate (capacity - 10);
+    ASSERT_EQ (base, ptr);
+    ASSERT_EQ (nullptr, ring.allocate (11));
+    ring.deallocate (ring.getTail (), capacity - 20);
+    ASSERT_EQ (10, ring.getUsedSize ());
+
+    // wraps around the end and remains contiguous.
+    ptr = ring.allocate (100);
+    ASSERT_EQ (base + capacity - 10, ptr);
+    memset (ptr, 'x', 100);
+    ASSERT_EQ ('x', base[89]);
+    ASSERT_EQ (nullptr, ring.allocate (capacity));
+
+    // shrink the most recent allocation.
+    ASSERT_EQ (ptr, ring.reallocate (ptr, 50));
+    ASSERT_EQ (base + 40, ring.getHead ());
+    ASSERT_EQ (60, ring.getUsedSize ());
+
+    bool thrown = false;
+    try
+    {
+        ring.deallocate (ptr, 10);
+    }
+    catch (cookmem::Exception& ex)
+    {
+        thrown = true;
+    }
+    ASSERT_EQ (true, thrown);
+
+    ring.releaseAll ();
+    ASSERT_EQ (0, ring.getUsedSize ());
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // read variable length records through a pipe, and parse them in place.
+    int fds[2];
+    ASSERT_EQ (0, pipe (fds));
+
+    cookmem::RingArena arena (4096);
+    cookmem::RingMemContext ring (arena);
+
+    int written = 0;
+    int parsed = 0;
+    const int numRecords = 2000;
+    while (parsed < numRecords)
+    {
+        // produce some records
+        char record[256];
+        for (int i = 0; i < 10 && written < numRecords; ++i, ++written)
+        {
+            unsigned char len = (unsigned char)(1 + written % 200);
+            record[0] = (char)len;
+            memset (record + 1, (char)written, len);
+            ASSERT_EQ (len + 1, write (fds[1], record, len + 1));
+        }
+
+        // read as much as possible into the ring
+        std::size_t size = ring.getFreeSize ();
+        if (size > 1000)
+        {
+            size = 1000;
+        }
+        char* ptr = ring.allocate (size);
+        ASSERT_NE (nullptr, ptr);
+        ssize_t n = read (fds[0], ptr, size);
+        ASSERT_EQ (true, n > 0);
+        ring.reallocate (ptr, n);
+
+        // parse the complete records
+        while (ring.getUsedSize () > 0)
+        {
+            char* tail = ring.getTail ();
+            std::size_t len = (unsigned char)tail[0];
+            if (ring.getUsedSize () < len + 1)
+            {
+                break;
+            }
+            ASSERT_EQ (1 + parsed % 200, (int)len);
+            for (std::size_t i = 0; i < len; ++i)
+            {
+                ASSERT_EQ ((char)parsed, tail[1 + i]);
+            }
+            ring.deallocate (tail, len + 1);
+            ++parsed;
+        }
+    }
+    ASSERT_EQ (0, ring.getUsedSize ());
+
+    close (fds[0]);
+    close (fds[1]);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
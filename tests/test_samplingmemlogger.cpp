@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <cookmem.h>
+#include <cooksamplingmemlogger.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::SamplingMemLogger> SamplingMemContext;
+
+static int
+test1 ()
+{
+    // sample every allocation
+    SamplingMemContext memCtx;
+    cookmem::SamplingMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (1);
+
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i + 1);
+    }
+    ASSERT_EQ (100, logger.getNumLiveSamples ());
+    ASSERT_EQ (5050.0, logger.getEstimatedLiveBytes ());
+
+    ptrs[99] = memCtx.reallocate (ptrs[99], 10);
+    ASSERT_EQ (4960.0, logger.getEstimatedLiveBytes ());
+
+    for (int i = 0; i < 50; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (50, logger.getNumLiveSamples ());
+    for (int i = 50; i < 100; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (0, logger.getNumLiveSamples ());
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // the estimate is close to the actual live bytes
+    SamplingMemContext memCtx;
+    cookmem::SamplingMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (4096);
+
+    const int numAllocs = 100000;
+    std::size_t total = 0;
+    for (int i = 0; i < numAllocs; ++i)
+    {
+        std::size_t size = 16 + (i * 37) % 1000;
+        memCtx.allocate (size);
+        total += size;
+    }
+    ASSERT_EQ (true, logger.getNumLiveSamples () > 0);
+    ASSERT_EQ (true, logger.getNumLiveSamples () < numAllocs / 2);
+    double estimate = logger.getEstimatedLiveBytes ();
+    ASSERT_EQ (true, estimate > total * 0.8 && estimate < total * 1.2);
+    return 0;
+}
+
+static int
+test3 ()
+{
+    SamplingMemContext memCtx;
+    cookmem::SamplingMemLogger& logger = memCtx.getLogger ();
+    logger.setSampleInterval (1);
+    void* ptr1 = memCtx.allocate (100);
+    void* ptr2 = memCtx.allocate (200);
+    memCtx.deallocate (ptr1);
+
+    const char* dir = getenv ("TMPDIR");
+    std::string path = std::string (dir ? dir : "/tmp") + "/cookmem_heap_test.prof";
+    ASSERT_EQ (false, logger.dumpHeapProfile (path.c_str ()));
+
+    FILE* f = fopen (path.c_str (), "r");
+    ASSERT_NE (nullptr, f);
+    char line[4096];
+    ASSERT_NE (nullptr, fgets (line, sizeof(line), f));
+    ASSERT_EQ (0, strcmp (line, "heap profile: 1: 200 [2: 300] @ heap_v2/1\n"));
+    int numStacks = 0;
+    bool hasMaps = false;
+    while (fgets (line, sizeof(line), f))
+    {
+        if (strstr (line, "] @ 0x"))
+        {
+            ++numStacks;
+        }
+        if (strcmp (line, "MAPPED_LIBRARIES:\n") == 0)
+        {
+            hasMaps = true;
+        }
+    }
+    fclose (f);
+    remove (path.c_str ());
+    // the two allocations are made from different places
+    ASSERT_EQ (2, numStacks);
+    ASSERT_EQ (true, hasMaps);
+
+    memCtx.deallocate (ptr2);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+
+#include <unistd.h>
+
+#include <cookmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+typedef cookmem::CachedArena<cookmem::MmapArena>    SmallArena;
+typedef cookmem::SegregatedArena<SmallArena, cookmem::MmapArena>    Arena;
+
+static int
+test1 ()
+{
+    cookmem::MmapArena mmapArena;
+    SmallArena smallArena (mmapArena);
+    cookmem::MmapArena largeArena (1024 * 1024);
+    Arena arena (smallArena, largeArena, 512 * 1024);
+
+    std::size_t size1 = 1000;
+    void* ptr1 = arena.getSegment (size1);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (0, (std::size_t)ptr1 & 0xf);
+    ASSERT_EQ (65536, size1);
+
+    std::size_t size2 = 600000;
+    void* ptr2 = arena.getSegment (size2);
+    ASSERT_NE (nullptr, ptr2);
+    ASSERT_EQ (1024 * 1024, size2);
+
+    ASSERT_EQ (1, arena.getSmallStats ().numSegments);
+    ASSERT_EQ (65536, arena.getSmallStats ().segmentSize);
+    ASSERT_EQ (1, arena.getLargeStats ().numSegments);
+    ASSERT_EQ (1024 * 1024, arena.getLargeStats ().segmentSize);
+
+    // segments go back to the arena that owns them.
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size1));
+    ASSERT_EQ (false, arena.freeSegment (ptr2, size2));
+    ASSERT_EQ (0, arena.getSmallStats ().numSegments);
+    ASSERT_EQ (0, arena.getLargeStats ().numSegments);
+    ASSERT_EQ (1, arena.getSmallStats ().numFrees);
+    ASSERT_EQ (1024 * 1024, arena.getLargeStats ().maxSegmentSize);
+
+    // the small segment is cached and reused.
+    size1 = 1000;
+    ASSERT_EQ (ptr1, arena.getSegment (size1));
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size1));
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    cookmem::MmapArena mmapArena;
+    SmallArena smallArena (mmapArena);
+    cookmem::MmapArena largeArena;
+    Arena arena (smallArena, largeArena, 512 * 1024);
+    cookmem::NoActionMemLogger logger;
+
+    {
+        cookmem::MemContext<Arena, cookmem::NoActionMemLogger> memCtx (arena, logger);
+        for (int i = 0; i < 100; ++i)
+        {
+            ASSERT_NE (nullptr, memCtx.allocate (1000));
+        }
+        ASSERT_NE (nullptr, memCtx.allocate (4 * 1024 * 1024));
+        ASSERT_NE (nullptr, memCtx.allocate (8 * 1024 * 1024));
+
+        ASSERT_EQ (2, arena.getSmallStats ().numSegments);
+        ASSERT_EQ (2, arena.getLargeStats ().numSegments);
+    }
+    ASSERT_EQ (0, arena.getSmallStats ().numSegments);
+    ASSERT_EQ (0, arena.getLargeStats ().numSegments);
+    ASSERT_EQ (0, arena.getLargeStats ().segmentSize);
+    ASSERT_EQ (0, arena.getLargeStats ().numFailures);
+
+    return 0;
+}
+
+static int
+test3 ()
+{
+    // the segments of the tiers are handed out unchanged.
+    const std::size_t pageMask = (std::size_t)sysconf (_SC_PAGESIZE) - 1;
+    cookmem::MmapArena smallArena;
+    cookmem::MmapArena largeArena (2 * 1024 * 1024);
+    cookmem::SegregatedArena<cookmem::MmapArena, cookmem::MmapArena> arena (smallArena, largeArena, 64 * 1024);
+
+    std::size_t size1 = 65536 - 100;
+    void* ptr1 = arena.getSegment (size1);
+    ASSERT_NE (nullptr, ptr1);
+    ASSERT_EQ (0, (std::size_t)ptr1 & pageMask);
+    ASSERT_EQ (65536, size1);
+
+    std::size_t size2 = 2 * 1024 * 1024;
+    void* ptr2 = arena.getSegment (size2);
+    ASSERT_NE (nullptr, ptr2);
+    ASSERT_EQ (0, (std::size_t)ptr2 & pageMask);
+    ASSERT_EQ (2 * 1024 * 1024, size2);
+
+    std::size_t size3 = 3 * 1024 * 1024;
+    void* ptr3 = arena.getSegment (size3);
+    ASSERT_NE (nullptr, ptr3);
+    ASSERT_EQ (0, (std::size_t)ptr3 & pageMask);
+    ASSERT_EQ (3 * 1024 * 1024, size3);
+
+    // the small segment is rounded up to the threshold, yet it still goes
+    // back to the small arena.
+    ASSERT_EQ (false, arena.freeSegment (ptr1, size1));
+    ASSERT_EQ (0, arena.getSmallStats ().numSegments);
+    ASSERT_EQ (2, arena.getLargeStats ().numSegments);
+
+    ASSERT_EQ (false, arena.freeSegment (ptr3, size3));
+    ASSERT_EQ (false, arena.freeSegment (ptr2, size2));
+    ASSERT_EQ (0, arena.getLargeStats ().numSegments);
+    ASSERT_EQ (0, arena.getLargeStats ().segmentSize);
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cookmem.h>
+#include <cooksharedmem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_PROCESSES   4
+#define NUM_ENTRIES     1000
+
+static const std::size_t CAPACITY = 64 * 1024 * 1024;
+
+typedef cookmem::SharedMemPool<> SharedPool;
+
+static void
+runChild (SharedPool& pool, int id)
+{
+    char** table = (char**)pool.getRoot ();
+    char** entries = (char**)pool.callocate (NUM_ENTRIES, sizeof(char*));
+    for (int i = 0; i < NUM_ENTRIES; ++i)
+    {
+        std::size_t size = 16 + (i % 50) * 37;
+        entries[i] = (char*)pool.allocate (size);
+        if (entries[i] == nullptr)
+        {
+            _exit (1);
+        }
+        memset (entries[i], 'a' + id, size);
+        entries[i][size - 1] = 0;
+    }
+    for (int i = 1; i < NUM_ENTRIES; i += 2)
+    {
+        pool.deallocate (entries[i]);
+        entries[i] = nullptr;
+    }
+    table[id] = (char*)entries;
+}
+
+static int
+test1 (const char* name, void* base)
+{
+    cookmem::SharedMemArena arena (name, base, CAPACITY);
+    ASSERT_EQ (true, arena.isOpen ());
+
+    SharedPool pool (arena);
+    ASSERT_EQ (true, pool.isValid ());
+
+    void* table = pool.callocate (NUM_PROCESSES, sizeof(char*));
+    ASSERT_NE (nullptr, table);
+    pool.setRoot (table);
+
+    pid_t pids[NUM_PROCESSES];
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        pids[id] = fork ();
+        ASSERT_NE (-1, pids[id]);
+        if (pids[id] == 0)
+        {
+            if (name)
+            {
+                // Unmap the inherited region, and open the named region
+                // like an unrelated process.  Since the child leaves with
+                // _exit, the arena is not destroyed twice.
+                arena.~SharedMemArena ();
+                cookmem::SharedMemArena childArena (name, base, CAPACITY);
+                if (!childArena.isAttached ())
+                {
+                    _exit (1);
+                }
+                SharedPool childPool (childArena);
+                runChild (childPool, id);
+            }
+            else
+            {
+                SharedPool childPool (arena);
+                runChild (childPool, id);
+            }
+            _exit (0);
+        }
+    }
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        int status;
+        ASSERT_EQ (pids[id], waitpid (pids[id], &status, 0));
+        ASSERT_EQ (true, WIFEXITED (status));
+        ASSERT_EQ (0, WEXITSTATUS (status));
+    }
+
+    char** entryTable = (char**)pool.getRoot ();
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        char** entries = (char**)entryTable[id];
+        ASSERT_NE (nullptr, entries);
+        for (int i = 0; i < NUM_ENTRIES; ++i)
+        {
+            if (i % 2)
+            {
+                ASSERT_EQ (nullptr, entries[i]);
+                continue;
+            }
+            std::size_t size = 16 + (i % 50) * 37;
+            ASSERT_EQ (true, pool.contains (entries[i], true));
+            ASSERT_EQ (size - 1, strlen (entries[i]));
+            ASSERT_EQ ('a' + id, entries[i][0]);
+            pool.deallocate (entries[i]);
+        }
+        pool.deallocate (entries);
+    }
+
+    pool.destroy ();
+    ASSERT_EQ (false, pool.isValid ());
+    return 0;
+}
+
+/**
+ * Processes that open the same named region at the same time.  Exactly
+ * one of them initializes the region, and the allocations of all the
+ * processes do not overlap.
+ */
+static int
+test2 (const char* name, void* base)
+{
+    int ready[2];
+    int go[2];
+    ASSERT_EQ (0, pipe (ready));
+    ASSERT_EQ (0, pipe (go));
+
+    pid_t pids[NUM_PROCESSES];
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        pids[id] = fork ();
+        ASSERT_NE (-1, pids[id]);
+        if (pids[id] == 0)
+        {
+            close (ready[0]);
+            close (go[1]);
+
+            cookmem::SharedMemArena arena (name, base, CAPACITY);
+            SharedPool pool (arena);
+            if (!pool.isValid ())
+            {
+                _exit (1);
+            }
+            char* entries[NUM_ENTRIES];
+            for (int i = 0; i < NUM_ENTRIES; ++i)
+            {
+                std::size_t size = 16 + (i % 50) * 37;
+                entries[i] = (char*)pool.allocate (size);
+                if (entries[i] == nullptr)
+                {
+                    _exit (1);
+                }
+                memset (entries[i], 'a' + id, size);
+            }
+
+            // wait for all the processes to finish their allocations
+            char c = 0;
+            if (write (ready[1], &c, 1) != 1 || read (go[0], &c, 1) != 0)
+            {
+                _exit (1);
+            }
+            for (int i = 0; i < NUM_ENTRIES; ++i)
+            {
+                std::size_t size = 16 + (i % 50) * 37;
+                for (std::size_t j = 0; j < size; ++j)
+                {
+                    if (entries[i][j] != 'a' + id)
+                    {
+                        _exit (1);
+                    }
+                }
+                pool.deallocate (entries[i]);
+            }
+            _exit (arena.isCreator () ? 2 : 0);
+        }
+    }
+    close (ready[1]);
+    close (go[0]);
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        char c;
+        ASSERT_EQ (1, read (ready[0], &c, 1));
+    }
+    close (go[1]);
+    close (ready[0]);
+
+    int numCreators = 0;
+    for (int id = 0; id < NUM_PROCESSES; ++id)
+    {
+        int status;
+        ASSERT_EQ (pids[id], waitpid (pids[id], &status, 0));
+        ASSERT_EQ (true, WIFEXITED (status));
+        if (WEXITSTATUS (status) == 2)
+        {
+            ++numCreators;
+            continue;
+        }
+        ASSERT_EQ (0, WEXITSTATUS (status));
+    }
+    ASSERT_EQ (1, numCreators);
+
+    cookmem::SharedMemArena arena (name, base, CAPACITY);
+    ASSERT_EQ (true, arena.isAttached ());
+    ASSERT_EQ (false, arena.isCreator ());
+    SharedPool pool (arena);
+    ASSERT_EQ (true, pool.isValid ());
+    pool.destroy ();
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 (nullptr, nullptr));
+
+    char name[64];
+    snprintf (name, sizeof(name), "/test_sharedmem_%d", (int)getpid ());
+    cookmem::SharedMemArena::unlink (name);
+    int ret = test1 (name, (void*)0x5b0000000000UL);
+    cookmem::SharedMemArena::unlink (name);
+    ASSERT_EQ (0, ret);
+
+    ret = test2 (name, (void*)0x5b0000000000UL);
+    cookmem::SharedMemArena::unlink (name);
+    ASSERT_EQ (0, ret);
+
+    return 0;
+}
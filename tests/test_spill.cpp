@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookbatchmmaparena.h>
+#include <cookfilemmaparena.h>
+#include <cookmlockarena.h>
+#include <cookspill.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+#define NUM_ENTRIES 10000
+
+struct Entry
+{
+    Entry*  next;
+    int     value;
+    char*   name;
+};
+
+template<class MemCtx>
+static Entry*
+build (MemCtx& memCtx)
+{
+    Entry* head = nullptr;
+    for (int i = 0; i < NUM_ENTRIES; ++i)
+    {
+        Entry* entry = (Entry*)memCtx.allocate (sizeof(Entry));
+        entry->value = i;
+        entry->name = (char*)memCtx.allocate (16 + (i % 100) * 10);
+        snprintf (entry->name, 16, "entry %d", i);
+        entry->next = head;
+        head = entry;
+    }
+    return head;
+}
+
+static int
+verify (Entry* head)
+{
+    int count = 0;
+    char buffer[16];
+    for (Entry* entry = head; entry; entry = entry->next)
+    {
+        ++count;
+        snprintf (buffer, sizeof(buffer), "entry %d", entry->value);
+        ASSERT_EQ (0, strcmp (buffer, entry->name));
+    }
+    ASSERT_EQ (NUM_ENTRIES, count);
+    return 0;
+}
+
+static int
+test1 ()
+{
+    cookmem::SimpleMemContext<cookmem::MmapArena> memCtx;
+    Entry* head = build (memCtx);
+
+    cookmem::MemSpill spill;
+    ASSERT_EQ (false, spill.isEvicted ());
+    ASSERT_EQ (false, spill.evict (memCtx.getPool ()));
+    ASSERT_EQ (true, spill.isEvicted ());
+    ASSERT_EQ (true, spill.getSpilledSize () >= memCtx.getFootprint ());
+
+    // only one pool can be evicted at a time.
+    ASSERT_EQ (true, spill.evict (memCtx.getPool ()));
+
+    ASSERT_EQ (false, spill.restore (memCtx.getPool ()));
+    ASSERT_EQ (false, spill.isEvicted ());
+    ASSERT_EQ (0, verify (head));
+
+    // evict again using the same spill file
+    ASSERT_EQ (false, spill.evict (memCtx.getPool ()));
+    ASSERT_EQ (false, spill.restore (memCtx.getPool ()));
+    ASSERT_EQ (0, verify (head));
+
+    // the memory context is still usable.
+    ASSERT_NE (nullptr, memCtx.allocate (100000));
+
+    // only the pool evicted can be restored.
+    cookmem::SimpleMemContext<cookmem::MmapArena> otherCtx;
+    ASSERT_EQ (false, spill.evict (memCtx.getPool ()));
+    ASSERT_EQ (true, spill.restore (otherCtx.getPool ()));
+    ASSERT_EQ (true, spill.isEvicted ());
+    ASSERT_EQ (false, spill.restore (memCtx.getPool ()));
+    ASSERT_EQ (0, verify (head));
+
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // malloc segments are not page aligned, so they cannot be evicted.
+    cookmem::SimpleMemContext<cookmem::MallocArena> memCtx;
+    Entry* head = build (memCtx);
+
+    cookmem::MemSpill spill;
+    ASSERT_EQ (true, spill.evict (memCtx.getPool ()));
+    ASSERT_EQ (false, spill.isEvicted ());
+    ASSERT_EQ (0, verify (head));
+
+    return 0;
+}
+
+static int
+test4 ()
+{
+    // batch segments are plain anonymous mappings, even behind a cache.
+    {
+        cookmem::BatchMmapArena batchArena;
+        cookmem::CachedArena<cookmem::BatchMmapArena> arena (batchArena);
+        cookmem::NoActionMemLogger logger;
+        cookmem::MemContext<cookmem::CachedArena<cookmem::BatchMmapArena>, cookmem::NoActionMemLogger> memCtx (arena, logger);
+        Entry* head = build (memCtx);
+
+        cookmem::MemSpill spill;
+        ASSERT_EQ (false, spill.evict (memCtx.getPool ()));
+        ASSERT_EQ (false, spill.restore (memCtx.getPool ()));
+        ASSERT_EQ (0, verify (head));
+    }
+
+    // locked segments would not be locked again, so they are refused.
+    {
+        cookmem::SimpleMemContext<cookmem::MlockArena> memCtx;
+        Entry* head = build (memCtx);
+
+        cookmem::MemSpill spill;
+        ASSERT_EQ (true, spill.evict (memCtx.getPool ()));
+        ASSERT_EQ (false, spill.isEvicted ());
+        ASSERT_EQ (0, verify (head));
+
+        // paging out in place keeps the locks.
+        cookmem::MemSpill pageout (cookmem::SPILL_PAGEOUT);
+        if (!pageout.evict (memCtx.getPool ()))
+        {
+            ASSERT_EQ (false, pageout.restore (memCtx.getPool ()));
+        }
+        ASSERT_EQ (0, verify (head));
+    }
+    return 0;
+}
+
+static int
+test3 (const char* path)
+{
+    cookmem::FileMmapArena arena (path, (void*)0x5c0000000000UL, 16 * 1024 * 1024);
+    ASSERT_EQ (true, arena.isOpen ());
+    cookmem::NoActionMemLogger logger;
+    cookmem::MemContext<cookmem::FileMmapArena, cookmem::NoActionMemLogger> memCtx (arena, logger);
+    Entry* head = build (memCtx);
+
+    // MADV_PAGEOUT is not available on older kernels, in which case the
+    // memory simply stays.
+    cookmem::MemSpill spill (cookmem::SPILL_PAGEOUT);
+    if (!spill.evict (memCtx.getPool ()))
+    {
+        ASSERT_EQ (true, spill.isEvicted ());
+        ASSERT_EQ (false, spill.restore (memCtx.getPool ()));
+    }
+    ASSERT_EQ (0, verify (head));
+
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test4 ());
+
+    char path[] = "/tmp/test_spill_XXXXXX";
+    int fd = mkstemp (path);
+    ASSERT_NE (-1, fd);
+    close (fd);
+    unlink (path);
+    int ret = test3 (path);
+    unlink (path);
+    ASSERT_EQ (0, ret);
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookstatsmemlogger.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static int
+test1 ()
+{
+    ASSERT_EQ (0, cookmem::MemStats::getSizeClass (0));
+    ASSERT_EQ (0, cookmem::MemStats::getSizeClass (16));
+    ASSERT_EQ (1, cookmem::MemStats::getSizeClass (17));
+    ASSERT_EQ (1, cookmem::MemStats::getSizeClass (32));
+    ASSERT_EQ (2, cookmem::MemStats::getSizeClass (33));
+    ASSERT_EQ (16, cookmem::MemStats::getSizeClass (1024 * 1024));
+    ASSERT_EQ (cookmem::MemStats::NUM_SIZE_CLASSES - 1, cookmem::MemStats::getSizeClass ((std::size_t)-1));
+
+    // the buckets are consistent with their limits
+    for (std::size_t size = 1; size < 100000; ++size)
+    {
+        int bucket = cookmem::MemStats::getHistogramBucket (size);
+        ASSERT_EQ (true, size <= cookmem::MemStats::getHistogramBucketLimit (bucket));
+        ASSERT_EQ (true, bucket == 0 || size > cookmem::MemStats::getHistogramBucketLimit (bucket - 1));
+        ASSERT_EQ (cookmem::MemStats::getSizeClass (size), bucket / cookmem::MemStats::NUM_SUB_BUCKETS);
+    }
+    return 0;
+}
+
+static int
+testContext (bool padding)
+{
+    cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::StatsMemLogger> memCtx (padding);
+    const cookmem::MemStats& stats = memCtx.getLogger ().getStats ();
+
+    void* ptrs[1000];
+    for (int i = 0; i < 1000; ++i)
+    {
+        ptrs[i] = memCtx.allocate (i);
+    }
+    ASSERT_EQ (1000, stats.numAllocs);
+    ASSERT_EQ (16 + 1, stats.sizeClasses[0].numAllocs);
+    ASSERT_EQ (16, stats.sizeClasses[1].numAllocs);
+    ASSERT_EQ (999 - 512, stats.sizeClasses[6].numAllocs);
+    ASSERT_EQ (1, stats.histogram[0] > 1);
+    ASSERT_NE (0, stats.numGetSegments);
+    ASSERT_EQ (memCtx.getFootprint (), stats.segmentBytes);
+    std::size_t peak = stats.peakBytes;
+    ASSERT_EQ (peak, stats.liveBytes);
+
+    // shrink in place
+    ptrs[999] = memCtx.reallocate (ptrs[999], 10);
+    ASSERT_EQ (1, stats.numReallocs);
+    ASSERT_EQ (true, stats.liveBytes < peak);
+
+    cookmem::MemStats snapshot;
+    memCtx.getLogger ().snapshot (snapshot);
+
+    for (int i = 0; i < 1000; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (500, stats.numFrees);
+    ASSERT_EQ (0, snapshot.numFrees);
+
+    memCtx.getLogger ().reset ();
+    ASSERT_EQ (0, stats.numAllocs);
+    ASSERT_EQ (0, stats.numFrees);
+    ASSERT_EQ (stats.liveBytes, stats.peakBytes);
+
+    for (int i = 1; i < 1000; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (500, stats.numFrees);
+    ASSERT_EQ (0, stats.liveBytes);
+    for (int i = 0; i < cookmem::MemStats::NUM_SIZE_CLASSES; ++i)
+    {
+        ASSERT_EQ (0, stats.sizeClasses[i].liveBytes);
+    }
+
+    // failed allocations
+    memCtx.setFootprintLimit (memCtx.getFootprint ());
+    ASSERT_EQ (nullptr, memCtx.allocate (10 * 1024 * 1024));
+    ASSERT_EQ (1, stats.numFailures);
+    return 0;
+}
+
+static int
+test2 ()
+{
+    ASSERT_EQ (0, testContext (false));
+    ASSERT_EQ (0, testContext (true));
+    return 0;
+}
+
+/**
+ * MemLogger can be used as a base class.
+ */
+class CountingMemLogger : public cookmem::MemLogger
+{
+public:
+    CountingMemLogger ()
+    : numAllocs (0),
+      numReallocs (0)
+    {
+    }
+
+    virtual void logGetSegment (void* segment, std::size_t segmentSize) { }
+    virtual void logFreeSegment (void* segment, std::size_t segmentSize) { }
+    virtual void logAllocation (void* userPtr, std::size_t userSize) { ++numAllocs; }
+    virtual void logReallocation (void* userPtr, std::size_t oldUserSize, std::size_t newUserSize) { ++numReallocs; }
+    virtual void logDeallocation (void* userPtr, std::size_t userSize) { }
+    virtual void logError (void* userPtr, cookmem::MemError_et error) { }
+
+    int numAllocs;
+    int numReallocs;
+};
+
+static int
+test3 ()
+{
+    cookmem::SimpleMemContext<cookmem::MmapArena, CountingMemLogger> memCtx;
+    void* ptr = memCtx.allocate (100);
+    ptr = memCtx.reallocate (ptr, 50);
+    memCtx.deallocate (ptr);
+
+    cookmem::MemLogger& logger = memCtx.getLogger ();
+    logger.logReallocation (nullptr, 0, 0);
+    ASSERT_EQ (1, memCtx.getLogger ().numAllocs);
+    ASSERT_EQ (2, memCtx.getLogger ().numReallocs);
+    return 0;
+}
+
+static int
+test4 ()
+{
+    // the freed chunks are reused without being split, so the sizes
+    // reported on deallocation are larger than the sizes requested.
+    cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::StatsMemLogger> memCtx;
+    const cookmem::MemStats& stats = memCtx.getLogger ().getStats ();
+
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = memCtx.allocate (128);
+    }
+    for (int i = 0; i < 100; i += 2)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    for (int i = 0; i < 100; i += 2)
+    {
+        ptrs[i] = memCtx.allocate (100);
+    }
+    ASSERT_EQ (true, stats.liveBytes >= 100 * 100 + 50 * 28);
+    ASSERT_EQ (stats.liveBytes, stats.peakBytes);
+
+    // shrink in place
+    ptrs[1] = memCtx.reallocate (ptrs[1], 10);
+    ASSERT_EQ (1, stats.numReallocs);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        memCtx.deallocate (ptrs[i]);
+    }
+    ASSERT_EQ (150, stats.numFrees);
+    ASSERT_EQ (0, stats.liveBytes);
+    for (int i = 0; i < cookmem::MemStats::NUM_SIZE_CLASSES; ++i)
+    {
+        ASSERT_EQ (0, stats.sizeClasses[i].liveBytes);
+    }
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    ASSERT_EQ (0, test4 ());
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include <cookmem.h>
+#include <cookstatsregistry.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static std::string
+readFile (FILE* f)
+{
+    std::string str;
+    char buffer[1024];
+    rewind (f);
+    std::size_t n;
+    while ((n = fread (buffer, 1, sizeof(buffer), f)) > 0)
+    {
+        str.append (buffer, n);
+    }
+    return str;
+}
+
+static int
+test1 ()
+{
+    cookmem::StatsRegistry registry;
+    ASSERT_EQ (true, registry.isOpen ());
+
+    char name[64];
+    cookmem::StatsRegistry::getDefaultName (getpid (), name, sizeof(name));
+    ASSERT_EQ (0, strcmp (name, registry.getName ()));
+
+    cookmem::SimpleMemContext<> simpleCtx;
+    cookmem::CachedMemContext<> cachedCtx;
+
+    int simpleIndex = registry.add ("simple");
+    int cachedIndex = registry.add ("cached");
+    ASSERT_NE (-1, simpleIndex);
+    ASSERT_NE (simpleIndex, cachedIndex);
+
+    void* ptrs[100];
+    for (int i = 0; i < 100; ++i)
+    {
+        ptrs[i] = simpleCtx.allocate (1000);
+    }
+    // cycle a segment through the cache
+    void* big = cachedCtx.allocate (1024 * 1024);
+    cachedCtx.deallocate (big);
+    cachedCtx.releaseAll ();
+    big = cachedCtx.allocate (1024 * 1024);
+
+    registry.update (simpleIndex, simpleCtx);
+    registry.update (cachedIndex, cachedCtx, cachedCtx.getArena ().getCacheStats ());
+
+    // read it back as another process would
+    cookmem::StatsReader reader;
+    ASSERT_EQ (false, reader.open (name));
+
+    cookmem::StatsSnapshot snapshot;
+    ASSERT_EQ (cookmem::STATS_READ_OK, reader.getPage ()->read (simpleIndex, snapshot));
+    ASSERT_EQ (0, strcmp ("simple", snapshot.name));
+    ASSERT_EQ (1, snapshot.numUpdates);
+    ASSERT_EQ (simpleCtx.getFootprint (), snapshot.footprint);
+    ASSERT_EQ (simpleCtx.getMaxFootprint (), snapshot.maxFootprint);
+    ASSERT_EQ (100, snapshot.numAllocations);
+    ASSERT_EQ (true, snapshot.liveBytes >= 100 * 1000);
+    ASSERT_NE (0, snapshot.numSegments);
+    ASSERT_NE (0, snapshot.updateTime);
+
+    ASSERT_EQ (cookmem::STATS_READ_OK, reader.getPage ()->read (cachedIndex, snapshot));
+    ASSERT_EQ (0, strcmp ("cached", snapshot.name));
+    ASSERT_EQ (1, snapshot.cacheHits);
+    ASSERT_EQ (1, snapshot.cacheMisses);
+    ASSERT_EQ (0, snapshot.cachedBytes);
+
+    FILE* f = tmpfile ();
+    reader.getPage ()->writePrometheus (f);
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_NE (std::string::npos, str.find ("# TYPE cookmem_footprint_bytes gauge"));
+    ASSERT_NE (std::string::npos, str.find ("# TYPE cookmem_cache_hits_total counter"));
+    ASSERT_NE (std::string::npos, str.find ("cookmem_allocations{pid=\"" + std::to_string (getpid ()) + "\",context=\"simple\"} 100\n"));
+
+    registry.remove (cachedIndex);
+    ASSERT_EQ (cookmem::STATS_READ_UNUSED, reader.getPage ()->read (cachedIndex, snapshot));
+    ASSERT_EQ (cachedIndex, registry.add ("cached2"));
+
+    for (int i = 0; i < 100; ++i)
+    {
+        simpleCtx.deallocate (ptrs[i]);
+    }
+    cachedCtx.deallocate (big);
+    return 0;
+}
+
+/**
+ * A reader never sees a torn update.
+ */
+static int
+test2 ()
+{
+    cookmem::StatsRegistry registry ("/cookmem.test_statsregistry");
+    ASSERT_EQ (true, registry.isOpen ());
+    int index = registry.add ("writer");
+
+    std::atomic<bool> stop (false);
+    std::thread writer ([&] ()
+    {
+        cookmem::SimpleMemContext<> memCtx;
+        void* ptrs[256] = {};
+        for (unsigned int i = 0; !stop.load (); ++i)
+        {
+            unsigned int slot = (i * 7) % 256;
+            memCtx.deallocate (ptrs[slot]);
+            ptrs[slot] = memCtx.allocate ((i * 13) % 5000 + 1);
+            registry.update (index, memCtx);
+        }
+        for (int i = 0; i < 256; ++i)
+        {
+            memCtx.deallocate (ptrs[i]);
+        }
+    });
+
+    cookmem::StatsReader reader;
+    ASSERT_EQ (false, reader.open ("/cookmem.test_statsregistry"));
+    int errors = 0;
+    std::uint64_t numUpdates = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        cookmem::StatsSnapshot snapshot;
+        if (reader.getPage ()->read (index, snapshot) != cookmem::STATS_READ_OK)
+        {
+            continue;
+        }
+        if (snapshot.liveBytes + snapshot.freeBytes > snapshot.footprint ||
+            snapshot.numUpdates < numUpdates)
+        {
+            ++errors;
+        }
+        numUpdates = snapshot.numUpdates;
+    }
+    stop = true;
+    writer.join ();
+    ASSERT_EQ (0, errors);
+    return 0;
+}
+
+/**
+ * A live page is not taken over, and an entry left locked does not hang
+ * the readers.
+ */
+static int
+test3 ()
+{
+    cookmem::StatsRegistry registry ("/cookmem.test_statsregistry");
+    ASSERT_EQ (true, registry.isOpen ());
+    int index = registry.add ("locked");
+
+    cookmem::StatsRegistry other ("/cookmem.test_statsregistry");
+    ASSERT_EQ (false, other.isOpen ());
+
+    cookmem::StatsReader reader;
+    ASSERT_EQ (false, reader.open ("/cookmem.test_statsregistry"));
+    cookmem::StatsSnapshot snapshot;
+    ASSERT_EQ (cookmem::STATS_READ_OK, reader.getPage ()->read (index, snapshot));
+    ASSERT_EQ (0, strcmp ("locked", snapshot.name));
+
+    // simulate a writer that died in the middle of an update
+    cookmem::StatsPage* page = const_cast<cookmem::StatsPage*> (registry.getPage ());
+    page->entries[index].seq.fetch_add (1);
+    ASSERT_EQ (cookmem::STATS_READ_BUSY, reader.getPage ()->read (index, snapshot));
+
+    FILE* f = tmpfile ();
+    reader.getPage ()->writePrometheus (f);
+    std::string str = readFile (f);
+    fclose (f);
+    ASSERT_EQ (std::string::npos, str.find ("context=\"locked\""));
+
+    page->entries[index].seq.fetch_add (1);
+    ASSERT_EQ (cookmem::STATS_READ_OK, reader.getPage ()->read (index, snapshot));
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    ASSERT_EQ (0, test3 ());
+    return 0;
+}
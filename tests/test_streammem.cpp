@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstring>
+#include <iostream>
+
+#include <cookmem.h>
+#include <cookstreammem.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static int
+test1 ()
+{
+    // various sizes and alignments, checking the guard bytes around.
+    const std::size_t maxSize = 4096;
+    static char src[maxSize + 64];
+    static char dst[maxSize + 128];
+    static char expected[maxSize + 128];
+    for (std::size_t i = 0; i < sizeof(src); ++i)
+    {
+        src[i] = (char)(i * 7 + 1);
+    }
+    for (std::size_t size = 0; size < maxSize; size = size * 2 + 13)
+    {
+        for (std::size_t dstOffset = 0; dstOffset < 33; dstOffset += 3)
+        {
+            for (std::size_t srcOffset = 0; srcOffset < 33; srcOffset += 5)
+            {
+                memset (dst, 0x5a, sizeof(dst));
+                memset (expected, 0x5a, sizeof(expected));
+                memcpy (expected + dstOffset, src + srcOffset, size);
+                cookmem::streamCopy (dst + dstOffset, src + srcOffset, size);
+                ASSERT_EQ (0, memcmp (dst, expected, sizeof(dst)));
+            }
+
+            memset (dst, 0x5a, sizeof(dst));
+            memset (expected, 0x5a, sizeof(expected));
+            memset (expected + dstOffset, 0xab, size);
+            cookmem::streamFill (dst + dstOffset, 0xab, size);
+            ASSERT_EQ (0, memcmp (dst, expected, sizeof(dst)));
+        }
+    }
+    return 0;
+}
+
+static int
+test2 ()
+{
+    const std::size_t size = 1024 * 1024;
+    cookmem::SimpleMemContext<> memCtx;
+    ASSERT_EQ (0, memCtx.getStreamThreshold ());
+    memCtx.setStreamThreshold (64 * 1024);
+    ASSERT_EQ (64 * 1024, memCtx.getStreamThreshold ());
+
+    char* ptr = (char*)memCtx.allocate (size);
+    ASSERT_NE (nullptr, ptr);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        ptr[i] = (char)i;
+    }
+    // block the chunk from growing in place
+    void* block = memCtx.allocate (100);
+    ASSERT_NE (nullptr, block);
+
+    char* newPtr = (char*)memCtx.reallocate (ptr, size * 4);
+    ASSERT_NE (nullptr, newPtr);
+    ASSERT_NE (ptr, newPtr);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        ASSERT_EQ ((char)i, newPtr[i]);
+    }
+
+    // reused memory is cleared by callocate
+    memset (newPtr, 0xab, size * 4);
+    memCtx.deallocate (newPtr);
+    char* zeroPtr = (char*)memCtx.callocate (size, 3);
+    ASSERT_NE (nullptr, zeroPtr);
+    for (std::size_t i = 0; i < size * 3; ++i)
+    {
+        ASSERT_EQ (0, zeroPtr[i]);
+    }
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <cookmem.h>
+#include <cooktracememlogger.h>
+
+#define ASSERT_EQ(e,v) do { if ((e) != (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+#define ASSERT_NE(e,v) do { if ((e) == (v)) { std::cout << "Mismatch at line " << __LINE__ << std::endl; return 1; } } while (0)
+
+static std::string
+getTracePath ()
+{
+    const char* dir = getenv ("TMPDIR");
+    return std::string (dir ? dir : "/tmp") + "/cookmem_trace_test.bin";
+}
+
+static int
+test1 ()
+{
+    std::string path = getTracePath ();
+    const int numAllocs = 10000;
+    void* ptrs[numAllocs];
+    {
+        cookmem::MmapArena arena;
+        cookmem::TraceMemLogger logger (path.c_str ());
+        ASSERT_EQ (true, logger.isOpen ());
+        cookmem::MemContext<cookmem::MmapArena, cookmem::TraceMemLogger> memCtx (arena, logger);
+
+        for (int i = 0; i < numAllocs; ++i)
+        {
+            ptrs[i] = memCtx.allocate (i + 1);
+        }
+        ptrs[0] = memCtx.reallocate (ptrs[0], 0);
+        for (int i = 0; i < numAllocs; ++i)
+        {
+            memCtx.deallocate (ptrs[i]);
+        }
+        memCtx.releaseAll ();
+        ASSERT_EQ (false, logger.close ());
+    }
+
+    FILE* f = fopen (path.c_str (), "rb");
+    ASSERT_NE (nullptr, f);
+    cookmem::TraceHeader header;
+    ASSERT_EQ (1, fread (&header, sizeof(header), 1, f));
+    ASSERT_EQ (0, memcmp (header.magic, cookmem::TRACE_MAGIC, sizeof(header.magic)));
+    ASSERT_EQ (sizeof(cookmem::TraceRecord), header.recordSize);
+    ASSERT_EQ (24, header.recordSize);
+
+    int counts[6] = { 0 };
+    int numAllocated = 0;
+    cookmem::TraceRecord r;
+    while (fread (&r, sizeof(r), 1, f) == 1)
+    {
+        ASSERT_EQ (true, r.op >= cookmem::TRACE_ALLOC && r.op <= cookmem::TRACE_FREE_SEGMENT);
+        ++counts[r.op];
+        if (r.op == cookmem::TRACE_ALLOC)
+        {
+            // the allocations are recorded in order
+            ASSERT_EQ ((std::uint64_t)(numAllocated + 1), r.size);
+            ASSERT_NE (0, r.id);
+            ++numAllocated;
+        }
+        if (r.op == cookmem::TRACE_REALLOC)
+        {
+            ASSERT_EQ ((std::uint64_t)(std::uintptr_t)ptrs[0], r.id);
+            ASSERT_EQ (0, r.size);
+        }
+    }
+    fclose (f);
+    remove (path.c_str ());
+
+    ASSERT_EQ (numAllocs, counts[cookmem::TRACE_ALLOC]);
+    ASSERT_EQ (numAllocs, counts[cookmem::TRACE_FREE]);
+    ASSERT_EQ (1, counts[cookmem::TRACE_REALLOC]);
+    ASSERT_NE (0, counts[cookmem::TRACE_GET_SEGMENT]);
+    ASSERT_EQ (counts[cookmem::TRACE_GET_SEGMENT], counts[cookmem::TRACE_FREE_SEGMENT]);
+    return 0;
+}
+
+static int
+test2 ()
+{
+    // a closed logger records nothing
+    cookmem::SimpleMemContext<cookmem::MmapArena, cookmem::TraceMemLogger> memCtx;
+    memCtx.deallocate (memCtx.allocate (100));
+    ASSERT_EQ (false, memCtx.getLogger ().isOpen ());
+    ASSERT_EQ (0, memCtx.getLogger ().getNumRecords ());
+    return 0;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    ASSERT_EQ (0, test1 ());
+    ASSERT_EQ (0, test2 ());
+    return 0;
+}
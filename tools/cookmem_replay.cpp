@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Replays an allocation trace recorded by cookmem::TraceMemLogger against
+ * several allocators and reports the throughput, the peak footprint and
+ * the fragmentation of each.
+ *
+ * Usage: cookmem_replay [-m mmap_threshold] trace_file [allocator ...]
+ *
+ * The cookmem allocators are named after the arena used: simple
+ * (MmapArena), cached (CachedArena of MmapArena), batch (BatchMmapArena)
+ * and malloc (MallocArena).  glibc and dlmalloc are also available.  All
+ * of them are run by default.
+ *
+ * -m sets the mmap threshold in bytes of all the allocators, such that
+ * the larger requests get their own segments.  By default, cookmem does
+ * not use the mmap threshold, and glibc and dlmalloc use their own
+ * defaults.
+ *
+ * Reallocations that moved the memory were recorded as an allocation and a
+ * deallocation, and are replayed the same way.  The fragmentation is
+ * 1 - peak live bytes / peak footprint.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+
+#include <cookmem.h>
+#include <cookbatchmmaparena.h>
+#include <cookmallocarena.h>
+#include <cooktracememlogger.h>
+
+// dlmalloc.c defines these with the same values as <malloc.h>.
+#undef M_TRIM_THRESHOLD
+#undef M_MMAP_THRESHOLD
+
+#define USE_DL_PREFIX   1
+#define HAVE_MORECORE   0
+#define NO_MALLINFO     1
+#if defined(__linux__)
+// g++ already defines _GNU_SOURCE, which dlmalloc.c defines for mremap.
+#define HAVE_MREMAP     1
+#endif
+#include "../performances/dlmalloc.c"
+
+/**
+ * An operation with the pointer ids replaced by slot indexes.
+ */
+struct ReplayOp
+{
+    std::uint8_t    op;
+    std::uint32_t   slot;
+    std::size_t     size;
+};
+
+struct Trace
+{
+    std::vector<ReplayOp>   ops;
+    std::size_t             numSlots;
+    std::size_t             peakLiveBytes;
+};
+
+static bool
+loadTrace (const char* path, Trace& trace)
+{
+    FILE* f = fopen (path, "rb");
+    if (f == nullptr)
+    {
+        std::cerr << "Unable to open " << path << std::endl;
+        return false;
+    }
+    cookmem::TraceHeader header;
+    if (fread (&header, sizeof(header), 1, f) != 1 ||
+        memcmp (header.magic, cookmem::TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.recordSize != sizeof(cookmem::TraceRecord))
+    {
+        std::cerr << "Invalid trace file " << path << std::endl;
+        fclose (f);
+        return false;
+    }
+
+    // map the pointer ids to slots, reusing the slots freed.
+    std::unordered_map<std::uint64_t, std::uint32_t> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::size_t> slotSizes;
+    std::size_t liveBytes = 0;
+    trace.peakLiveBytes = 0;
+
+    cookmem::TraceRecord r;
+    while (fread (&r, sizeof(r), 1, f) == 1)
+    {
+        ReplayOp op;
+        op.op = r.op;
+        op.size = (std::size_t)r.size;
+        if (r.op == cookmem::TRACE_ALLOC)
+        {
+            if (r.id == 0)
+            {
+                continue;
+            }
+            if (freeSlots.empty ())
+            {
+                op.slot = (std::uint32_t)slotSizes.size ();
+                slotSizes.push_back (0);
+            }
+            else
+            {
+                op.slot = freeSlots.back ();
+                freeSlots.pop_back ();
+            }
+            slots[r.id] = op.slot;
+        }
+        else if (r.op == cookmem::TRACE_FREE || r.op == cookmem::TRACE_REALLOC)
+        {
+            std::unordered_map<std::uint64_t, std::uint32_t>::iterator it = slots.find (r.id);
+            if (it == slots.end ())
+            {
+                // allocated before the trace started
+                continue;
+            }
+            op.slot = it->second;
+            liveBytes -= slotSizes[op.slot];
+            if (r.op == cookmem::TRACE_FREE)
+            {
+                slots.erase (it);
+                freeSlots.push_back (op.slot);
+                slotSizes[op.slot] = 0;
+            }
+        }
+        else
+        {
+            continue;
+        }
+        if (r.op != cookmem::TRACE_FREE)
+        {
+            slotSizes[op.slot] = op.size;
+            if ((liveBytes += op.size) > trace.peakLiveBytes)
+            {
+                trace.peakLiveBytes = liveBytes;
+            }
+        }
+        trace.ops.push_back (op);
+    }
+    fclose (f);
+    trace.numSlots = slotSizes.size ();
+    return true;
+}
+
+template<class MemCtx>
+struct ContextAllocator
+{
+    MemCtx  memCtx;
+
+    ContextAllocator (std::size_t mmapThreshold)
+    {
+        memCtx.setMmapThreshold (mmapThreshold);
+    }
+
+    void* allocate (std::size_t size) { return memCtx.allocate (size); }
+    void* reallocate (void* ptr, std::size_t size) { return memCtx.reallocate (ptr, size); }
+    void deallocate (void* ptr) { memCtx.deallocate (ptr); }
+    void sample () { }
+    std::size_t getPeakFootprint () { return memCtx.getMaxFootprint (); }
+};
+
+struct GlibcAllocator
+{
+    std::size_t peak;
+
+    GlibcAllocator (std::size_t mmapThreshold)
+    : peak (0)
+    {
+#if defined(__GLIBC__)
+        if (mmapThreshold)
+        {
+            mallopt (M_MMAP_THRESHOLD, (int)mmapThreshold);
+        }
+#endif
+    }
+
+    void* allocate (std::size_t size) { return malloc (size); }
+    void* reallocate (void* ptr, std::size_t size) { return realloc (ptr, size ? size : 1); }
+    void deallocate (void* ptr) { free (ptr); }
+
+    void
+    sample ()
+    {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 info = mallinfo2 ();
+        std::size_t footprint = info.arena + info.hblkhd;
+        if (footprint > peak)
+        {
+            peak = footprint;
+        }
+#endif
+    }
+
+    std::size_t getPeakFootprint () { sample (); return peak; }
+};
+
+struct DLMallocAllocator
+{
+    DLMallocAllocator (std::size_t mmapThreshold)
+    {
+        if (mmapThreshold)
+        {
+            dlmallopt (M_MMAP_THRESHOLD, (int)mmapThreshold);
+        }
+    }
+
+    void* allocate (std::size_t size) { return dlmalloc (size); }
+    void* reallocate (void* ptr, std::size_t size) { return dlrealloc (ptr, size ? size : 1); }
+    void deallocate (void* ptr) { dlfree (ptr); }
+    void sample () { }
+    std::size_t getPeakFootprint () { return dlmalloc_max_footprint (); }
+};
+
+template<class Allocator>
+static void
+replay (const char* name, const Trace& trace, std::size_t mmapThreshold)
+{
+    Allocator* allocator = new Allocator (mmapThreshold);
+    std::vector<void*> ptrs (trace.numSlots, nullptr);
+    std::size_t numFailures = 0;
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    std::size_t count = 0;
+    for (std::vector<ReplayOp>::const_iterator it = trace.ops.begin (); it != trace.ops.end (); ++it)
+    {
+        void*& ptr = ptrs[it->slot];
+        switch (it->op)
+        {
+            case cookmem::TRACE_ALLOC:
+                ptr = allocator->allocate (it->size);
+                if (ptr && it->size)
+                {
+                    *(char*)ptr = 1;
+                }
+                numFailures += ptr == nullptr;
+                break;
+            case cookmem::TRACE_REALLOC:
+                if (ptr)
+                {
+                    void* newPtr = allocator->reallocate (ptr, it->size);
+                    if (newPtr)
+                    {
+                        ptr = newPtr;
+                    }
+                }
+                break;
+            case cookmem::TRACE_FREE:
+                allocator->deallocate (ptr);
+                ptr = nullptr;
+                break;
+        }
+        if ((++count & 4095) == 0)
+        {
+            allocator->sample ();
+        }
+    }
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    double t = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+    std::size_t peak = allocator->getPeakFootprint ();
+    double fragmentation = peak ? 1.0 - (double)trace.peakLiveBytes / peak : 0;
+
+    for (std::size_t i = 0; i < ptrs.size (); ++i)
+    {
+        if (ptrs[i])
+        {
+            allocator->deallocate (ptrs[i]);
+        }
+    }
+    delete allocator;
+
+    std::cout << name << "," << t << "," << (t > 0 ? trace.ops.size () / t : 0) << ","
+              << peak << "," << fragmentation << "," << numFailures << std::endl;
+}
+
+static void
+usage ()
+{
+    std::cerr << "Usage: cookmem_replay [-m mmap_threshold] trace_file [simple|cached|batch|malloc|glibc|dlmalloc ...]" << std::endl;
+}
+
+int
+main (int argc, const char* argv[])
+{
+    std::size_t mmapThreshold = 0;
+    int argi = 1;
+    while (argi < argc && argv[argi][0] == '-')
+    {
+        if (strcmp (argv[argi], "-m") == 0 && argi + 1 < argc)
+        {
+            char* end;
+            mmapThreshold = (std::size_t)strtoull (argv[argi + 1], &end, 10);
+            if (*end != 0 || mmapThreshold > 0x7fffffff)
+            {
+                std::cerr << "Invalid mmap threshold " << argv[argi + 1] << std::endl;
+                return 1;
+            }
+            argi += 2;
+        }
+        else
+        {
+            usage ();
+            return 1;
+        }
+    }
+    if (argi >= argc)
+    {
+        usage ();
+        return 1;
+    }
+    Trace trace;
+    if (!loadTrace (argv[argi], trace))
+    {
+        return 1;
+    }
+    std::cout << "# " << trace.ops.size () << " operations, peak live bytes " << trace.peakLiveBytes << std::endl;
+    std::cout << "allocator,seconds,ops_per_second,peak_footprint,fragmentation,failures" << std::endl;
+
+    static const char* const allNames[] = { "simple", "cached", "batch", "malloc", "glibc", "dlmalloc" };
+    std::vector<std::string> names;
+    for (++argi; argi < argc; ++argi)
+    {
+        names.push_back (argv[argi]);
+    }
+    if (names.empty ())
+    {
+        names.assign (allNames, allNames + sizeof(allNames) / sizeof(allNames[0]));
+    }
+
+    for (std::size_t i = 0; i < names.size (); ++i)
+    {
+        const std::string& name = names[i];
+        if (name == "simple")
+        {
+            replay<ContextAllocator<cookmem::SimpleMemContext<> > > (name.c_str (), trace, mmapThreshold);
+        }
+        else if (name == "cached")
+        {
+            replay<ContextAllocator<cookmem::CachedMemContext<> > > (name.c_str (), trace, mmapThreshold);
+        }
+        else if (name == "batch")
+        {
+            replay<ContextAllocator<cookmem::SimpleMemContext<cookmem::BatchMmapArena> > > (name.c_str (), trace, mmapThreshold);
+        }
+        else if (name == "malloc")
+        {
+            replay<ContextAllocator<cookmem::SimpleMemContext<cookmem::MallocArena> > > (name.c_str (), trace, mmapThreshold);
+        }
+        else if (name == "glibc")
+        {
+            replay<GlibcAllocator> (name.c_str (), trace, mmapThreshold);
+        }
+        else if (name == "dlmalloc")
+        {
+            replay<DLMallocAllocator> (name.c_str (), trace, mmapThreshold);
+        }
+        else
+        {
+            std::cerr << "Unknown allocator " << name << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
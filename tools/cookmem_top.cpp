@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2018-2021 Heng Yuan
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Watches the memory contexts a running process publishes through
+ * cookmem::StatsRegistry.
+ *
+ * Usage: cookmem_top [-i seconds] [-n count] [-p] pid|name
+ *
+ * The target is either the process id, which opens the default page
+ * "/cookmem.<pid>", or the name of the shared memory object.  Every
+ * interval (1 second by default), a line is printed for each context with
+ * its footprint, live bytes, the percentage of the footprint not used by
+ * live bytes, segment counts, cache hit rate and the change of the
+ * footprint since the last sample.  -n stops after the given number of
+ * samples.  A context that stays locked by its writer, such as one whose
+ * thread died in the middle of an update, is shown as busy.  -p prints
+ * the page once in the Prometheus text format
+ * instead, which can be served by a textfile collector.
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <unistd.h>
+
+#include <cookstatsregistry.h>
+
+static void
+printSnapshots (const cookmem::StatsPage* page, std::uint64_t* lastFootprints, bool first)
+{
+    printf ("%-24s %14s %14s %14s %6s %6s %6s %10s %10s %14s\n",
+            "context", "footprint", "max", "live", "waste%", "segs", "direct", "allocs", "cache_hit", "delta");
+    for (int i = 0; i < cookmem::StatsPage::MAX_ENTRIES; ++i)
+    {
+        cookmem::StatsSnapshot snapshot;
+        cookmem::StatsRead_et status = page->read (i, snapshot);
+        if (status == cookmem::STATS_READ_UNUSED)
+        {
+            lastFootprints[i] = 0;
+            continue;
+        }
+        if (status == cookmem::STATS_READ_BUSY)
+        {
+            printf ("entry %-18d %14s\n", i, "busy");
+            continue;
+        }
+        double waste = snapshot.footprint ? 100.0 * (snapshot.footprint - snapshot.liveBytes) / snapshot.footprint : 0;
+        std::uint64_t lookups = snapshot.cacheHits + snapshot.cacheMisses;
+        double hitRate = lookups ? 100.0 * snapshot.cacheHits / lookups : 0;
+        long long delta = first ? 0 : (long long)snapshot.footprint - (long long)lastFootprints[i];
+        printf ("%-24s %14llu %14llu %14llu %6.1f %6llu %6llu %10llu %9.1f%% %+14lld\n",
+                snapshot.name,
+                (unsigned long long)snapshot.footprint,
+                (unsigned long long)snapshot.maxFootprint,
+                (unsigned long long)snapshot.liveBytes,
+                waste,
+                (unsigned long long)snapshot.numSegments,
+                (unsigned long long)snapshot.numDirectSegments,
+                (unsigned long long)snapshot.numAllocations,
+                hitRate,
+                delta);
+        lastFootprints[i] = snapshot.footprint;
+    }
+    printf ("\n");
+    fflush (stdout);
+}
+
+int
+main (int argc, const char* argv[])
+{
+    double interval = 1;
+    long count = -1;
+    bool prometheus = false;
+    const char* target = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp (argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            interval = atof (argv[++i]);
+        }
+        else if (strcmp (argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            count = atol (argv[++i]);
+        }
+        else if (strcmp (argv[i], "-p") == 0)
+        {
+            prometheus = true;
+        }
+        else
+        {
+            target = argv[i];
+        }
+    }
+    if (target == nullptr || interval <= 0)
+    {
+        std::cerr << "Usage: cookmem_top [-i seconds] [-n count] [-p] pid|name" << std::endl;
+        return 1;
+    }
+
+    char name[64];
+    if (isdigit ((unsigned char)target[0]))
+    {
+        cookmem::StatsRegistry::getDefaultName ((pid_t)atol (target), name, sizeof(name));
+    }
+    else
+    {
+        snprintf (name, sizeof(name), "%s", target);
+    }
+
+    cookmem::StatsReader reader;
+    if (reader.open (name))
+    {
+        std::cerr << "Unable to open " << name << std::endl;
+        return 1;
+    }
+
+    if (prometheus)
+    {
+        reader.getPage ()->writePrometheus (stdout);
+        return 0;
+    }
+
+    std::uint64_t lastFootprints[cookmem::StatsPage::MAX_ENTRIES] = {};
+    for (long n = 0; count < 0 || n < count; ++n)
+    {
+        if (n > 0)
+        {
+            usleep ((useconds_t)(interval * 1000000));
+        }
+        printSnapshots (reader.getPage (), lastFootprints, n == 0);
+    }
+    return 0;
+}